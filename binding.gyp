@@ -13,7 +13,8 @@
             ],
             "link_settings": {
               "libraries": [
-                "-lpigpio"
+                "-lpigpio",
+                "-lrt"
               ]
             },
             "conditions": [[
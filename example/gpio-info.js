@@ -1,13 +1,17 @@
 'use strict';
 
-const Gpio = require('../').Gpio;
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
 
-for (let gpioNo = Gpio.MIN_GPIO; gpioNo <= Gpio.MAX_GPIO; gpioNo += 1) {
-  const gpio = new Gpio(gpioNo);
+const snapshot = pigpio.snapshot();
+
+const field = (gpioNo, offset) => {
+  return snapshot[gpioNo * pigpio.SNAPSHOT_FIELDS + offset];
+};
 
+for (let gpioNo = Gpio.MIN_GPIO; gpioNo <= Gpio.MAX_GPIO; gpioNo += 1) {
   console.log('GPIO ' + gpioNo + ':' +
-    ' mode=' + gpio.getMode() +
-    ' level=' + gpio.digitalRead()
+    ' mode=' + field(gpioNo, pigpio.SNAPSHOT_MODE) +
+    ' level=' + field(gpioNo, pigpio.SNAPSHOT_LEVEL)
   );
 }
-
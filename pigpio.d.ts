@@ -275,6 +275,61 @@ export function waveGetHighCbs(): number;
  */
 export function waveGetMaxCbs(): number;
 
+/**
+ * Splits a pulse list into segments that fit the waveform limits, creates a waveform for each segment and returns a plan
+ * with the bytes of a chain for waveChain that transmits them back to back. Throws if the estimated number of DMA control
+ * blocks exceeds the budget left by waveforms created with this module or if the chain would be too long.
+ * @param pulses    the pulses in the format used by waveAddGeneric
+ * @param options   maxPulses - maximum pulses per segment (optional, defaults to waveGetMaxPulses())
+ *                  maxMicros - maximum duration of a segment (optional, defaults to waveGetMaxMicros())
+ *                  maxCbs - DMA control blocks available (optional, defaults to waveGetMaxCbs())
+ *                  reservedCbs - DMA control blocks to keep free for waveforms created later or by other means (optional, defaults to 0)
+ *                  repeat - number of times to transmit the waveforms, 1 to 65535, or true for until stopped (optional, defaults to 1)
+ */
+export function wavePlan(pulses: GenericWaveStep[], options?: {
+  maxPulses?: number,
+  maxMicros?: number,
+  maxCbs?: number,
+  reservedCbs?: number,
+  repeat?: number | boolean
+}): {
+  waveIds: WaveId[],
+  chain: number[],
+  segments: {
+    start: number,
+    length: number,
+    waveId: WaveId,
+    cbs: number,
+    micros: number
+  }[],
+  cbs: number,
+  micros: number
+};
+
+/**
+ * Outputs a pattern on a parallel bus of GPIOs 0 to 31 at a fixed sample rate. The set and clear masks are computed
+ * from consecutive samples and identical consecutive samples are merged. Long patterns are split into chained waveforms.
+ * @param patterns  the levels of GPIOs 0 to 31, one bit mask per sample
+ * @param options   mask - the GPIOs to drive (optional, defaults to the bitwise OR of all samples)
+ *                  periodUs - sample period in microseconds (optional, defaults to 1)
+ *                  repeat - number of passes, 1 to 65535, or true for forever (optional, defaults to 1)
+ *                  maxPulses - maximum samples per waveform (optional, defaults to waveGetMaxPulses())
+ *                  maxMicros - maximum duration of a waveform (optional, defaults to waveGetMaxMicros())
+ */
+export function playPattern(patterns: Uint32Array, options?: {
+  mask?: number,
+  periodUs?: number,
+  repeat?: number | boolean,
+  maxPulses?: number,
+  maxMicros?: number
+}): {
+  waveIds: WaveId[],
+  chain: number[],
+  samples: number,
+  pulses: number,
+  micros: number
+};
+
 /**
  * The waveform is sent once.
  */
@@ -335,6 +390,21 @@ export class Gpio extends EventEmitter {
        * boolean specifying whether or not alert events are emitted when the GPIO changes state (optional, default false)
        */
       alert?: boolean;
+
+      /**
+       * watchdog timeout in milliseconds, timeout events are emitted after this period without edges (optional, no default)
+       */
+      watchdog?: number;
+
+      /**
+       * coalescing window in microseconds for interrupts and alerts (optional, defaults to 0 meaning no coalescing)
+       */
+      coalesce?: number;
+
+      /**
+       * boolean specifying whether the tick passed to alert and interrupt events is a 64 bit bigint rather than a 32 bit number (optional, default false)
+       */
+      tick64?: boolean;
     }
   );
 
@@ -404,6 +474,12 @@ export class Gpio extends EventEmitter {
    */
   once(event: 'alert', listener: (level: 0 | 1, tick: number) => void): this;
 
+  /**
+   * @param level the level of the GPIO after its last edge, 0 or 1
+   * @param tick the time stamp of the last edge, an unsigned 32 bit integer
+   */
+  on(event: 'timeout', listener: (level: 0 | 1, tick: number) => void): this;
+
   /**
    * @param level the GPIO level when the state change occurred, 0 or 1
    * @param tick the time stamp of the state change, an unsigned 32 bit integer
@@ -739,8 +815,9 @@ export class Gpio extends EventEmitter {
    * Enables interrupts for the GPI
    * @param edge      RISING_EDGE, FALLING_EDGE, or EITHER_EDGE
    * @param timeout   interrupt timeout in milliseconds (optional, defaults to 0 meaning no timeout)
+   * @param options   coalesce - coalescing window in microseconds (optional, defaults to 0 meaning no coalescing)
    */
-  enableInterrupt(edge: number, timeout?: number): Gpio;
+  enableInterrupt(edge: number, timeout?: number, options?: { coalesce?: number }): Gpio;
 
   /**
    * Disables interrupts for the GPIO. Returns this.
@@ -749,14 +826,29 @@ export class Gpio extends EventEmitter {
 
   /**
    * Enables alerts for the GPIO. Returns this.
+   * @param options   coalesce - coalescing window in microseconds. At most one alert event carrying the latest level,
+   * the tick of the last edge, the number of edges collapsed and the tick of the first edge is emitted per window.
+   * (optional, defaults to 0 meaning no coalescing)
    */
-  enableAlert(): Gpio;
+  enableAlert(options?: { coalesce?: number }): Gpio;
 
   /**
    * Disables aterts for the GPIO. Returns this.
    */
   disableAlert(): Gpio;
 
+  /**
+   * Enables the inactivity watchdog for the GPIO. A timeout event is emitted once per period of inactivity.
+   * Returns this.
+   * @param timeout   the period without edges in milliseconds, 1 through 60000
+   */
+  enableWatchdog(timeout: number): Gpio;
+
+  /**
+   * Disables the inactivity watchdog for the GPIO. Returns this.
+   */
+  disableWatchdog(): Gpio;
+
   /**
    * Sets a glitch filter on a GPIO. Returns this.
    * @param steady    Time, in microseconds, during which the level must be stable. Maximum value: 300000
@@ -939,6 +1031,12 @@ export class Notifier {
      * If a bit is set, the corresponding GPIO will be monitored for state changes. (optional, no default)
      */
     bits: number;
+
+    /**
+     * share a single notification pipe with other shared Notifiers. Notifications that don't indicate a state
+     * change on any of the GPIOs in bits are filtered out natively. (optional, default false)
+     */
+    shared?: boolean;
   });
 
   /**
@@ -963,6 +1061,11 @@ export class Notifier {
    */
   stream(): NodeJS.ReadableStream;
 
+  /**
+   * Returns the number of notifications dropped because the stream wasn't read fast enough. Always 0 if the Notifier isn't shared.
+   */
+  dropped(): number;
+
   /**
    * The number of bytes occupied by a notification in the notification stream.
    */
@@ -974,6 +1077,579 @@ export class Notifier {
   static PI_NTFY_FLAGS_ALIVE: number;
 }
 
+/************************************
+ * Encoder
+ ************************************/
+
+/**
+ * Quadrature/rotary encoder decoded by the pigpio thread.
+ */
+export class Encoder extends EventEmitter {
+  /**
+   * Returns a new Encoder object for decoding the quadrature signals on GPIOs gpioA and gpioB.
+   * Both GPIOs are configured as inputs.
+   * @param gpioA     an unsigned integer specifying the GPIO number of channel A
+   * @param gpioB     an unsigned integer specifying the GPIO number of channel B
+   * @param options   Used to configure pull type and reporting
+   */
+  constructor(gpioA: number, gpioB: number, options?: {
+    /**
+     * PUD_OFF, PUD_DOWN, or PUD_UP, applied to both GPIOs (optional, no default)
+     */
+    pullUpDown?: number;
+
+    /**
+     * emit a 'position' event whenever the position has changed by this many counts (optional, default 0, disabled)
+     */
+    counts?: number;
+
+    /**
+     * emit a 'position' event every interval milliseconds (optional, default 0, disabled)
+     */
+    interval?: number;
+  });
+
+  /**
+   * @param position the current position in counts
+   * @param velocity the velocity in counts per second since the previous 'position' event
+   * @param invalid the number of invalid transitions since the encoder was created or setPosition was called
+   * @param tick the time stamp of the event, an unsigned 32 bit integer
+   */
+  on(event: 'position', listener: (position: number, velocity: number, invalid: number, tick: number) => void): this;
+  on(event: string | symbol, listener: (...args: any[]) => void): this;
+
+  /**
+   * Returns the current position in counts.
+   */
+  position(): number;
+
+  /**
+   * Sets the current position and resets the invalid transition count.
+   */
+  setPosition(position: number): Encoder;
+
+  /**
+   * Stops decoding and releases resources.
+   */
+  close(): void;
+}
+
+/************************************
+ * Controller
+ ************************************/
+
+export interface ControllerParams {
+  /** Proportional gain */
+  kp?: number;
+
+  /** Integral gain */
+  ki?: number;
+
+  /** Derivative gain */
+  kd?: number;
+
+  /** Desired measurement */
+  setpoint?: number;
+
+  /** Lower output limit */
+  min?: number;
+
+  /** Upper output limit */
+  max?: number;
+}
+
+export interface ControllerSample {
+  tick: number | bigint;
+  setpoint: number;
+  measurement: number;
+  output: number;
+  integral: number;
+}
+
+/**
+ * PID controller running on a native thread.
+ */
+export class Controller extends EventEmitter {
+  /**
+   * Returns a new Controller object and starts the control loop.
+   * @param options   Input, output, gains and loop configuration
+   */
+  constructor(options: ControllerParams & {
+    input: {
+      /** FREQUENCY, PULSE_WIDTH or ENCODER */
+      type: string;
+
+      /** The input GPIO, for ENCODER the A and B GPIOs */
+      gpio: number | Gpio | Array<number | Gpio>;
+
+      /** PUD_OFF, PUD_DOWN, or PUD_UP (optional, no default) */
+      pullUpDown?: number;
+    };
+
+    output: {
+      /** PWM, HARDWARE_PWM or SERVO */
+      type: string;
+
+      /** The output GPIO */
+      gpio: number | Gpio;
+
+      /** HARDWARE_PWM only, the PWM frequency in Hz (optional, default 25000) */
+      frequency?: number;
+    };
+
+    /** Control loop rate, 1 through 10000 (optional, default 100) */
+    rateHz?: number;
+
+    /** Emit a telemetry sample every telemetry iterations, 0 for none (optional, default 0) */
+    telemetry?: number;
+
+    /** If true, telemetry ticks are BigInt values with 64 bit range (optional, default false) */
+    tick64?: boolean;
+  });
+
+  /**
+   * Number of telemetry samples dropped because JavaScript didn't keep up.
+   */
+  readonly dropped: number;
+
+  /**
+   * @param samples the telemetry samples since the previous event
+   */
+  on(event: 'telemetry', listener: (samples: ControllerSample[]) => void): this;
+  on(event: string | symbol, listener: (...args: any[]) => void): this;
+
+  /**
+   * Updates the controller parameters. Returns this.
+   * @param params  Parameters to change, reset clears the integral term and derivative history
+   */
+  set(params: ControllerParams & { reset?: boolean }): Controller;
+
+  /**
+   * Stops the control loop and releases resources. The output keeps its last value.
+   */
+  close(): void;
+
+  static FREQUENCY: 'frequency';
+  static PULSE_WIDTH: 'pulseWidth';
+  static ENCODER: 'encoder';
+  static PWM: 'pwm';
+  static HARDWARE_PWM: 'hardwarePwm';
+  static SERVO: 'servo';
+}
+
+/************************************
+ * Decoder
+ ************************************/
+
+/**
+ * Table driven description of a pulse distance or pulse width protocol. All
+ * lengths are in microseconds. A bit is a mark followed by a space.
+ */
+export type PulseProtocol = {
+  /** length of the header mark, 0 if there is no header (optional, default 0) */
+  headerMark?: number;
+  /** length of the header space (optional, default 0) */
+  headerSpace?: number;
+  /** length of the header space of a repeat frame, 0 if there are no repeat frames (optional, default 0) */
+  repeatSpace?: number;
+  /** length of the mark of a 0 bit */
+  zeroMark: number;
+  /** length of the space of a 0 bit */
+  zeroSpace: number;
+  /** length of the mark of a 1 bit */
+  oneMark: number;
+  /** length of the space of a 1 bit */
+  oneSpace: number;
+  /** number of bits in a frame */
+  bits: number;
+  /** allowed deviation from the nominal lengths in percent (optional, default 25) */
+  tolerance?: number;
+  /** true if a mark is a low level (optional, default false) */
+  activeLow?: boolean;
+  /** true if the most significant bit of each byte is received first (optional, default false) */
+  msbFirst?: boolean;
+};
+
+/**
+ * Edge timing protocol decoder running on the pigpio thread.
+ */
+export class Decoder extends EventEmitter {
+  /**
+   * Returns a new Decoder object for decoding frames received on a GPIO.
+   * @param gpio      the GPIO number, or for Wiegand an array with the D0 and D1 GPIO numbers
+   * @param protocol  NEC, RC5, DHT, WIEGAND, or a PulseProtocol
+   * @param options   Used to configure pull type and protocol specifics
+   */
+  constructor(gpio: number | number[], protocol: string | PulseProtocol, options?: {
+    /**
+     * PUD_OFF, PUD_DOWN, or PUD_UP (optional, no default)
+     */
+    pullUpDown?: number;
+
+    /**
+     * RC5 only, true if a mark is a low level (optional, default true)
+     */
+    activeLow?: boolean;
+
+    /**
+     * Wiegand only, milliseconds without bits that end a frame (optional, default 25)
+     */
+    gap?: number;
+  });
+
+  /**
+   * @param data the bytes of the frame
+   * @param bits the number of valid bits in data
+   * @param tick the time stamp of the end of the frame, an unsigned 32 bit integer
+   * @param deviation the largest deviation in microseconds of any pulse from its nominal length
+   */
+  on(event: 'frame', listener: (data: Buffer, bits: number, tick: number, deviation: number) => void): this;
+  on(event: string | symbol, listener: (...args: any[]) => void): this;
+
+  /**
+   * DHT only. Sends the start signal which requests a frame from the sensor.
+   * @param startLength length of the start signal in milliseconds (optional, default 18)
+   */
+  request(startLength?: number): Decoder;
+
+  /**
+   * Stops decoding and releases resources.
+   */
+  close(): void;
+
+  static NEC: 'nec';
+  static RC5: 'rc5';
+  static DHT: 'dht';
+  static WIEGAND: 'wiegand';
+}
+
+/************************************
+ * EdgeTrigger
+ ************************************/
+
+export interface TriggerEdge {
+  gpio: number;
+  level: number;
+  tick: number | bigint;
+}
+
+export class EdgeTrigger extends EventEmitter {
+  /**
+   * Returns a new EdgeTrigger object that evaluates a trigger expression for each edge.
+   * @param expression  A trigger expression, e.g. 'rising(17) && high(18)'
+   * @param options     Used to configure the window of edges around matching edges
+   */
+  constructor(expression: string, options?: {
+    /**
+     * Number of edges preceding a matching edge to include (optional, default 0)
+     */
+    pre?: number;
+
+    /**
+     * Number of edges following a matching edge to include (optional, default 0)
+     */
+    post?: number;
+
+    /**
+     * If true, ticks are BigInt values with 64 bit range (optional, default false)
+     */
+    tick64?: boolean;
+  });
+
+  /**
+   * Number of matching edges so far.
+   */
+  readonly matches: number;
+
+  /**
+   * Number of windows dropped because JavaScript didn't keep up.
+   */
+  readonly dropped: number;
+
+  /**
+   * @param edges the window of edges
+   * @param triggerIndex the index of the matching edge in edges
+   */
+  on(event: 'trigger', listener: (edges: TriggerEdge[], triggerIndex: number) => void): this;
+  on(event: string | symbol, listener: (...args: any[]) => void): this;
+
+  /**
+   * Stops evaluating edges and releases resources.
+   */
+  close(): void;
+
+  /**
+   * Compiles a trigger expression. Throws if the expression has a syntax error.
+   * @param expression A trigger expression
+   */
+  static compile(expression: string): Uint32Array;
+}
+
+/************************************
+ * Capture
+ ************************************/
+
+/**
+ * The result of a capture, passed to the 'end' event.
+ */
+export type CaptureResult = {
+  /** records not emitted in 'data' events, 12 bytes per record */
+  records: Buffer;
+  /** mask of sampled GPIOs 0 to 31 */
+  mask_0_31: number;
+  /** mask of sampled GPIOs 32 to 53 */
+  mask_32_53: number;
+  /** sample interval in microseconds */
+  interval: number;
+  /** tick of the first sample, an unsigned 32 bit integer */
+  startTick: number;
+  /** 64-bit tick of the first sample */
+  startTick64: bigint;
+  /** number of samples taken */
+  samples: number;
+  /** false if the trigger timed out or the capture was stopped before it triggered */
+  triggered: boolean;
+  /** true if the capture ended early because the buffer was full */
+  truncated: boolean;
+};
+
+/**
+ * Options of a capture.
+ */
+export type CaptureOptions = {
+  /** bit mask of the GPIOs to sample (optional, defaults to GPIOs 0 to 31) */
+  mask?: number | bigint;
+  /** samples per second, at most 1000000 (optional, defaults to 100000) */
+  rateHz?: number;
+  /** duration of the capture in milliseconds (optional, defaults to 1000) */
+  durationMs?: number;
+  /** start sampling when (levels of GPIOs 0 to 31 & mask) equals levels (optional) */
+  trigger?: { mask: number, levels: number, timeoutMs?: number };
+  /** maximum number of records to buffer (optional, defaults to 262144) */
+  maxRecords?: number;
+  /** emit 'data' events with chunks of this many records (optional) */
+  chunkRecords?: number;
+};
+
+/**
+ * Logic analyzer capture sampled at a fixed rate by a native thread and stored run-length encoded.
+ */
+export class Capture extends EventEmitter {
+  /**
+   * Starts a capture.
+   * @param options   Used to configure what, how fast and how long to sample
+   */
+  constructor(options: CaptureOptions);
+
+  /**
+   * @param records a chunk of records
+   */
+  on(event: 'data', listener: (records: Buffer) => void): this;
+  /**
+   * @param result the result of the capture
+   */
+  on(event: 'end', listener: (result: CaptureResult) => void): this;
+  on(event: string | symbol, listener: (...args: any[]) => void): this;
+
+  /**
+   * Ends the capture early. The 'end' event is still emitted.
+   */
+  stop(): Capture;
+
+  /**
+   * The length of a record in bytes.
+   */
+  static RECORD_LENGTH: 12;
+}
+
+/**
+ * Starts a capture. See Capture.
+ */
+export function capture(options: CaptureOptions): Capture;
+
+/**
+ * Converts the records of a capture to Value Change Dump format.
+ * @param result    the result passed to the 'end' event
+ * @param options   names - an object mapping GPIO numbers to signal names (optional)
+ */
+export function captureToVcd(result: CaptureResult, options?: { names?: { [gpio: number]: string } }): string;
+
+/************************************
+ * Broker
+ ************************************/
+
+/**
+ * Publishes the alerts of a set of GPIOs to other processes through shared memory.
+ */
+export class Broker extends EventEmitter {
+  /**
+   * @param options   bits - the GPIOs to publish alerts for
+   *                  path - path of the Unix socket (optional, defaults to /tmp/pigpio-broker)
+   *                  capacity - number of records in the ring, a power of two (optional, defaults to 4096)
+   *                  mode - permissions of the shared memory and the socket (optional, defaults to 0o660)
+   */
+  constructor(options: {
+    bits: number,
+    path?: string,
+    capacity?: number,
+    mode?: number
+  });
+
+  /**
+   * Returns the sequence number of the last record published.
+   */
+  sequence(): number;
+
+  /**
+   * Returns the number of processes attached.
+   */
+  clientCount(): number;
+
+  /**
+   * Stops publishing alerts and releases the shared memory and the socket.
+   */
+  close(): void;
+}
+
+/**
+ * A process attached to a Broker.
+ */
+export class BrokerClient extends EventEmitter {
+  /**
+   * Returns an EventEmitter that emits 'alert' events for the GPIO.
+   */
+  gpio(gpio: number, options?: { tick64?: boolean }): EventEmitter;
+
+  /**
+   * Detaches from the Broker.
+   */
+  close(): void;
+
+  /**
+   * The length of a record in bytes.
+   */
+  static RECORD_LENGTH: 16;
+}
+
+/**
+ * Attaches to a Broker in another process.
+ * @param options   path - path of the Unix socket of the Broker (optional, defaults to /tmp/pigpio-broker)
+ */
+export function attachBroker(options?: { path?: string }): Promise<BrokerClient>;
+
+/************************************
+ * Remote
+ ************************************/
+
+/**
+ * A GPIO on a remote pigpio daemon. Setters queue a command and return this, getters return a Promise.
+ */
+export interface RemoteGpio extends EventEmitter {
+  readonly gpio: number;
+  mode(mode: number): RemoteGpio;
+  getMode(): Promise<number>;
+  pullUpDown(pud: number): RemoteGpio;
+  digitalRead(): Promise<number>;
+  digitalWrite(level: number): RemoteGpio;
+  trigger(pulseLen: number, level: number): RemoteGpio;
+  pwmWrite(dutyCycle: number): RemoteGpio;
+  analogWrite(dutyCycle: number): RemoteGpio;
+  hardwarePwmWrite(frequency: number, dutyCycle: number): RemoteGpio;
+  getPwmDutyCycle(): Promise<number>;
+  pwmRange(range: number): RemoteGpio;
+  getPwmRange(): Promise<number>;
+  getPwmRealRange(): Promise<number>;
+  pwmFrequency(frequency: number): RemoteGpio;
+  getPwmFrequency(): Promise<number>;
+  servoWrite(pulseWidth: number): RemoteGpio;
+  getServoPulseWidth(): Promise<number>;
+  enableAlert(): RemoteGpio;
+  disableAlert(): RemoteGpio;
+  glitchFilter(steady: number): RemoteGpio;
+}
+
+/**
+ * A GPIO bank on a remote pigpio daemon.
+ */
+export interface RemoteGpioBank {
+  read(): Promise<number>;
+  set(bits: number): RemoteGpioBank;
+  clear(bits: number): RemoteGpioBank;
+  bank(): number;
+}
+
+/**
+ * A notification stream from a remote pigpio daemon.
+ */
+export interface RemoteNotifier {
+  start(bits: number): RemoteNotifier;
+  stop(): RemoteNotifier;
+  close(): void;
+  dropped(): number;
+  stream(): NodeJS.ReadableStream;
+}
+
+/**
+ * A connection to a pigpio daemon. Commands are pipelined and the commands issued in the same tick are sent
+ * in a single write. Unlike the local API, getters return a Promise and errors of commands that don't return a
+ * Promise are reported after the call has returned. They are emitted as 'error' events or, if there is no 'error'
+ * listener, thrown by the next call or used to reject the Promise it returns.
+ */
+export interface RemotePi extends EventEmitter {
+  readonly host: string;
+  readonly port: number;
+
+  Gpio: {
+    new (gpio: number, options?: {
+      mode?: number,
+      pullUpDown?: number,
+      alert?: boolean,
+      tick64?: boolean
+    }): RemoteGpio;
+  } & typeof Gpio;
+  GpioBank: { new (bank?: number): RemoteGpioBank } & typeof GpioBank;
+  Notifier: { new (options?: { bits?: number }): RemoteNotifier } & typeof Notifier;
+
+  getTick(): Promise<number>;
+  hardwareRevision(): Promise<number>;
+  version(): Promise<number>;
+
+  waveClear(): void;
+  waveAddNew(): void;
+  waveAddGeneric(pulses: GenericWaveStep[]): Promise<number>;
+  waveCreate(): Promise<WaveId>;
+  waveDelete(waveId: WaveId): void;
+  waveTxSend(waveId: WaveId, waveMode: number): Promise<number>;
+  waveChain(chain: (WaveId | WaveChainCommands)[]): void;
+  waveTxAt(): Promise<WaveId>;
+  waveTxBusy(): Promise<1 | 0>;
+  waveTxStop(): void;
+  waveGetMicros(): Promise<number>;
+  waveGetHighMicros(): Promise<number>;
+  waveGetMaxMicros(): Promise<number>;
+  waveGetPulses(): Promise<number>;
+  waveGetHighPulses(): Promise<number>;
+  waveGetMaxPulses(): Promise<number>;
+  waveGetCbs(): Promise<number>;
+  waveGetHighCbs(): Promise<number>;
+  waveGetMaxCbs(): Promise<number>;
+
+  /**
+   * Returns the number of commands sent, the number of socket writes used to send them and the number of
+   * commands awaiting a response.
+   */
+  stats(): { commands: number, writes: number, pending: number };
+
+  close(): Promise<void>;
+}
+
+/**
+ * Connects to a pigpio daemon.
+ * @param options   host - defaults to the PIGPIO_ADDR environment variable or localhost
+ *                  port - defaults to the PIGPIO_PORT environment variable or 8888
+ */
+export function connect(options?: { host?: string, port?: number }): Promise<RemotePi>;
+
 /************************************
  * Configuration
  ************************************/
@@ -993,6 +1669,29 @@ export const CLOCK_PCM: number;
  */
 export function initialize(): void;
 
+/**
+ * Initialize the pigpio package on a thread pool thread. Resolves when the pigpio C library is ready.
+ * Synchronous functions and constructors that need the library block the event loop until a pending
+ * initialization has completed.
+ * @param config    clock - {microseconds, peripheral}, see configureClock (optional)
+ *                  interfaces - flags, see configureInterfaces (optional)
+ *                  socketPort - port number, see configureSocketPort (optional)
+ */
+export function initializeAsync(config?: {
+  clock?: { microseconds: number, peripheral: number },
+  interfaces?: number,
+  socketPort?: number
+}): Promise<{
+  version: number,
+  timing: {
+    configure: number,
+    queued: number,
+    initialize: number,
+    complete: number,
+    total: number
+  }
+}>;
+
 /**
  * Terminate the pigpio package
  */
@@ -1013,6 +1712,28 @@ export function configureClock(microseconds: number, peripheral: number): void;
  */
 export function configureSocketPort(port: number): void;
 
+/**
+ * Starts the native dispatcher thread and configures its scheduling. Returns the settings actually applied.
+ * @param options   cpu - the CPU the dispatcher thread should run on (optional, defaults to leaving the affinity unchanged)
+ *                  policy - 'other', 'fifo' or 'rr' (optional, defaults to 'other')
+ *                  priority - the real-time priority for 'fifo' and 'rr', 1 to 99 (optional, defaults to 0)
+ */
+export function configureDispatcher(options?: {
+  cpu?: number,
+  policy?: 'other' | 'fifo' | 'rr',
+  priority?: number
+}): {
+  cpus: number[],
+  policy: 'other' | 'fifo' | 'rr',
+  priority: number
+};
+
+/**
+ * Returns the number of interrupt and alert events that the dispatcher dropped because JavaScript fell more than
+ * 65536 events behind.
+ */
+export function dispatcherDropped(): number;
+
 /**
  * Bit Mask used to configure interfaces
  * Disables the FIFO socket file
@@ -1086,3 +1807,100 @@ export function getTick(): number;
  * let deltaUsec = pigpio.tickDiff(startUsec, currentUsec);
  */
 export function tickDiff(startTick: number, endTick: number): number;
+
+/**
+ * Gets the current 64-bit tick, the number of microseconds since system boot,
+ * as a bigint. Unlike the 32-bit tick returned by getTick() it doesn't wrap around.
+ */
+export function getTick64(): bigint;
+
+/**
+ * Converts a tick to a process.hrtime.bigint() compatible timestamp in nanoseconds.
+ * @param tick   a 64-bit tick as returned by getTick64(), or a recent 32-bit tick
+ */
+export function tickToHrtime(tick: number | bigint): bigint;
+
+/**
+ * Returns a SharedArrayBuffer of 32-bit words mirroring the state of the GPIOs. The mirror is updated natively
+ * from the alert samples and can be read from any thread without calling into the binding.
+ */
+export function stateMirror(): SharedArrayBuffer;
+
+/**
+ * Copies a consistent snapshot of the state mirror into target and returns target.
+ * @param buffer    the SharedArrayBuffer returned by stateMirror
+ * @param target    a Uint32Array with at least STATE_MIRROR_WORDS elements (optional)
+ */
+export function readStateMirror(buffer: SharedArrayBuffer, target?: Uint32Array): Uint32Array;
+
+/** Index of the sequence number, odd while the mirror is being updated */
+export const STATE_MIRROR_SEQUENCE: 0;
+/** Index of the levels of GPIOs 0 to 31 */
+export const STATE_MIRROR_LEVELS_0_31: 1;
+/** Index of the levels of GPIOs 32 to 53 */
+export const STATE_MIRROR_LEVELS_32_53: 2;
+/** Index of the low 32 bits of the tick of the last update */
+export const STATE_MIRROR_TICK: 3;
+/** Index of the high 32 bits of the tick of the last update */
+export const STATE_MIRROR_TICK_HI: 4;
+/** Index of the low 32 bits of the tick of the last edge on GPIO 0, add the GPIO number for other GPIOs */
+export const STATE_MIRROR_EDGE_TICK: 8;
+/** Index of the high 32 bits of the tick of the last edge on GPIO 0, add the GPIO number for other GPIOs */
+export const STATE_MIRROR_EDGE_TICK_HI: 40;
+/** Index of the edge count of GPIO 0, add the GPIO number for other GPIOs */
+export const STATE_MIRROR_EDGE_COUNT: 72;
+/** Number of 32-bit words in the state mirror */
+export const STATE_MIRROR_WORDS: 104;
+
+/**
+ * Reads the configuration and state of several GPIOs in one call. Fields that are unknown or don't apply are -1.
+ * @param mask      a bit for each GPIO to include (optional, defaults to all GPIOs 0 to 53)
+ * @param target    an Int32Array with at least SNAPSHOT_LENGTH elements (optional)
+ */
+export function snapshot(mask?: number | bigint, target?: Int32Array): Int32Array;
+
+/**
+ * Starts recording the stages of interrupts and alerts, waveform creation and transmission, and initialization.
+ */
+export function traceStart(): void;
+
+/**
+ * Stops recording trace events.
+ */
+export function traceStop(): void;
+
+/**
+ * Returns the recorded trace events in the Chrome trace event format.
+ */
+export function traceExport(): {
+  traceEvents: object[],
+  displayTimeUnit: 'ns',
+  otherData: { dropped: { [tid: number]: number } }
+};
+
+/**
+ * Writes the recorded trace events to a file in the Chrome trace event format.
+ * @param path  path of the file to write
+ */
+export function traceWrite(path: string): void;
+
+/** Offset of the mode in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_MODE: 0;
+/** Offset of the level in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_LEVEL: 1;
+/** Offset of the pull-up/down setting in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_PULL_UP_DOWN: 2;
+/** Offset of the PWM duty cycle in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_PWM_DUTY_CYCLE: 3;
+/** Offset of the PWM range in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_PWM_RANGE: 4;
+/** Offset of the PWM real range in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_PWM_REAL_RANGE: 5;
+/** Offset of the PWM frequency in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_PWM_FREQUENCY: 6;
+/** Offset of the servo pulse width in the fields of a GPIO in a snapshot */
+export const SNAPSHOT_SERVO_PULSE_WIDTH: 7;
+/** Number of fields per GPIO in a snapshot */
+export const SNAPSHOT_FIELDS: 8;
+/** Number of elements in a snapshot */
+export const SNAPSHOT_LENGTH: 432;
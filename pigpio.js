@@ -1,8 +1,11 @@
 /* jshint -W078 */
+/* global Atomics, BigInt */
 'use strict';
 
 const EventEmitter = require('events').EventEmitter;
 const fs = require('fs');
+const net = require('net');
+const Readable = require('stream').Readable;
 const pigpio = (() => {
   try {
     return require('bindings')('pigpio.node');
@@ -48,14 +51,26 @@ const util = require('util');
 /* ------------------------------------------------------------------------ */
 
 let initialized = false;
+let initializing = null;
 
 const initializePigpio = () => {
   if (!initialized) {
-    pigpio.gpioInitialise();
+    if (initializing) {
+      // Block until the pending asynchronous initialization has completed
+      // rather than initializing a second time.
+      pigpio.gpioInitialiseWait();
+    } else {
+      pigpio.gpioInitialise();
+    }
+
     initialized = true;
   }
 };
 
+const hrtimeMs = (hrtime) => {
+  return hrtime[0] * 1e3 + hrtime[1] / 1e6;
+};
+
 /* ------------------------------------------------------------------------ */
 /* Global                                                                   */
 /* ------------------------------------------------------------------------ */
@@ -68,10 +83,72 @@ module.exports.tickDiff = (startUsec, endUsec) => {
   return (endUsec >> 0) - (startUsec >> 0);
 };
 
+const TICK_HI = 0x100000000;
+
+const toTick64 = (tick, tickHi) => {
+  return BigInt(tickHi * TICK_HI + tick);
+};
+
+module.exports.getTick64 = () => {
+  return BigInt(pigpio.gpioTick64());
+};
+
+module.exports.tickToHrtime = (tick) => {
+  const tick64 = typeof tick === 'number' ?
+    pigpio.gpioTickExtend(tick >>> 0) :
+    Number(tick);
+
+  return BigInt(tick64) * BigInt(1000) +
+    BigInt(Math.round(pigpio.gpioTickOffset(tick64)));
+};
+
+// Splits a mask of GPIOs 0 to 53, a number or a BigInt, into the masks for
+// GPIOs 0-31 and 32-53.
+const splitGpioMask = (mask, defaultMasks) => {
+  if (typeof mask === 'number') {
+    return [mask >>> 0, Math.floor(mask / 0x100000000) & 0x3fffff];
+  } else if (mask !== undefined && mask !== null) {
+    mask = BigInt(mask);
+    return [
+      Number(mask & BigInt(0xffffffff)),
+      Number((mask >> BigInt(32)) & BigInt(0x3fffff))
+    ];
+  }
+
+  return defaultMasks;
+};
+
 /* WaveForm */
 
+// DMA control blocks used by each waveform that exists, keyed by wave id.
+// pigpio doesn't report the total in use so wavePlan needs this to know how
+// many control blocks are still free.
+const waveCbs = new Map();
+
+const waveCreate = () => {
+  const waveId = pigpio.gpioWaveCreate();
+  waveCbs.set(waveId, pigpio.gpioWaveGetCbs());
+  return waveId;
+};
+
+const waveDelete = (waveId) => {
+  pigpio.gpioWaveDelete(waveId);
+  waveCbs.delete(waveId);
+};
+
+const waveCbsInUse = () => {
+  let cbs = 0;
+
+  waveCbs.forEach((count) => {
+    cbs += count;
+  });
+
+  return cbs;
+};
+
 module.exports.waveClear = () => {
   pigpio.gpioWaveClear();
+  waveCbs.clear();
 };
 
 module.exports.waveAddNew = () => {
@@ -83,11 +160,11 @@ module.exports.waveAddGeneric = (pulses) => {
 };
 
 module.exports.waveCreate = () => {
-  return pigpio.gpioWaveCreate();
+  return waveCreate();
 };
 
 module.exports.waveDelete = (waveId) => {
-  pigpio.gpioWaveDelete(waveId);
+  waveDelete(waveId);
 };
 
 module.exports.waveTxSend = (waveId, waveMode) => {
@@ -147,10 +224,291 @@ module.exports.waveGetMaxCbs = () => {
   return pigpio.gpioWaveGetMaxCbs();
 };
 
+// Waveform planning. pigpio limits the number of pulses and the duration of
+// a single waveform, and the number of DMA control blocks (CBs) available to
+// all waveforms. The planner splits a pulse list into segments that respect
+// these limits, creates a waveform for each segment and returns a chain that
+// plays them back to back. The CB costs are conservative estimates of what
+// pigpio uses: one CB per GPIO set, one per GPIO clear, one per delay and
+// more for long delays, plus a start and an end CB per waveform.
+
+const WAVE_SEGMENT_CBS = 2;
+const WAVE_MAX_DELAY_PER_CB = 16383;
+const WAVE_MAX_WAVES = 250; // PI_MAX_WAVES
+const WAVE_MAX_CHAIN_LENGTH = 600;
+const WAVE_MAX_LOOP_COUNT = 65535;
+
+const checkWaveRepeat = (repeat) => {
+  repeat = repeat === true ? Infinity : (repeat || 1);
+
+  if (repeat !== Infinity && (repeat < 1 || repeat > WAVE_MAX_LOOP_COUNT)) {
+    throw new RangeError('repeat must be between 1 and ' + WAVE_MAX_LOOP_COUNT);
+  }
+
+  return repeat;
+};
+
+// The number of bytes a chain of waves waves needs, including the commands
+// that loop over them.
+const waveChainLength = (waves, repeat) => {
+  if (repeat === Infinity) {
+    return waves + 4;
+  }
+
+  return repeat > 1 ? waves + 6 : waves;
+};
+
+// Builds a chain for waveChain that transmits the waves once, repeat times
+// or, if repeat is Infinity, until stopped.
+const waveChainBytes = (waveIds, repeat) => {
+  if (repeat === Infinity) {
+    return [255, 0].concat(waveIds, [255, 3]);
+  } else if (repeat > 1) {
+    return [255, 0].concat(waveIds, [255, 1, repeat & 0xff, repeat >> 8]);
+  }
+
+  return waveIds.slice();
+};
+
+const wavePulseCbs = (pulse) => {
+  return (pulse.gpioOn ? 1 : 0) +
+    (pulse.gpioOff ? 1 : 0) +
+    Math.ceil(pulse.usDelay / WAVE_MAX_DELAY_PER_CB);
+};
+
+const waveSegment = (pulses, start, end) => {
+  const segment = {start: start, length: end - start, cbs: WAVE_SEGMENT_CBS, micros: 0};
+
+  for (let i = start; i !== end; i += 1) {
+    segment.cbs += wavePulseCbs(pulses[i]);
+    segment.micros += pulses[i].usDelay;
+  }
+
+  return segment;
+};
+
+const waveSplit = (pulses, maxPulses, maxMicros) => {
+  const segments = [];
+  let start = 0;
+  let safeEnd = 0;
+  let micros = 0;
+
+  for (let i = 0; i !== pulses.length; i += 1) {
+    const usDelay = pulses[i].usDelay;
+
+    if (usDelay > maxMicros) {
+      throw new Error('Pulse ' + i + ' is longer than a waveform can be');
+    }
+
+    if (i - start === maxPulses || micros + usDelay > maxMicros) {
+      // Cut after the last pulse with a delay if possible so that the
+      // levels set at the end of a segment are held for that delay.
+      const end = safeEnd > start ? safeEnd : i;
+
+      segments.push(waveSegment(pulses, start, end));
+
+      start = end;
+      micros = waveSegment(pulses, start, i).micros;
+    }
+
+    micros += usDelay;
+
+    if (usDelay > 0) {
+      safeEnd = i + 1;
+    }
+  }
+
+  if (pulses.length > start) {
+    segments.push(waveSegment(pulses, start, pulses.length));
+  }
+
+  return segments;
+};
+
+module.exports.wavePlan = (pulses, options) => {
+  options = options || {};
+
+  const repeat = checkWaveRepeat(options.repeat);
+  const maxPulses = options.maxPulses || pigpio.gpioWaveGetMaxPulses();
+  const maxMicros = options.maxMicros || pigpio.gpioWaveGetMaxMicros();
+  const maxCbs = (options.maxCbs || pigpio.gpioWaveGetMaxCbs()) -
+    waveCbsInUse() - (options.reservedCbs || 0);
+
+  const segments = waveSplit(pulses, maxPulses, maxMicros);
+  const cbs = segments.reduce((sum, segment) => sum + segment.cbs, 0);
+  const micros = segments.reduce((sum, segment) => sum + segment.micros, 0);
+
+  if (cbs > maxCbs) {
+    throw new Error(
+      'Waveform needs about ' + cbs + ' DMA control blocks but only ' +
+      maxCbs + ' are available'
+    );
+  }
+
+  if (segments.length > WAVE_MAX_WAVES ||
+      waveChainLength(segments.length, repeat) > WAVE_MAX_CHAIN_LENGTH) {
+    throw new Error('Waveform needs too many segments (' + segments.length + ')');
+  }
+
+  const waveIds = [];
+
+  try {
+    segments.forEach((segment) => {
+      pigpio.gpioWaveAddNew();
+      pigpio.gpioWaveAddGeneric(
+        pulses.slice(segment.start, segment.start + segment.length)
+      );
+      segment.waveId = waveCreate();
+      waveIds.push(segment.waveId);
+    });
+  } catch (err) {
+    waveIds.forEach((waveId) => waveDelete(waveId));
+    throw err;
+  }
+
+  return {
+    waveIds: waveIds,
+    chain: waveChainBytes(waveIds, repeat),
+    segments: segments,
+    cbs: cbs,
+    micros: micros
+  };
+};
+
+// Parallel bus pattern output. Each element of a Uint32Array is the levels
+// of GPIOs 0 to 31 for one sample period. The set and clear masks of the
+// pulses are computed natively from consecutive samples and identical
+// consecutive samples are merged. Long patterns are split into several
+// waveforms which are chained, optionally in a loop.
+
+const patternMask = (patterns) => {
+  let mask = 0;
+
+  for (let i = 0; i !== patterns.length; i += 1) {
+    mask |= patterns[i];
+  }
+
+  return mask >>> 0;
+};
+
+module.exports.playPattern = (patterns, options) => {
+  options = options || {};
+
+  if (!(patterns instanceof Uint32Array) || patterns.length === 0) {
+    throw new TypeError('patterns must be a non-empty Uint32Array');
+  }
+
+  const mask = (typeof options.mask === 'number' ?
+    options.mask : patternMask(patterns)) >>> 0;
+  const periodUs = options.periodUs || 1;
+  const repeat = checkWaveRepeat(options.repeat);
+
+  const maxSamples = Math.min(
+    options.maxPulses || pigpio.gpioWaveGetMaxPulses(),
+    Math.floor((options.maxMicros || pigpio.gpioWaveGetMaxMicros()) / periodUs)
+  );
+
+  if (maxSamples < 1) {
+    throw new RangeError('periodUs is longer than a waveform can be');
+  }
+
+  const segments = Math.ceil(patterns.length / maxSamples);
+
+  if (segments > WAVE_MAX_WAVES ||
+      waveChainLength(segments, repeat) > WAVE_MAX_CHAIN_LENGTH) {
+    throw new Error('Pattern needs too many waveforms (' + segments + ')');
+  }
+
+  initializePigpio();
+
+  for (let gpio = 0; gpio !== 32; gpio += 1) {
+    if (mask & (1 << gpio)) {
+      pigpio.gpioSetMode(gpio, Gpio.OUTPUT);
+    }
+  }
+
+  const waveIds = [];
+  let pulses = 0;
+
+  try {
+    for (let start = 0; start < patterns.length; start += maxSamples) {
+      const end = Math.min(start + maxSamples, patterns.length);
+
+      pigpio.gpioWaveAddNew();
+      pulses += pigpio.gpioWaveAddPattern(
+        patterns, start, end, mask, periodUs,
+        start === 0, start === 0 ? 0 : patterns[start - 1]
+      );
+      waveIds.push(waveCreate());
+    }
+  } catch (err) {
+    waveIds.forEach((waveId) => waveDelete(waveId));
+    throw err;
+  }
+
+  const chain = waveChainBytes(waveIds, repeat);
+
+  module.exports.waveChain(chain);
+
+  return {
+    waveIds: waveIds,
+    chain: chain,
+    samples: patterns.length,
+    pulses: pulses,
+    micros: patterns.length * periodUs
+  };
+};
+
 /* ------------------------------------------------------------------------ */
 /* Gpio                                                                     */
 /* ------------------------------------------------------------------------ */
 
+const coalesceWindow = (options) => {
+  return options && typeof options.coalesce === 'number' ?
+    options.coalesce :
+    0;
+};
+
+// Coalesced events have three additional arguments, the number of edges
+// collapsed into the event and the tick of the first edge.
+const eventHandler = (gpio, event) => {
+  return (gpioNo, level, tick, tickHi, edges, firstTick, firstTickHi) => {
+    const tick64 = gpio.tick64;
+
+    if (edges === undefined) {
+      gpio.emit(event, level, tick64 ? toTick64(tick, tickHi) : tick);
+    } else {
+      gpio.emit(event, level,
+        tick64 ? toTick64(tick, tickHi) : tick,
+        edges,
+        tick64 ? toTick64(firstTick, firstTickHi) : firstTick
+      );
+    }
+  };
+};
+
+// Watchdog timeouts for all GPIOs are passed to JavaScript in batches, each
+// timeout is 12 bytes, the tick and tickHi of the last edge and the
+// GPIO | level << 8. The Gpio object that most recently enabled the watchdog
+// for a GPIO emits its timeout events.
+const WATCHDOG_RECORD_LENGTH = 12;
+const watchdogGpios = [];
+
+const watchdogHandler = (buffer) => {
+  for (let i = 0; i < buffer.length; i += WATCHDOG_RECORD_LENGTH) {
+    const tick = buffer.readUInt32LE(i);
+    const tickHi = buffer.readUInt32LE(i + 4);
+    const word = buffer.readUInt32LE(i + 8);
+    const gpio = watchdogGpios[word & 0xff];
+
+    if (gpio) {
+      gpio.emit('timeout', (word >>> 8) & 0xff,
+        gpio.tick64 ? toTick64(tick, tickHi) : tick
+      );
+    }
+  }
+};
+
 class Gpio extends EventEmitter {
   constructor(gpio, options) {
     super();
@@ -160,6 +518,7 @@ class Gpio extends EventEmitter {
     options = options || {};
 
     this.gpio = +gpio;
+    this.tick64 = !!options.tick64;
 
     if (typeof options.mode === 'number') {
       this.mode(options.mode);
@@ -171,12 +530,17 @@ class Gpio extends EventEmitter {
 
     if (typeof options.edge === 'number') {
       this.enableInterrupt(options.edge,
-        typeof options.timeout === 'number' ? options.timeout : 0
+        typeof options.timeout === 'number' ? options.timeout : 0,
+        {coalesce: options.coalesce}
       );
     }
 
     if (typeof options.alert === 'boolean' && options.alert) {
-      this.enableAlert();
+      this.enableAlert({coalesce: options.coalesce});
+    }
+
+    if (typeof options.watchdog === 'number') {
+      this.enableWatchdog(options.watchdog);
     }
   }
 
@@ -255,13 +619,13 @@ class Gpio extends EventEmitter {
     return pigpio.gpioGetServoPulsewidth(this.gpio);
   }
 
-  enableInterrupt(edge, timeout) {
-    const handler = (gpio, level, tick) => {
-      this.emit('interrupt', level, tick);
-    };
+  enableInterrupt(edge, timeout, options) {
+    const handler = eventHandler(this, 'interrupt');
 
     timeout = timeout || 0;
-    pigpio.gpioSetISRFunc(this.gpio, +edge, +timeout, handler);
+    pigpio.gpioSetISRFunc(this.gpio, +edge, +timeout, handler,
+      coalesceWindow(options)
+    );
     return this;
   }
 
@@ -270,12 +634,10 @@ class Gpio extends EventEmitter {
     return this;
   }
 
-  enableAlert() {
-    const handler = (gpio, level, tick) => {
-      this.emit('alert', level, tick);
-    };
+  enableAlert(options) {
+    const handler = eventHandler(this, 'alert');
 
-    pigpio.gpioSetAlertFunc(this.gpio, handler);
+    pigpio.gpioSetAlertFunc(this.gpio, handler, coalesceWindow(options));
     return this;
   }
 
@@ -284,6 +646,20 @@ class Gpio extends EventEmitter {
     return this;
   }
 
+  enableWatchdog(timeout) {
+    pigpio.watchdogEnable(this.gpio, +timeout, watchdogHandler);
+    watchdogGpios[this.gpio] = this;
+    return this;
+  }
+
+  disableWatchdog() {
+    pigpio.watchdogDisable(this.gpio);
+    if (watchdogGpios[this.gpio] === this) {
+      watchdogGpios[this.gpio] = undefined;
+    }
+    return this;
+  }
+
   glitchFilter(steady) {
     pigpio.gpioGlitchFilter(this.gpio, +steady);
     return this;
@@ -371,26 +747,131 @@ class GpioBank {
 
 module.exports.GpioBank = GpioBank;
 
+/* ------------------------------------------------------------------------ */
+/* State mirror                                                             */
+/* ------------------------------------------------------------------------ */
+
+// Indexes of the 32 bit words in the state mirror
+const STATE_MIRROR_SEQUENCE = 0;
+const STATE_MIRROR_LEVELS_0_31 = 1;
+const STATE_MIRROR_LEVELS_32_53 = 2;
+const STATE_MIRROR_TICK = 3;
+const STATE_MIRROR_TICK_HI = 4;
+const STATE_MIRROR_EDGE_TICK = 8;
+const STATE_MIRROR_EDGE_TICK_HI = 40;
+const STATE_MIRROR_EDGE_COUNT = 72;
+const STATE_MIRROR_WORDS = 104;
+
+module.exports.stateMirror = () => {
+  initializePigpio();
+
+  return pigpio.stateMirror();
+};
+
+// Copies a consistent snapshot of the state mirror into target, a
+// Uint32Array with at least STATE_MIRROR_WORDS elements. Works with the
+// SharedArrayBuffer on any thread.
+module.exports.readStateMirror = (buffer, target) => {
+  const words = new Uint32Array(buffer);
+
+  target = target || new Uint32Array(STATE_MIRROR_WORDS);
+
+  while (true) {
+    const sequence = Atomics.load(words, STATE_MIRROR_SEQUENCE);
+
+    if ((sequence & 1) === 0) {
+      for (let i = 1; i !== STATE_MIRROR_WORDS; i += 1) {
+        target[i] = Atomics.load(words, i);
+      }
+
+      if (Atomics.load(words, STATE_MIRROR_SEQUENCE) === sequence) {
+        target[STATE_MIRROR_SEQUENCE] = sequence;
+        return target;
+      }
+    }
+  }
+};
+
+module.exports.STATE_MIRROR_SEQUENCE = STATE_MIRROR_SEQUENCE;
+module.exports.STATE_MIRROR_LEVELS_0_31 = STATE_MIRROR_LEVELS_0_31;
+module.exports.STATE_MIRROR_LEVELS_32_53 = STATE_MIRROR_LEVELS_32_53;
+module.exports.STATE_MIRROR_TICK = STATE_MIRROR_TICK;
+module.exports.STATE_MIRROR_TICK_HI = STATE_MIRROR_TICK_HI;
+module.exports.STATE_MIRROR_EDGE_TICK = STATE_MIRROR_EDGE_TICK;
+module.exports.STATE_MIRROR_EDGE_TICK_HI = STATE_MIRROR_EDGE_TICK_HI;
+module.exports.STATE_MIRROR_EDGE_COUNT = STATE_MIRROR_EDGE_COUNT;
+module.exports.STATE_MIRROR_WORDS = STATE_MIRROR_WORDS;
+
+/* ------------------------------------------------------------------------ */
+/* Snapshot                                                                 */
+/* ------------------------------------------------------------------------ */
+
+const SNAPSHOT_FIELDS = 8;
+const SNAPSHOT_LENGTH = (53 + 1) * SNAPSHOT_FIELDS; // (MAX_GPIO + 1) * FIELDS
+
+module.exports.snapshot = (mask, target) => {
+  initializePigpio();
+
+  const masks = splitGpioMask(mask, [0xffffffff, 0x3fffff]);
+
+  target = target || new Int32Array(SNAPSHOT_LENGTH);
+
+  pigpio.gpioSnapshot(masks[0], masks[1], target);
+
+  return target;
+};
+
+module.exports.SNAPSHOT_MODE = 0;
+module.exports.SNAPSHOT_LEVEL = 1;
+module.exports.SNAPSHOT_PULL_UP_DOWN = 2;
+module.exports.SNAPSHOT_PWM_DUTY_CYCLE = 3;
+module.exports.SNAPSHOT_PWM_RANGE = 4;
+module.exports.SNAPSHOT_PWM_REAL_RANGE = 5;
+module.exports.SNAPSHOT_PWM_FREQUENCY = 6;
+module.exports.SNAPSHOT_SERVO_PULSE_WIDTH = 7;
+module.exports.SNAPSHOT_FIELDS = SNAPSHOT_FIELDS;
+module.exports.SNAPSHOT_LENGTH = SNAPSHOT_LENGTH;
+
 /* ------------------------------------------------------------------------ */
 /* Notifier                                                                 */
 /* ------------------------------------------------------------------------ */
 
 const NOTIFICATION_PIPE_PATH_PREFIX = '/dev/pigpio';
 
+const NOTIFICATION_BUFFER_SIZE = 12 * 5000; // NOTIFICATION_LENGTH * 5000
+
 class Notifier {
   constructor(options) {
     initializePigpio();
 
     options = options || {};
 
-    this.handle = pigpio.gpioNotifyOpenWithSize(0);
+    this.shared = !!options.shared;
+
+    if (this.shared) {
+      // Notifications are read from a notification pipe shared with other
+      // shared Notifiers and filtered natively.
+      const handler = (buf) => {
+        return this.notificationStream.push(buf);
+      };
 
-    // set highWaterMark to a multiple of NOTIFICATION_LENGTH to avoid 'data'
-    // events being emitted with buffers containing partial notifications.
-    this.notificationStream =
-      fs.createReadStream(NOTIFICATION_PIPE_PATH_PREFIX + this.handle, {
-        highWaterMark: Notifier.NOTIFICATION_LENGTH * 5000
+      this.handle = pigpio.notifyHubSubscribe(NOTIFICATION_BUFFER_SIZE, handler);
+
+      this.notificationStream = new Readable({
+        read: () => {
+          pigpio.notifyHubResume(this.handle);
+        }
       });
+    } else {
+      this.handle = pigpio.gpioNotifyOpenWithSize(0);
+
+      // set highWaterMark to a multiple of NOTIFICATION_LENGTH to avoid 'data'
+      // events being emitted with buffers containing partial notifications.
+      this.notificationStream =
+        fs.createReadStream(NOTIFICATION_PIPE_PATH_PREFIX + this.handle, {
+          highWaterMark: NOTIFICATION_BUFFER_SIZE
+        });
+    }
 
     if (typeof options.bits === 'number') {
       this.start(options.bits);
@@ -398,17 +879,34 @@ class Notifier {
   }
 
   start(bits) {
-    pigpio.gpioNotifyBegin(this.handle, +bits);
+    if (this.shared) {
+      pigpio.notifyHubBegin(this.handle, +bits);
+    } else {
+      pigpio.gpioNotifyBegin(this.handle, +bits);
+    }
     return this;
   }
 
   stop() {
-    pigpio.gpioNotifyPause(this.handle);
+    if (this.shared) {
+      pigpio.notifyHubBegin(this.handle, 0);
+    } else {
+      pigpio.gpioNotifyPause(this.handle);
+    }
     return this;
   }
 
   close() {
-    pigpio.gpioNotifyClose(this.handle);
+    if (this.shared) {
+      pigpio.notifyHubClose(this.handle);
+      this.notificationStream.push(null);
+    } else {
+      pigpio.gpioNotifyClose(this.handle);
+    }
+  }
+
+  dropped() {
+    return this.shared ? pigpio.notifyHubDropped(this.handle) : 0;
   }
 
   stream() {
@@ -422,42 +920,1887 @@ class Notifier {
 module.exports.Notifier = Notifier;
 
 /* ------------------------------------------------------------------------ */
-/* Configuration                                                            */
+/* Encoder                                                                  */
 /* ------------------------------------------------------------------------ */
 
-module.exports.hardwareRevision = () => {
-  return pigpio.gpioHardwareRevision();
-};
+class Encoder extends EventEmitter {
+  constructor(gpioA, gpioB, options) {
+    super();
 
-module.exports.configureInterfaces = (interfaces) => {
-  return pigpio.gpioCfgInterfaces(+interfaces);
-};
+    initializePigpio();
 
-module.exports.DISABLE_FIFO_IF = 1; // PI_DISABLE_FIFO_IF;
-module.exports.DISABLE_SOCK_IF = 2; // PI_DISABLE_SOCK_IF;
-module.exports.LOCALHOST_SOCK_IF = 4; // PI_LOCALHOST_SOCK_IF;
-module.exports.DISABLE_ALERT = 8; // PI_DISABLE_ALERT;
-module.exports.WAVE_MODE_ONE_SHOT = 0; // PI_WAVE_MODE_ONE_SHOT
-module.exports.WAVE_MODE_REPEAT = 1; // PI_WAVE_MODE_REPEAT
-module.exports.WAVE_MODE_ONE_SHOT_SYNC = 2; // PI_WAVE_MODE_ONE_SHOT_SYNC
-module.exports.WAVE_MODE_REPEAT_SYNC = 3; // PI_WAVE_MODE_REPEAT_SYNC
+    options = options || {};
 
-module.exports.initialize = () => {
-  initializePigpio();
-};
+    this.gpioA = +gpioA;
+    this.gpioB = +gpioB;
 
-module.exports.terminate = () => {
-  pigpio.gpioTerminate();
+    pigpio.gpioSetMode(this.gpioA, Gpio.INPUT);
+    pigpio.gpioSetMode(this.gpioB, Gpio.INPUT);
 
-  initialized = false;
-};
+    if (typeof options.pullUpDown === 'number') {
+      pigpio.gpioSetPullUpDown(this.gpioA, options.pullUpDown);
+      pigpio.gpioSetPullUpDown(this.gpioB, options.pullUpDown);
+    }
 
-module.exports.configureClock = (microseconds, peripheral) => {
-  pigpio.gpioCfgClock(+microseconds, +peripheral);
-};
+    const handler = (position, velocity, invalid, tick) => {
+      this.emit('position', position, velocity, invalid, tick);
+    };
 
-module.exports.configureSocketPort = (port) => {
-  pigpio.gpioCfgSocketPort(+port);
+    this.handle = pigpio.encoderOpen(
+      this.gpioA,
+      this.gpioB,
+      typeof options.counts === 'number' ? options.counts : 0,
+      typeof options.interval === 'number' ? options.interval : 0,
+      handler
+    );
+  }
+
+  position() {
+    return pigpio.encoderPosition(this.handle);
+  }
+
+  setPosition(position) {
+    pigpio.encoderSetPosition(this.handle, +position);
+    return this;
+  }
+
+  close() {
+    pigpio.encoderClose(this.handle);
+  }
+}
+
+module.exports.Encoder = Encoder;
+
+/* ------------------------------------------------------------------------ */
+/* Controller                                                               */
+/* ------------------------------------------------------------------------ */
+
+const CONTROLLER_INPUT_TYPES = ['frequency', 'pulseWidth', 'encoder'];
+const CONTROLLER_OUTPUT_TYPES = ['pwm', 'hardwarePwm', 'servo'];
+
+// The order of the parameters must match the CONTROLLER_* parameter enum in
+// pigpio.cc.
+const CONTROLLER_PARAMS = ['kp', 'ki', 'kd', 'setpoint', 'min', 'max'];
+
+const CONTROLLER_RECORD_LENGTH = 40;
+
+const controllerParams = (params) =>
+  Float64Array.from(CONTROLLER_PARAMS.map((name) => params[name]));
+
+const gpioNumber = (gpio) => typeof gpio === 'object' ? gpio.gpio : +gpio;
+
+class Controller extends EventEmitter {
+  constructor(options) {
+    super();
+
+    initializePigpio();
+
+    options = options || {};
+
+    const input = options.input || {};
+    const output = options.output || {};
+    const inputType = CONTROLLER_INPUT_TYPES.indexOf(input.type);
+    const outputType = CONTROLLER_OUTPUT_TYPES.indexOf(output.type);
+    const rateHz = typeof options.rateHz === 'number' ? options.rateHz : 100;
+    const frequency = typeof output.frequency === 'number' ?
+      output.frequency : 25000;
+
+    if (inputType === -1) {
+      throw new Error('unknown controller input type ' + input.type);
+    }
+
+    if (outputType === -1) {
+      throw new Error('unknown controller output type ' + output.type);
+    }
+
+    if (!(rateHz >= 1 && rateHz <= 10000)) {
+      throw new Error('rateHz must be from 1 to 10000');
+    }
+
+    const inputGpios = Array.isArray(input.gpio) ?
+      input.gpio.map(gpioNumber) : [gpioNumber(input.gpio)];
+    const outputGpio = gpioNumber(output.gpio);
+
+    let max;
+    let min = 0;
+
+    if (outputType === 0) {
+      max = pigpio.gpioGetPWMrange(outputGpio);
+    } else if (outputType === 1) {
+      max = 1000000;
+    } else {
+      min = 500;
+      max = 2500;
+    }
+
+    this.params = {kp: 0, ki: 0, kd: 0, setpoint: 0, min: min, max: max};
+    CONTROLLER_PARAMS.forEach((name) => {
+      if (typeof options[name] === 'number') {
+        this.params[name] = options[name];
+      }
+    });
+
+    inputGpios.forEach((gpio) => {
+      pigpio.gpioSetMode(gpio, Gpio.INPUT);
+
+      if (typeof input.pullUpDown === 'number') {
+        pigpio.gpioSetPullUpDown(gpio, input.pullUpDown);
+      }
+    });
+
+    const tick64 = !!options.tick64;
+
+    const handler = (buffer, dropped) => {
+      const samples = [];
+
+      for (let i = 0; i < buffer.length; i += CONTROLLER_RECORD_LENGTH) {
+        const tick = buffer.readDoubleLE(i);
+
+        samples.push({
+          tick: tick64 ? BigInt(tick) : tick % TICK_HI,
+          setpoint: buffer.readDoubleLE(i + 8),
+          measurement: buffer.readDoubleLE(i + 16),
+          output: buffer.readDoubleLE(i + 24),
+          integral: buffer.readDoubleLE(i + 32)
+        });
+      }
+
+      this.dropped = dropped;
+      this.emit('telemetry', samples);
+    };
+
+    this.input = {type: input.type, gpio: inputGpios};
+    this.output = {type: output.type, gpio: outputGpio};
+    this.dropped = 0;
+    this.handle = pigpio.controllerOpen(
+      inputType,
+      inputGpios[0],
+      inputGpios.length > 1 ? inputGpios[1] : inputGpios[0],
+      outputType,
+      outputGpio,
+      frequency,
+      Math.round(1000000 / rateHz),
+      typeof options.telemetry === 'number' ? options.telemetry : 0,
+      controllerParams(this.params),
+      handler
+    );
+  }
+
+  set(params) {
+    params = params || {};
+
+    CONTROLLER_PARAMS.forEach((name) => {
+      if (typeof params[name] === 'number') {
+        this.params[name] = params[name];
+      }
+    });
+
+    pigpio.controllerSet(this.handle, controllerParams(this.params), !!params.reset);
+    return this;
+  }
+
+  close() {
+    if (this.handle !== null) {
+      pigpio.controllerClose(this.handle);
+      this.handle = null;
+    }
+  }
+
+  static get FREQUENCY() { return 'frequency'; }
+  static get PULSE_WIDTH() { return 'pulseWidth'; }
+  static get ENCODER() { return 'encoder'; }
+
+  static get PWM() { return 'pwm'; }
+  static get HARDWARE_PWM() { return 'hardwarePwm'; }
+  static get SERVO() { return 'servo'; }
+}
+
+module.exports.Controller = Controller;
+
+/* ------------------------------------------------------------------------ */
+/* Decoder                                                                  */
+/* ------------------------------------------------------------------------ */
+
+const DECODER_PULSE = 0;
+const DECODER_RC5 = 1;
+const DECODER_DHT = 2;
+const DECODER_WIEGAND = 3;
+
+const NEC = {
+  headerMark: 9000,
+  headerSpace: 4500,
+  repeatSpace: 2250,
+  zeroMark: 562,
+  zeroSpace: 562,
+  oneMark: 562,
+  oneSpace: 1687,
+  bits: 32,
+  tolerance: 25,
+  activeLow: true,
+  msbFirst: false
+};
+
+// The order of the parameters must match the PULSE_* enum in pigpio.cc.
+const pulseParams = (protocol) => [
+  protocol.headerMark || 0,
+  protocol.headerSpace || 0,
+  protocol.repeatSpace || 0,
+  protocol.zeroMark,
+  protocol.zeroSpace,
+  protocol.oneMark,
+  protocol.oneSpace,
+  protocol.bits,
+  typeof protocol.tolerance === 'number' ? protocol.tolerance : 25,
+  protocol.activeLow ? 1 : 0,
+  protocol.msbFirst ? 1 : 0
+].map((param) => +param);
+
+class Decoder extends EventEmitter {
+  constructor(gpio, protocol, options) {
+    super();
+
+    initializePigpio();
+
+    options = options || {};
+
+    const gpios = Array.isArray(gpio) ? gpio.map((g) => +g) : [+gpio];
+    let type;
+    let params;
+
+    if (typeof protocol === 'object' && protocol !== null) {
+      type = DECODER_PULSE;
+      params = pulseParams(protocol);
+    } else if (protocol === Decoder.NEC) {
+      type = DECODER_PULSE;
+      params = pulseParams(NEC);
+    } else if (protocol === Decoder.RC5) {
+      type = DECODER_RC5;
+      params = [options.activeLow === false ? 0 : 1];
+    } else if (protocol === Decoder.DHT) {
+      type = DECODER_DHT;
+      params = [];
+    } else if (protocol === Decoder.WIEGAND) {
+      type = DECODER_WIEGAND;
+      params = [typeof options.gap === 'number' ? options.gap : 25];
+    } else {
+      throw new Error('unknown decoder protocol ' + protocol);
+    }
+
+    gpios.forEach((g) => {
+      pigpio.gpioSetMode(g, Gpio.INPUT);
+
+      if (typeof options.pullUpDown === 'number') {
+        pigpio.gpioSetPullUpDown(g, +options.pullUpDown);
+      }
+    });
+
+    const handler = (data, bits, tick, deviation) => {
+      this.emit('frame', data, bits, tick, deviation);
+    };
+
+    this.gpios = gpios;
+    this.handle = pigpio.decoderOpen(type, gpios, params, handler);
+  }
+
+  request(startLength) {
+    const gpio = this.gpios[0];
+
+    pigpio.gpioWrite(gpio, 0);
+    setTimeout(() => {
+      pigpio.gpioSetMode(gpio, Gpio.INPUT);
+    }, typeof startLength === 'number' ? startLength : 18);
+
+    return this;
+  }
+
+  close() {
+    pigpio.decoderClose(this.handle);
+  }
+
+  static get NEC() { return 'nec'; }
+  static get RC5() { return 'rc5'; }
+  static get DHT() { return 'dht'; }
+  static get WIEGAND() { return 'wiegand'; }
+}
+
+module.exports.Decoder = Decoder;
+
+/* ------------------------------------------------------------------------ */
+/* Edge trigger                                                             */
+/* ------------------------------------------------------------------------ */
+
+// The order of the opcodes must match the EDGE_TRIGGER_OP_* enum in
+// pigpio.cc.
+const EDGE_TRIGGER_OP = {
+  rising: 0,
+  falling: 1,
+  edge: 2,
+  high: 3,
+  low: 4,
+  quiet: 5,
+  '!': 6,
+  '&&': 7,
+  '||': 8
+};
+
+const EDGE_TRIGGER_ARGS = {
+  rising: 1,
+  falling: 1,
+  edge: 1,
+  high: 1,
+  low: 1,
+  quiet: 2
+};
+
+const EDGE_TRIGGER_RECORD_LENGTH = 12;
+
+// Must match EDGE_TRIGGER_MAX_WINDOW in pigpio.cc.
+const EDGE_TRIGGER_MAX_WINDOW = 4096;
+
+// Compiles a trigger expression to a program for the stack machine in
+// pigpio.cc. Operator precedence is ! then && then ||.
+const compileEdgeTrigger = (expression) => {
+  const tokens = [];
+  const tokenRe = /\s*(?:(\d+)|([A-Za-z]+)|(&&|\|\||[!(),]))/y;
+  const program = [];
+  let pos = 0;
+
+  expression = String(expression);
+
+  while (pos < expression.length && expression.slice(pos).trim() !== '') {
+    tokenRe.lastIndex = pos;
+    const match = tokenRe.exec(expression);
+
+    if (match === null) {
+      throw new Error('unexpected character in trigger expression at ' + pos);
+    }
+
+    const value = match[1] || match[2] || match[3];
+
+    tokens.push({
+      type: match[1] ? 'number' : match[2] ? 'name' : value,
+      value: value,
+      pos: tokenRe.lastIndex - value.length
+    });
+    pos = tokenRe.lastIndex;
+  }
+
+  let next = 0;
+
+  const fail = (message) => {
+    const token = tokens[next];
+    const where = token ? ' at ' + token.pos : ' at end of trigger expression';
+    throw new Error(message + where);
+  };
+
+  const expect = (type) => {
+    if (next === tokens.length || tokens[next].type !== type) {
+      fail('expected ' + type);
+    }
+    return tokens[next++];
+  };
+
+  const accept = (type) => {
+    if (next !== tokens.length && tokens[next].type === type) {
+      next += 1;
+      return true;
+    }
+    return false;
+  };
+
+  let parseOr;
+
+  const parsePrimary = () => {
+    if (accept('(')) {
+      parseOr();
+      expect(')');
+      return;
+    }
+
+    const start = next;
+    const name = expect('name').value;
+    const argCount = EDGE_TRIGGER_ARGS[name];
+
+    if (argCount === undefined) {
+      next = start;
+      fail('unknown trigger function ' + name);
+    }
+
+    expect('(');
+    const args = [];
+    for (let i = 0; i !== argCount; i += 1) {
+      if (i !== 0) {
+        expect(',');
+      }
+      args.push(+expect('number').value);
+    }
+    expect(')');
+
+    if (args[0] > 31) {
+      next = start;
+      fail('trigger functions require a GPIO from 0 to 31');
+    }
+
+    if (name === 'quiet' && args[1] > 0xffffffff) {
+      next = start;
+      fail('quiet period too long');
+    }
+
+    program.push(EDGE_TRIGGER_OP[name], ...args);
+  };
+
+  const parseNot = () => {
+    if (accept('!')) {
+      parseNot();
+      program.push(EDGE_TRIGGER_OP['!']);
+    } else {
+      parsePrimary();
+    }
+  };
+
+  const parseAnd = () => {
+    parseNot();
+    while (accept('&&')) {
+      parseNot();
+      program.push(EDGE_TRIGGER_OP['&&']);
+    }
+  };
+
+  parseOr = () => {
+    parseAnd();
+    while (accept('||')) {
+      parseAnd();
+      program.push(EDGE_TRIGGER_OP['||']);
+    }
+  };
+
+  parseOr();
+
+  if (next !== tokens.length) {
+    fail('unexpected ' + tokens[next].value);
+  }
+
+  return Uint32Array.from(program);
+};
+
+class EdgeTrigger extends EventEmitter {
+  constructor(expression, options) {
+    super();
+
+    options = options || {};
+
+    const pre = options.pre || 0;
+    const post = options.post || 0;
+
+    [pre, post].forEach((edges) => {
+      if (!Number.isInteger(edges) || edges < 0 || edges > EDGE_TRIGGER_MAX_WINDOW) {
+        throw new RangeError('pre and post must be integers from 0 to ' + EDGE_TRIGGER_MAX_WINDOW);
+      }
+    });
+
+    if (pre + post > EDGE_TRIGGER_MAX_WINDOW) {
+      throw new RangeError('The sum of pre and post may be at most ' + EDGE_TRIGGER_MAX_WINDOW);
+    }
+
+    initializePigpio();
+
+    const program = compileEdgeTrigger(expression);
+    const tick64 = !!options.tick64;
+
+    const handler = (buffer, triggerIndex, matches, dropped) => {
+      const edges = [];
+
+      for (let i = 0; i < buffer.length; i += EDGE_TRIGGER_RECORD_LENGTH) {
+        const tick = buffer.readUInt32LE(i);
+        const tickHi = buffer.readUInt32LE(i + 4);
+        const word = buffer.readUInt32LE(i + 8);
+
+        edges.push({
+          gpio: word & 0xff,
+          level: (word >>> 8) & 0xff,
+          tick: tick64 ? toTick64(tick, tickHi) : tick
+        });
+      }
+
+      this.matches = matches;
+      this.dropped = dropped;
+      this.emit('trigger', edges, triggerIndex);
+    };
+
+    this.expression = String(expression);
+    this.program = program;
+    this.matches = 0;
+    this.dropped = 0;
+    this.handle = pigpio.edgeTriggerOpen(program, pre, post, handler);
+  }
+
+  close() {
+    if (this.handle !== null) {
+      pigpio.edgeTriggerClose(this.handle);
+      this.handle = null;
+    }
+  }
+
+  static compile(expression) {
+    return compileEdgeTrigger(expression);
+  }
+}
+
+module.exports.EdgeTrigger = EdgeTrigger;
+
+/* ------------------------------------------------------------------------ */
+/* Capture                                                                  */
+/* ------------------------------------------------------------------------ */
+
+const CAPTURE_EVENT_DATA = 0;
+const CAPTURE_EVENT_END = 1;
+const CAPTURE_RECORD_LENGTH = 12;
+const CAPTURE_MAX_RECORDS = 262144;
+
+class Capture extends EventEmitter {
+  constructor(options) {
+    super();
+
+    initializePigpio();
+
+    options = options || {};
+
+    const masks = splitGpioMask(options.mask, [0xffffffff, 0]);
+    const rateHz = typeof options.rateHz === 'number' ? options.rateHz : 100000;
+    const durationMs = typeof options.durationMs === 'number' ?
+      options.durationMs : 1000;
+    const trigger = options.trigger || {};
+    const chunkRecords = options.chunkRecords || 0;
+
+    if (!(rateHz > 0 && rateHz <= 1000000)) {
+      throw new Error('rateHz must be greater than 0 and at most 1000000');
+    }
+
+    this.mask_0_31 = masks[0];
+    this.mask_32_53 = masks[1];
+
+    const handler = (event, arg1, arg2, arg3, arg4, arg5, arg6, arg7) => {
+      if (event === CAPTURE_EVENT_DATA) {
+        this.emit('data', arg1);
+      } else if (event === CAPTURE_EVENT_END) {
+        pigpio.captureClose(this.handle);
+        this.handle = null;
+
+        this.emit('end', {
+          records: arg7,
+          mask_0_31: this.mask_0_31,
+          mask_32_53: this.mask_32_53,
+          interval: arg6,
+          startTick: arg1,
+          startTick64: toTick64(arg1, arg2),
+          samples: arg3,
+          triggered: arg4,
+          truncated: arg5
+        });
+      }
+    };
+
+    this.handle = pigpio.captureStart(
+      this.mask_0_31,
+      this.mask_32_53,
+      Math.max(1, Math.round(1000000 / rateHz)),
+      Math.round(durationMs * 1000),
+      (trigger.mask || 0) >>> 0,
+      (trigger.levels || 0) >>> 0,
+      Math.round((trigger.timeoutMs || 0) * 1000),
+      options.maxRecords || CAPTURE_MAX_RECORDS,
+      chunkRecords,
+      handler
+    );
+  }
+
+  stop() {
+    if (this.handle !== null) {
+      pigpio.captureStop(this.handle);
+    }
+
+    return this;
+  }
+
+  static get RECORD_LENGTH() { return CAPTURE_RECORD_LENGTH; }
+}
+
+module.exports.Capture = Capture;
+
+module.exports.capture = (options) => {
+  return new Capture(options);
+};
+
+const vcdIdentifier = (gpio) => {
+  return String.fromCharCode(33 + gpio);
+};
+
+// Converts the records of a capture to Value Change Dump format.
+module.exports.captureToVcd = (result, options) => {
+  options = options || {};
+
+  const names = options.names || {};
+  const gpios = [];
+
+  for (let gpio = 0; gpio <= 53; gpio += 1) {
+    const mask = gpio < 32 ? result.mask_0_31 : result.mask_32_53;
+
+    if ((mask >>> (gpio & 31)) & 1) {
+      gpios.push(gpio);
+    }
+  }
+
+  const lines = [
+    '$version pigpio capture $end',
+    '$timescale 1us $end',
+    '$scope module gpio $end'
+  ];
+
+  gpios.forEach((gpio) => {
+    const name = (names[gpio] || 'GPIO' + gpio).replace(/\s/g, '_');
+    lines.push('$var wire 1 ' + vcdIdentifier(gpio) + ' ' + name + ' $end');
+  });
+
+  lines.push('$upscope $end', '$enddefinitions $end');
+
+  const records = result.records;
+  let time = 0;
+  let previous_0_31 = 0;
+  let previous_32_53 = 0;
+
+  for (let offset = 0; offset < records.length; offset += CAPTURE_RECORD_LENGTH) {
+    const levels_0_31 = records.readUInt32LE(offset);
+    const levels_32_53 = records.readUInt32LE(offset + 4);
+    const changes = [];
+
+    gpios.forEach((gpio) => {
+      const levels = gpio < 32 ? levels_0_31 : levels_32_53;
+      const previous = gpio < 32 ? previous_0_31 : previous_32_53;
+      const level = (levels >>> (gpio & 31)) & 1;
+
+      if (offset === 0 || level !== ((previous >>> (gpio & 31)) & 1)) {
+        changes.push(level + vcdIdentifier(gpio));
+      }
+    });
+
+    if (changes.length !== 0) {
+      lines.push('#' + time);
+      lines.push.apply(lines, changes);
+    }
+
+    previous_0_31 = levels_0_31;
+    previous_32_53 = levels_32_53;
+    time += records.readUInt32LE(offset + 8);
+  }
+
+  lines.push('#' + time);
+
+  return lines.join('\n') + '\n';
+};
+
+/* ------------------------------------------------------------------------ */
+/* Broker                                                                   */
+/* ------------------------------------------------------------------------ */
+
+// Only one process can use the pigpio C library. A Broker in that process
+// publishes alerts natively to a shared memory ring. Other processes attach
+// with attachBroker. The Unix socket of the broker tells them the name of
+// the shared memory object and lets each side notice when the other goes
+// away. Alerts are read from shared memory rather than sent on the socket.
+
+const BROKER_DEFAULT_PATH = '/tmp/pigpio-broker';
+const BROKER_DEFAULT_CAPACITY = 4096;
+const BROKER_DEFAULT_MODE = 0o660;
+const BROKER_RECORD_LENGTH = 16;
+
+const BROKER_EVENT_DATA = 0;
+const BROKER_CLOSE_TIMEOUT = 1000;
+
+class Broker extends EventEmitter {
+  constructor(options) {
+    super();
+
+    initializePigpio();
+
+    options = options || {};
+
+    this.path = options.path || BROKER_DEFAULT_PATH;
+    this.name = '/pigpio-broker.' + process.pid;
+    this.clients = new Set();
+
+    const mode = options.mode === undefined ? BROKER_DEFAULT_MODE : +options.mode;
+
+    pigpio.brokerOpen(this.name, +options.bits >>> 0,
+      +(options.capacity || BROKER_DEFAULT_CAPACITY), mode
+    );
+
+    // Remove the socket of a broker that terminated without being closed
+    try {
+      if (fs.lstatSync(this.path).isSocket()) {
+        fs.unlinkSync(this.path);
+      }
+    } catch (err) {
+      if (err.code !== 'ENOENT') {
+        throw err;
+      }
+    }
+
+    const hello = JSON.stringify({
+      name: this.name,
+      bits: +options.bits >>> 0,
+      capacity: +(options.capacity || BROKER_DEFAULT_CAPACITY)
+    }) + '\n';
+
+    this.server = net.createServer((socket) => {
+      this.clients.add(socket);
+
+      socket.on('error', () => {});
+      socket.on('close', () => this.clients.delete(socket));
+      socket.write(hello);
+      socket.resume();
+    });
+
+    this.server.on('error', (err) => this.emit('error', err));
+
+    this.server.listen(this.path, () => {
+      fs.chmodSync(this.path, mode);
+      this.emit('listening');
+    });
+  }
+
+  sequence() {
+    return pigpio.brokerSequence();
+  }
+
+  clientCount() {
+    return this.clients.size;
+  }
+
+  close() {
+    pigpio.brokerClose();
+
+    this.server.close();
+    this.clients.forEach((socket) => socket.destroy());
+  }
+}
+
+module.exports.Broker = Broker;
+
+class BrokerClient extends EventEmitter {
+  constructor(socket, hello) {
+    super();
+
+    this.socket = socket;
+    this.bits = hello.bits;
+    this.capacity = hello.capacity;
+    this.gpios = [];
+    this.closed = false;
+    this.closeTimer = null;
+
+    this.handle = pigpio.brokerAttach(hello.name, (event, records, lost) => {
+      if (event === BROKER_EVENT_DATA) {
+        this.deliver(records, lost);
+      } else {
+        this.close();
+      }
+    });
+
+    // The broker keeps the socket open until it's closed or terminates. A
+    // broker that's closed marks the ring as closed before it closes the
+    // socket and the end event follows once the ring has been drained, so
+    // records that haven't been read yet aren't lost. A broker that
+    // terminated without being closed can't mark the ring so only wait a
+    // while for the end event.
+    socket.on('error', () => {});
+    socket.on('close', () => {
+      if (!this.closed) {
+        this.closeTimer = setTimeout(() => this.close(), BROKER_CLOSE_TIMEOUT);
+      }
+    });
+  }
+
+  deliver(records, lost) {
+    if (lost > 0) {
+      this.emit('lost', lost);
+    }
+
+    if (records.length === 0) {
+      return;
+    }
+
+    this.emit('alerts', records);
+
+    for (let offset = 0; offset !== records.length; offset += BROKER_RECORD_LENGTH) {
+      const gpio = this.gpios[records[offset + 12]];
+
+      if (gpio) {
+        const tick = records.readUInt32LE(offset + 4);
+
+        gpio.emit('alert', records[offset + 13], gpio.tick64 ?
+          toTick64(tick, records.readUInt32LE(offset + 8)) :
+          tick
+        );
+      }
+    }
+  }
+
+  gpio(gpio, options) {
+    gpio = +gpio;
+
+    if (!this.gpios[gpio]) {
+      if (!(this.bits & (1 << gpio))) {
+        throw new RangeError('GPIO ' + gpio + ' is not published by the broker');
+      }
+
+      this.gpios[gpio] = new EventEmitter();
+      this.gpios[gpio].gpio = gpio;
+    }
+
+    this.gpios[gpio].tick64 = !!(options && options.tick64);
+
+    return this.gpios[gpio];
+  }
+
+  close() {
+    if (!this.closed) {
+      this.closed = true;
+      clearTimeout(this.closeTimer);
+      pigpio.brokerDetach(this.handle);
+      this.socket.destroy();
+      this.emit('close');
+    }
+  }
+
+  static get RECORD_LENGTH() { return BROKER_RECORD_LENGTH; }
+}
+
+module.exports.BrokerClient = BrokerClient;
+
+module.exports.attachBroker = (options) => {
+  options = options || {};
+
+  const path = options.path || BROKER_DEFAULT_PATH;
+
+  return new Promise((resolve, reject) => {
+    const socket = net.connect(path);
+    let received = '';
+
+    socket.setEncoding('utf8');
+    socket.once('error', reject);
+
+    const onData = (chunk) => {
+      received += chunk;
+
+      const end = received.indexOf('\n');
+      if (end === -1) {
+        return;
+      }
+
+      socket.removeListener('data', onData);
+      socket.removeListener('error', reject);
+
+      try {
+        resolve(new BrokerClient(socket, JSON.parse(received.slice(0, end))));
+      } catch (err) {
+        socket.destroy();
+        reject(err);
+      }
+    };
+
+    socket.on('data', onData);
+  });
+};
+
+/* ------------------------------------------------------------------------ */
+/* Remote                                                                   */
+/* ------------------------------------------------------------------------ */
+
+// A backend for the pigpio daemon, pigpiod, reachable over a socket. A
+// command is a 16 byte request, the little endian uint32 values cmd, p1, p2
+// and p3, followed by p3 bytes of extension. pigpiod answers each command
+// with a 16 byte response whose last value is the result, in the order the
+// commands were received. Commands are therefore pipelined rather than
+// waiting for a round trip each, and all commands issued in the same tick
+// are batched into a single write by corking the socket. Notifications are
+// received on a second socket opened with the NOIB command.
+
+const REMOTE_DEFAULT_HOST = 'localhost';
+const REMOTE_DEFAULT_PORT = 8888;
+
+const REMOTE_CMD_LENGTH = 16;
+const REMOTE_REPORT_LENGTH = 12;
+
+const REMOTE_CMD = {
+  MODES: 0, MODEG: 1, PUD: 2, READ: 3, WRITE: 4, PWM: 5, PRS: 6, PFS: 7,
+  SERVO: 8, BR1: 10, BR2: 11, BC1: 12, BC2: 13, BS1: 14, BS2: 15, TICK: 16,
+  HWVER: 17, NB: 19, NP: 20, NC: 21, PRG: 22, PFG: 23, PRRG: 24, PIGPV: 26,
+  WVCLR: 27, WVAG: 28, WVBSY: 32, WVHLT: 33, WVSM: 34, WVSP: 35, WVSC: 36,
+  TRIG: 37, WVCRE: 49, WVDEL: 50, WVNEW: 53, GDC: 83, GPW: 84, HP: 86,
+  WVCHA: 93, FG: 97, NOIB: 99, WVTXM: 100, WVTAT: 101
+};
+
+const REMOTE_CMD_NAMES = Object.keys(REMOTE_CMD).reduce((names, name) => {
+  names[REMOTE_CMD[name]] = name;
+  return names;
+}, {});
+
+// Commands with results that are unsigned rather than an error code when
+// negative.
+const REMOTE_UNSIGNED_RESULTS = [
+  REMOTE_CMD.BR1, REMOTE_CMD.BR2, REMOTE_CMD.TICK, REMOTE_CMD.HWVER
+];
+
+const REMOTE_NTFY_FLAGS_WDOG = 1 << 5; // PI_NTFY_FLAGS_WDOG
+const REMOTE_NTFY_FLAGS_ALIVE = 1 << 6; // PI_NTFY_FLAGS_ALIVE
+const REMOTE_NTFY_FLAGS_EVENT = 1 << 7; // PI_NTFY_FLAGS_EVENT
+const REMOTE_NTFY_FLAGS_GPIO = 0x1f;
+
+const remoteRequest = (cmd, p1, p2, ext) => {
+  const extLength = ext ? ext.length : 0;
+  const buf = Buffer.alloc(REMOTE_CMD_LENGTH + extLength);
+
+  buf.writeUInt32LE(cmd, 0);
+  buf.writeUInt32LE((p1 || 0) >>> 0, 4);
+  buf.writeUInt32LE((p2 || 0) >>> 0, 8);
+  buf.writeUInt32LE(extLength, 12);
+
+  if (ext) {
+    ext.copy(buf, REMOTE_CMD_LENGTH);
+  }
+
+  return buf;
+};
+
+const remoteUint32 = (value) => {
+  const buf = Buffer.alloc(4);
+
+  buf.writeUInt32LE(value >>> 0, 0);
+
+  return buf;
+};
+
+const remoteError = (res, cmd) => {
+  const err = new Error('pigpio error ' + res + ' in ' + REMOTE_CMD_NAMES[cmd]);
+
+  err.code = res;
+
+  return err;
+};
+
+const copyConstants = (target, source) => {
+  Object.getOwnPropertyNames(source).forEach((name) => {
+    if (/^[A-Z][A-Z0-9_]*$/.test(name)) {
+      Object.defineProperty(target, name,
+        Object.getOwnPropertyDescriptor(source, name)
+      );
+    }
+  });
+};
+
+// A socket opened with NOIB. After the response to NOIB, which is the
+// notification handle, pigpiod sends 12 byte reports. onReports is called
+// with buffers containing complete reports and returns false to apply
+// backpressure.
+class RemoteNotificationSocket {
+  constructor(pi, onReports, onEnd) {
+    this.pi = pi;
+    this.received = null;
+    this.handle = null;
+
+    this.opened = new Promise((resolve, reject) => {
+      this.resolveOpened = resolve;
+      this.rejectOpened = reject;
+    });
+
+    this.socket = net.connect(pi.port, pi.host, () => {
+      this.socket.setNoDelay(true);
+      this.socket.write(remoteRequest(REMOTE_CMD.NOIB));
+    });
+
+    this.socket.on('data', (chunk) => {
+      let buf = this.received ? Buffer.concat([this.received, chunk]) : chunk;
+
+      if (this.handle === null) {
+        if (buf.length < REMOTE_CMD_LENGTH) {
+          this.received = buf;
+          return;
+        }
+
+        const res = buf.readInt32LE(12);
+
+        if (res < 0) {
+          this.rejectOpened(remoteError(res, REMOTE_CMD.NOIB));
+          this.socket.destroy();
+          return;
+        }
+
+        this.handle = res;
+        this.resolveOpened(res);
+        buf = buf.slice(REMOTE_CMD_LENGTH);
+      }
+
+      const length = buf.length - buf.length % REMOTE_REPORT_LENGTH;
+
+      this.received = length === buf.length ? null : buf.slice(length);
+
+      if (length > 0 && onReports(buf.slice(0, length)) === false) {
+        this.socket.pause();
+      }
+    });
+
+    this.socket.on('error', (err) => {
+      this.rejectOpened(err);
+      this.pi.reportError(err);
+    });
+
+    this.socket.on('close', () => {
+      this.rejectOpened(new Error('Notification socket closed'));
+      onEnd();
+    });
+  }
+
+  // Runs fn with the notification handle once it's known. If the socket
+  // can't be opened, the error has already been emitted on the connection.
+  whenOpen(fn) {
+    this.opened.then(fn, () => {});
+  }
+
+  start(bits) {
+    this.whenOpen((handle) => this.pi.sendPost(REMOTE_CMD.NB, handle, bits));
+  }
+
+  stop() {
+    this.whenOpen((handle) => this.pi.sendPost(REMOTE_CMD.NP, handle));
+  }
+
+  resume() {
+    this.socket.resume();
+  }
+
+  close() {
+    const end = () => this.socket.end();
+
+    if (this.handle === null) {
+      this.rejectOpened(new Error('Notification socket closed'));
+      this.socket.destroy();
+    } else {
+      this.pi.sendCommand(REMOTE_CMD.NC, this.handle).then(end, end);
+    }
+  }
+}
+
+class RemoteGpio extends EventEmitter {
+  constructor(pi, gpio, options) {
+    super();
+
+    options = options || {};
+
+    this.pi = pi;
+    this.gpio = +gpio;
+    this.tick64 = !!options.tick64;
+
+    if (typeof options.mode === 'number') {
+      this.mode(options.mode);
+    }
+
+    if (typeof options.pullUpDown === 'number') {
+      this.pullUpDown(options.pullUpDown);
+    }
+
+    if (typeof options.edge === 'number') {
+      this.enableInterrupt(options.edge);
+    }
+
+    if (typeof options.alert === 'boolean' && options.alert) {
+      this.enableAlert();
+    }
+  }
+
+  mode(mode) {
+    this.pi.post(REMOTE_CMD.MODES, this.gpio, +mode);
+    return this;
+  }
+
+  getMode() {
+    return this.pi.command(REMOTE_CMD.MODEG, this.gpio);
+  }
+
+  pullUpDown(pud) {
+    this.pi.post(REMOTE_CMD.PUD, this.gpio, +pud);
+    return this;
+  }
+
+  digitalRead() {
+    return this.pi.command(REMOTE_CMD.READ, this.gpio);
+  }
+
+  digitalWrite(level) {
+    this.pi.post(REMOTE_CMD.WRITE, this.gpio, +level);
+    return this;
+  }
+
+  trigger(pulseLen, level) {
+    this.pi.post(REMOTE_CMD.TRIG, this.gpio, +pulseLen, remoteUint32(+level));
+    return this;
+  }
+
+  pwmWrite(dutyCycle) {
+    this.pi.post(REMOTE_CMD.PWM, this.gpio, +dutyCycle);
+    return this;
+  }
+
+  hardwarePwmWrite(frequency, dutyCycle) {
+    this.pi.post(REMOTE_CMD.HP, this.gpio, +frequency,
+      remoteUint32(+dutyCycle)
+    );
+    return this;
+  }
+
+  getPwmDutyCycle() {
+    return this.pi.command(REMOTE_CMD.GDC, this.gpio);
+  }
+
+  pwmRange(range) {
+    this.pi.post(REMOTE_CMD.PRS, this.gpio, +range);
+    return this;
+  }
+
+  getPwmRange() {
+    return this.pi.command(REMOTE_CMD.PRG, this.gpio);
+  }
+
+  getPwmRealRange() {
+    return this.pi.command(REMOTE_CMD.PRRG, this.gpio);
+  }
+
+  pwmFrequency(frequency) {
+    this.pi.post(REMOTE_CMD.PFS, this.gpio, +frequency);
+    return this;
+  }
+
+  getPwmFrequency() {
+    return this.pi.command(REMOTE_CMD.PFG, this.gpio);
+  }
+
+  servoWrite(pulseWidth) {
+    this.pi.post(REMOTE_CMD.SERVO, this.gpio, +pulseWidth);
+    return this;
+  }
+
+  getServoPulseWidth() {
+    return this.pi.command(REMOTE_CMD.GPW, this.gpio);
+  }
+
+  enableInterrupt() {
+    throw new Error('Interrupts are not available with pigpiod, use alerts');
+  }
+
+  disableInterrupt() {
+    return this;
+  }
+
+  enableAlert() {
+    if (this.gpio > Gpio.MAX_USER_GPIO) {
+      throw new RangeError('Alerts are only available for GPIOs 0 to 31');
+    }
+
+    this.pi.setAlert(this.gpio, this);
+    return this;
+  }
+
+  disableAlert() {
+    if (this.pi.alerts[this.gpio] === this) {
+      this.pi.setAlert(this.gpio, null);
+    }
+    return this;
+  }
+
+  glitchFilter(steady) {
+    this.pi.post(REMOTE_CMD.FG, this.gpio, +steady);
+    return this;
+  }
+}
+
+RemoteGpio.prototype.analogWrite = RemoteGpio.prototype.pwmWrite;
+
+copyConstants(RemoteGpio, Gpio);
+
+class RemoteGpioBank {
+  constructor(pi, bank) {
+    this.pi = pi;
+    this.bankNo = +bank || GpioBank.BANK1;
+  }
+
+  read() {
+    return this.pi.command(this.bankNo === GpioBank.BANK1 ?
+      REMOTE_CMD.BR1 : REMOTE_CMD.BR2
+    );
+  }
+
+  set(bits) {
+    this.pi.post(this.bankNo === GpioBank.BANK1 ?
+      REMOTE_CMD.BS1 : REMOTE_CMD.BS2, +bits
+    );
+    return this;
+  }
+
+  clear(bits) {
+    this.pi.post(this.bankNo === GpioBank.BANK1 ?
+      REMOTE_CMD.BC1 : REMOTE_CMD.BC2, +bits
+    );
+    return this;
+  }
+
+  bank() {
+    return this.bankNo;
+  }
+}
+
+copyConstants(RemoteGpioBank, GpioBank);
+
+class RemoteNotifier {
+  constructor(pi, options) {
+    options = options || {};
+
+    this.notificationStream = new Readable({
+      read: () => {
+        this.notifications.resume();
+      }
+    });
+
+    this.notifications = new RemoteNotificationSocket(pi,
+      (reports) => this.notificationStream.push(reports),
+      () => this.notificationStream.push(null)
+    );
+
+    if (typeof options.bits === 'number') {
+      this.start(options.bits);
+    }
+  }
+
+  start(bits) {
+    this.notifications.start(+bits);
+    return this;
+  }
+
+  stop() {
+    this.notifications.stop();
+    return this;
+  }
+
+  close() {
+    this.notifications.close();
+  }
+
+  dropped() {
+    return 0;
+  }
+
+  stream() {
+    return this.notificationStream;
+  }
+}
+
+copyConstants(RemoteNotifier, Notifier);
+
+class RemotePi extends EventEmitter {
+  constructor(socket, host, port) {
+    super();
+
+    const pi = this;
+
+    this.socket = socket;
+    this.host = host;
+    this.port = port;
+    this.closed = false;
+    this.pending = [];
+    this.received = null;
+    this.corked = false;
+    this.counters = {commands: 0, writes: 0};
+    this.deferredError = null;
+
+    this.alerts = [];
+    this.alertBits = 0;
+    this.alertNotifications = null;
+    this.lastLevels = 0;
+    this.lastTick = 0;
+    this.tickHi = 0;
+
+    this.Gpio = class extends RemoteGpio {
+      constructor(gpio, options) {
+        super(pi, gpio, options);
+      }
+    };
+
+    this.GpioBank = class extends RemoteGpioBank {
+      constructor(bank) {
+        super(pi, bank);
+      }
+    };
+
+    this.Notifier = class extends RemoteNotifier {
+      constructor(options) {
+        super(pi, options);
+      }
+    };
+
+    socket.on('data', (chunk) => this.onData(chunk));
+
+    socket.on('error', (err) => {
+      this.error = err;
+    });
+
+    socket.on('close', () => {
+      const err = this.error || new Error('Connection to pigpiod closed');
+
+      this.closed = true;
+      this.pending.splice(0).forEach((request) => request.reject(err));
+      this.emit('close');
+    });
+  }
+
+  send(cmd, p1, p2, ext, resolve, reject) {
+    if (this.closed) {
+      return process.nextTick(reject,
+        new Error('Connection to pigpiod closed')
+      );
+    }
+
+    this.pending.push({cmd: cmd, resolve: resolve, reject: reject});
+    this.counters.commands += 1;
+
+    if (!this.corked) {
+      this.corked = true;
+      this.socket.cork();
+
+      process.nextTick(() => {
+        this.corked = false;
+        this.counters.writes += 1;
+        this.socket.uncork();
+      });
+    }
+
+    this.socket.write(remoteRequest(cmd, p1, p2, ext));
+  }
+
+  // Reports an error that no caller is waiting for. Without an 'error'
+  // listener, emitting it would throw from a socket callback and terminate
+  // the process, so the error is kept and surfaced by the next call instead.
+  reportError(err) {
+    if (this.listenerCount('error') > 0) {
+      this.emit('error', err);
+    } else if (this.deferredError === null) {
+      this.deferredError = err;
+    }
+  }
+
+  takeDeferredError() {
+    const err = this.deferredError;
+    this.deferredError = null;
+    return err;
+  }
+
+  // Sends a command and returns a Promise for its result.
+  sendCommand(cmd, p1, p2, ext) {
+    return new Promise((resolve, reject) => {
+      this.send(cmd, p1, p2, ext, resolve, reject);
+    });
+  }
+
+  // Sends a command without waiting for its result. Errors are reported
+  // with reportError.
+  sendPost(cmd, p1, p2, ext) {
+    this.send(cmd, p1, p2, ext, null, (err) => this.reportError(err));
+  }
+
+  // command and post are used by the methods of the API. A deferred error
+  // rejects the Promise of command or is thrown by post and the command
+  // isn't sent.
+  command(cmd, p1, p2, ext) {
+    const err = this.takeDeferredError();
+
+    return err ? Promise.reject(err) : this.sendCommand(cmd, p1, p2, ext);
+  }
+
+  post(cmd, p1, p2, ext) {
+    const err = this.takeDeferredError();
+
+    if (err) {
+      throw err;
+    }
+
+    this.sendPost(cmd, p1, p2, ext);
+  }
+
+  onData(chunk) {
+    const buf = this.received ? Buffer.concat([this.received, chunk]) : chunk;
+    let offset = 0;
+
+    for (; buf.length - offset >= REMOTE_CMD_LENGTH; offset += REMOTE_CMD_LENGTH) {
+      const request = this.pending.shift();
+
+      if (!request) {
+        continue;
+      }
+
+      if (REMOTE_UNSIGNED_RESULTS.indexOf(request.cmd) !== -1) {
+        request.resolve(buf.readUInt32LE(offset + 12));
+      } else {
+        const res = buf.readInt32LE(offset + 12);
+
+        if (res < 0) {
+          request.reject(remoteError(res, request.cmd));
+        } else if (request.resolve) {
+          request.resolve(res);
+        }
+      }
+    }
+
+    this.received = offset === buf.length ? null : buf.slice(offset);
+  }
+
+  setAlert(gpio, remoteGpio) {
+    this.alerts[gpio] = remoteGpio;
+
+    this.alertBits = this.alerts.reduce((bits, alertGpio, gpioNo) => {
+      return alertGpio ? (bits | (1 << gpioNo)) >>> 0 : bits;
+    }, 0);
+
+    if (this.alertNotifications === null) {
+      if (this.alertBits === 0) {
+        return;
+      }
+
+      this.sendCommand(REMOTE_CMD.BR1).then((levels) => {
+        this.lastLevels = levels;
+      }, () => {});
+
+      this.alertNotifications = new RemoteNotificationSocket(this,
+        (reports) => this.onAlertReports(reports),
+        () => {
+          this.alertNotifications = null;
+        }
+      );
+    }
+
+    this.alertNotifications.start(this.alertBits);
+  }
+
+  emitAlert(gpioNo, level, tick) {
+    const gpio = this.alerts[gpioNo];
+
+    if (gpio) {
+      gpio.emit('alert', level,
+        gpio.tick64 ? toTick64(tick, this.tickHi) : tick
+      );
+    }
+  }
+
+  onAlertReports(reports) {
+    for (let offset = 0; offset !== reports.length; offset += REMOTE_REPORT_LENGTH) {
+      const flags = reports.readUInt16LE(offset + 2);
+      const tick = reports.readUInt32LE(offset + 4);
+      const levels = reports.readUInt32LE(offset + 8);
+
+      if (tick < this.lastTick) {
+        this.tickHi += 1;
+      }
+      this.lastTick = tick;
+
+      if (flags & REMOTE_NTFY_FLAGS_WDOG) {
+        this.emitAlert(flags & REMOTE_NTFY_FLAGS_GPIO, Gpio.TIMEOUT, tick);
+      } else if (!(flags & (REMOTE_NTFY_FLAGS_ALIVE | REMOTE_NTFY_FLAGS_EVENT))) {
+        const changed = (levels ^ this.lastLevels) & this.alertBits;
+
+        this.lastLevels = levels;
+
+        for (let gpioNo = 0; gpioNo !== 32; gpioNo += 1) {
+          if (changed & (1 << gpioNo)) {
+            this.emitAlert(gpioNo, (levels >>> gpioNo) & 1, tick);
+          }
+        }
+      }
+    }
+  }
+
+  stats() {
+    return {
+      commands: this.counters.commands,
+      writes: this.counters.writes,
+      pending: this.pending.length
+    };
+  }
+
+  getTick() {
+    return this.command(REMOTE_CMD.TICK);
+  }
+
+  hardwareRevision() {
+    return this.command(REMOTE_CMD.HWVER);
+  }
+
+  version() {
+    return this.command(REMOTE_CMD.PIGPV);
+  }
+
+  waveClear() {
+    this.post(REMOTE_CMD.WVCLR);
+  }
+
+  waveAddNew() {
+    this.post(REMOTE_CMD.WVNEW);
+  }
+
+  waveAddGeneric(pulses) {
+    const ext = Buffer.alloc(pulses.length * 12);
+
+    pulses.forEach((pulse, i) => {
+      // Same GPIO number to bit mask conversion as the local gpioWaveAddGeneric
+      ext.writeUInt32LE(pulse.gpioOn > 0 ? (1 << pulse.gpioOn) >>> 0 : 0, i * 12);
+      ext.writeUInt32LE(pulse.gpioOff > 0 ? (1 << pulse.gpioOff) >>> 0 : 0, i * 12 + 4);
+      ext.writeUInt32LE(pulse.usDelay >>> 0, i * 12 + 8);
+    });
+
+    return this.command(REMOTE_CMD.WVAG, 0, 0, ext);
+  }
+
+  waveCreate() {
+    return this.command(REMOTE_CMD.WVCRE);
+  }
+
+  waveDelete(waveId) {
+    this.post(REMOTE_CMD.WVDEL, waveId);
+  }
+
+  waveTxSend(waveId, waveMode) {
+    return this.command(REMOTE_CMD.WVTXM, waveId, waveMode);
+  }
+
+  waveChain(chain) {
+    this.post(REMOTE_CMD.WVCHA, 0, 0, Buffer.from(chain));
+  }
+
+  waveTxAt() {
+    return this.command(REMOTE_CMD.WVTAT);
+  }
+
+  waveTxBusy() {
+    return this.command(REMOTE_CMD.WVBSY);
+  }
+
+  waveTxStop() {
+    this.post(REMOTE_CMD.WVHLT);
+  }
+
+  waveGetMicros() {
+    return this.command(REMOTE_CMD.WVSM, 0);
+  }
+
+  waveGetHighMicros() {
+    return this.command(REMOTE_CMD.WVSM, 1);
+  }
+
+  waveGetMaxMicros() {
+    return this.command(REMOTE_CMD.WVSM, 2);
+  }
+
+  waveGetPulses() {
+    return this.command(REMOTE_CMD.WVSP, 0);
+  }
+
+  waveGetHighPulses() {
+    return this.command(REMOTE_CMD.WVSP, 1);
+  }
+
+  waveGetMaxPulses() {
+    return this.command(REMOTE_CMD.WVSP, 2);
+  }
+
+  waveGetCbs() {
+    return this.command(REMOTE_CMD.WVSC, 0);
+  }
+
+  waveGetHighCbs() {
+    return this.command(REMOTE_CMD.WVSC, 1);
+  }
+
+  waveGetMaxCbs() {
+    return this.command(REMOTE_CMD.WVSC, 2);
+  }
+
+  close() {
+    if (this.alertNotifications) {
+      this.alertNotifications.close();
+    }
+
+    return new Promise((resolve) => {
+      if (this.closed) {
+        return resolve();
+      }
+
+      this.socket.once('close', () => resolve());
+      this.socket.end();
+    });
+  }
+}
+
+module.exports.connect = (options) => {
+  options = options || {};
+
+  const host = options.host || process.env.PIGPIO_ADDR || REMOTE_DEFAULT_HOST;
+  const port = +(options.port || process.env.PIGPIO_PORT || REMOTE_DEFAULT_PORT);
+
+  return new Promise((resolve, reject) => {
+    const socket = net.connect(port, host);
+
+    socket.once('error', reject);
+
+    socket.once('connect', () => {
+      socket.removeListener('error', reject);
+      socket.setNoDelay(true);
+      resolve(new RemotePi(socket, host, port));
+    });
+  });
+};
+
+/* ------------------------------------------------------------------------ */
+/* Trace                                                                    */
+/* ------------------------------------------------------------------------ */
+
+// Indexed by the TRACE_* event names of the native tracer
+const TRACE_EVENT_NAMES = [
+  'isr handler',
+  'alert handler',
+  'dispatcher queue',
+  'alert listeners',
+  'sem_g wait',
+  'uv_async_send',
+  'event loop wakeup',
+  'isr callback',
+  'alert callback',
+  'gpioWaveCreate',
+  'gpioWaveTxSend',
+  'gpioWaveChain',
+  'gpioInitialise',
+  'control step'
+];
+
+const TRACE_EVENT_LENGTH = 24;
+const TRACE_NO_GPIO = 0xff;
+const TRACE_FLOW_IN = 1;
+const TRACE_FLOW_OUT = 2;
+
+module.exports.traceStart = () => {
+  pigpio.traceEnable();
+};
+
+module.exports.traceStop = () => {
+  pigpio.traceDisable();
+};
+
+// Converts the events recorded by the native tracer to the Chrome trace
+// event format which can be loaded by chrome://tracing and Perfetto. The
+// stages of an interrupt or alert are linked by a flow identified by the
+// GPIO and tick of the event.
+module.exports.traceExport = () => {
+  const pid = process.pid;
+  const traceEvents = [{
+    name: 'process_name', ph: 'M', pid: pid, tid: 0, args: {name: 'pigpio'}
+  }];
+  const dropped = {};
+
+  pigpio.traceCollect().forEach((thread) => {
+    const tid = thread[0];
+    const events = thread[3];
+
+    traceEvents.push({
+      name: 'thread_name', ph: 'M', pid: pid, tid: tid, args: {name: thread[1]}
+    });
+
+    dropped[tid] = thread[2];
+
+    for (let offset = 0; offset !== events.length; offset += TRACE_EVENT_LENGTH) {
+      const start = events.readUInt32LE(offset + 4) * TICK_HI +
+        events.readUInt32LE(offset);
+      const gpio = events[offset + 14];
+      const flags = events[offset + 15];
+      const arg0 = events.readUInt32LE(offset + 16);
+      const arg1 = events.readUInt32LE(offset + 20);
+
+      const traceEvent = {
+        name: TRACE_EVENT_NAMES[events.readUInt16LE(offset + 12)],
+        cat: gpio === TRACE_NO_GPIO ? 'pigpio' : 'gpio',
+        ph: 'X',
+        ts: start / 1000,
+        dur: events.readUInt32LE(offset + 8) / 1000,
+        pid: pid,
+        tid: tid
+      };
+
+      if (gpio === TRACE_NO_GPIO) {
+        traceEvent.args = {result: arg0 | 0};
+
+        if (arg1 !== 0) {
+          traceEvent.args.arg = arg1;
+        }
+      } else {
+        traceEvent.args = {gpio: gpio, tick: arg0, level: arg1};
+        traceEvent.bind_id = gpio + ':' + arg0;
+
+        if (flags & TRACE_FLOW_IN) {
+          traceEvent.flow_in = true;
+        }
+
+        if (flags & TRACE_FLOW_OUT) {
+          traceEvent.flow_out = true;
+        }
+      }
+
+      traceEvents.push(traceEvent);
+    }
+  });
+
+  return {
+    traceEvents: traceEvents,
+    displayTimeUnit: 'ns',
+    otherData: {dropped: dropped}
+  };
+};
+
+module.exports.traceWrite = (path) => {
+  fs.writeFileSync(path, JSON.stringify(module.exports.traceExport()));
+};
+
+/* ------------------------------------------------------------------------ */
+/* Configuration                                                            */
+/* ------------------------------------------------------------------------ */
+
+module.exports.hardwareRevision = () => {
+  return pigpio.gpioHardwareRevision();
+};
+
+module.exports.configureInterfaces = (interfaces) => {
+  return pigpio.gpioCfgInterfaces(+interfaces);
+};
+
+module.exports.DISABLE_FIFO_IF = 1; // PI_DISABLE_FIFO_IF;
+module.exports.DISABLE_SOCK_IF = 2; // PI_DISABLE_SOCK_IF;
+module.exports.LOCALHOST_SOCK_IF = 4; // PI_LOCALHOST_SOCK_IF;
+module.exports.DISABLE_ALERT = 8; // PI_DISABLE_ALERT;
+module.exports.WAVE_MODE_ONE_SHOT = 0; // PI_WAVE_MODE_ONE_SHOT
+module.exports.WAVE_MODE_REPEAT = 1; // PI_WAVE_MODE_REPEAT
+module.exports.WAVE_MODE_ONE_SHOT_SYNC = 2; // PI_WAVE_MODE_ONE_SHOT_SYNC
+module.exports.WAVE_MODE_REPEAT_SYNC = 3; // PI_WAVE_MODE_REPEAT_SYNC
+
+module.exports.initialize = () => {
+  initializePigpio();
+};
+
+module.exports.initializeAsync = (config) => {
+  if (initializing) {
+    return initializing;
+  }
+
+  if (initialized) {
+    return Promise.resolve({
+      version: pigpio.gpioVersion(),
+      timing: {configure: 0, queued: 0, initialize: 0, complete: 0, total: 0}
+    });
+  }
+
+  config = config || {};
+
+  const start = hrtimeMs(process.hrtime());
+
+  try {
+    if (config.clock !== undefined) {
+      pigpio.gpioCfgClock(+config.clock.microseconds, +config.clock.peripheral);
+    }
+
+    if (config.interfaces !== undefined) {
+      pigpio.gpioCfgInterfaces(+config.interfaces);
+    }
+
+    if (config.socketPort !== undefined) {
+      pigpio.gpioCfgSocketPort(+config.socketPort);
+    }
+  } catch (err) {
+    return Promise.reject(err);
+  }
+
+  const configured = hrtimeMs(process.hrtime());
+
+  const promise = new Promise((resolve, reject) => {
+    pigpio.gpioInitialiseAsync((err, version, executeStart, executeEnd) => {
+      if (initializing === promise) {
+        initializing = null;
+      }
+
+      if (err) {
+        return reject(err);
+      }
+
+      initialized = true;
+
+      const end = hrtimeMs(process.hrtime());
+
+      resolve({
+        version: version,
+        timing: {
+          configure: configured - start,
+          queued: executeStart / 1e6 - configured,
+          initialize: (executeEnd - executeStart) / 1e6,
+          complete: end - executeEnd / 1e6,
+          total: end - start
+        }
+      });
+    });
+  });
+
+  initializing = promise;
+
+  return promise;
+};
+
+module.exports.terminate = () => {
+  pigpio.gpioTerminate();
+
+  initialized = false;
+  initializing = null;
+};
+
+module.exports.configureClock = (microseconds, peripheral) => {
+  pigpio.gpioCfgClock(+microseconds, +peripheral);
+};
+
+module.exports.configureSocketPort = (port) => {
+  pigpio.gpioCfgSocketPort(+port);
+};
+
+const DISPATCHER_POLICIES = ['other', 'fifo', 'rr'];
+
+module.exports.configureDispatcher = (options) => {
+  options = options || {};
+
+  const cpu = options.cpu === undefined ? -1 : +options.cpu;
+  const policy = DISPATCHER_POLICIES.indexOf(options.policy || 'other');
+  const priority = +(options.priority || 0);
+
+  if (policy === -1) {
+    throw new Error('Unknown dispatcher policy ' + options.policy);
+  }
+
+  const settings = pigpio.dispatcherConfigure(cpu, policy, priority);
+
+  return {
+    cpus: settings.slice(2),
+    policy: DISPATCHER_POLICIES[settings[0]],
+    priority: settings[1]
+  };
+};
+
+module.exports.dispatcherDropped = () => {
+  return pigpio.dispatcherDropped();
 };
 
 module.exports.CLOCK_PWM = 0; // PI_CLOCK_PWM;
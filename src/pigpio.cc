@@ -1,22 +1,452 @@
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <pigpio.h>
 #include <nan.h>
+#include <string>
+#include <vector>
 
 static void gpioISREventLoopHandler(uv_async_t* handle);
 static void gpioAlertEventLoopHandler(uv_async_t* handle);
+static void gpioCoalesceEventLoopHandler(uv_async_t* handle);
+static void gpioCoalesceTimerHandler(uv_timer_t* handle);
+static bool dispatcherEnqueue(int type, int gpio, int level, uint32_t tick);
+static void dispatcherPost(int type, int gpio, int level, uint32_t tick);
+
+#define DISPATCH_ISR 0
+#define DISPATCH_ALERT 1
 
 // TODO errors returned by uv calls are ignored
 
 
+/* ------------------------------------------------------------------------ */
+/* Ticks                                                                    */
+/* ------------------------------------------------------------------------ */
+
+
+// The 32 bit ticks returned by gpioTick and passed to callbacks wrap around
+// every 2^32 microseconds. They're extended to 64 bits centrally here. The
+// 64 bit tick is seeded from CLOCK_MONOTONIC so that it approximates the
+// number of microseconds since boot rather than since initialization.
+//
+// The offset between the tick and CLOCK_MONOTONIC, the clock used by
+// process.hrtime, is measured once a second. The drift rate between the two
+// clocks is tracked so that the offset can be extrapolated between
+// measurements.
+
+#define TICK_REFRESH_INTERVAL 1000
+#define TICK_OFFSET_SAMPLES 5
+#define TICK_OFFSET_MAX_BRACKET 20000
+
+static uv_mutex_t tickMutex_g;
+static uv_timer_t tickTimer_g;
+static uint64_t tick64_g;
+static bool tickOffsetValid_g;
+static uint64_t tickOffsetTick_g;
+static double tickOffset_g;
+static double tickDrift_g;
+
+
+static void tickReset(uint32_t tick) {
+  uint64_t now = uv_hrtime() / 1000;
+
+  uv_mutex_lock(&tickMutex_g);
+  tick64_g = now + (int32_t) (tick - (uint32_t) now);
+  tickOffsetValid_g = false;
+  tickDrift_g = 0;
+  uv_mutex_unlock(&tickMutex_g);
+}
+
+
+// Extends a 32 bit tick to 64 bits. The tick must be within 2^31
+// microseconds of the most recent tick seen which is ensured by the refresh
+// timer. extendTick can be called from any thread.
+static uint64_t extendTick(uint32_t tick) {
+  uv_mutex_lock(&tickMutex_g);
+
+  int32_t diff = (int32_t) (tick - (uint32_t) tick64_g);
+  uint64_t tick64 = tick64_g + diff;
+
+  if (diff > 0) {
+    tick64_g = tick64;
+  }
+
+  uv_mutex_unlock(&tickMutex_g);
+
+  return tick64;
+}
+
+
+// Returns CLOCK_MONOTONIC in nanoseconds minus the tick in microseconds
+// multiplied by 1000.
+static double tickOffset(uint64_t tick64) {
+  uv_mutex_lock(&tickMutex_g);
+  double offset = tickOffset_g +
+    tickDrift_g * ((double) tick64 - (double) tickOffsetTick_g);
+  uv_mutex_unlock(&tickMutex_g);
+
+  return offset;
+}
+
+
+static void refineTickOffset() {
+  uint64_t bestBracket = TICK_OFFSET_MAX_BRACKET;
+  uint64_t bestTick = 0;
+  double bestOffset = 0;
+
+  // Sample the tick bracketed by two CLOCK_MONOTONIC readings several times
+  // and use the sample with the narrowest bracket.
+  for (unsigned i = 0; i != TICK_OFFSET_SAMPLES; ++i) {
+    uint64_t before = uv_hrtime();
+    uint32_t tick = gpioTick();
+    uint64_t after = uv_hrtime();
+
+    if (after - before < bestBracket) {
+      bestBracket = after - before;
+      bestTick = extendTick(tick);
+      bestOffset = (double) (before + (after - before) / 2) -
+        (double) bestTick * 1000;
+    }
+  }
+
+  if (bestTick == 0) {
+    return;
+  }
+
+  uv_mutex_lock(&tickMutex_g);
+
+  if (tickOffsetValid_g && bestTick > tickOffsetTick_g) {
+    double drift = (bestOffset - tickOffset_g) /
+      ((double) bestTick - (double) tickOffsetTick_g);
+    tickDrift_g += (drift - tickDrift_g) / 8;
+  }
+
+  tickOffsetTick_g = bestTick;
+  tickOffset_g = bestOffset;
+  tickOffsetValid_g = true;
+
+  uv_mutex_unlock(&tickMutex_g);
+}
+
+
+static void tickTimerHandler(uv_timer_t* handle) {
+  refineTickOffset();
+}
+
+
+static void tickStart() {
+  tickReset(gpioTick());
+  refineTickOffset();
+  uv_timer_start(
+    &tickTimer_g, tickTimerHandler, TICK_REFRESH_INTERVAL, TICK_REFRESH_INTERVAL
+  );
+}
+
+
+static void tickStop() {
+  uv_timer_stop(&tickTimer_g);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Trace                                                                    */
+/* ------------------------------------------------------------------------ */
+
+
+// The tracer records timestamped spans for the stages that an interrupt or
+// alert passes through on its way to JavaScript, and for a few slow pigpio
+// calls. It's disabled by default and costs a single load per stage when
+// disabled.
+//
+// Each thread records into its own buffer so recording doesn't need locks.
+// A buffer has a single writer, the thread that owns it, and is only read
+// by the event loop thread. A buffer is reset by its owner the first time
+// the owner records after tracing was restarted, tracked with an epoch.
+// Buffers are never freed as the event loop may be reading them. When a
+// thread exits its buffer is marked free and handed to the next thread that
+// needs one, but only once tracing has been restarted so that the events of
+// the exited thread can still be collected. Events are dropped once a buffer
+// is full.
+
+#define TRACE_BUFFER_EVENTS 65536
+
+#define TRACE_ISR_HANDLER 0
+#define TRACE_ALERT_HANDLER 1
+#define TRACE_DISPATCHER_QUEUE 2
+#define TRACE_ALERT_LISTENERS 3
+#define TRACE_SEM_WAIT 4
+#define TRACE_ASYNC_SEND 5
+#define TRACE_EVENT_LOOP_WAKEUP 6
+#define TRACE_ISR_CALLBACK 7
+#define TRACE_ALERT_CALLBACK 8
+#define TRACE_WAVE_CREATE 9
+#define TRACE_WAVE_TX_SEND 10
+#define TRACE_WAVE_CHAIN 11
+#define TRACE_INITIALISE 12
+#define TRACE_CONTROL_STEP 13
+
+// The stages of an event are linked by flows identified by gpio and tick.
+#define TRACE_FLOW_IN 1
+#define TRACE_FLOW_OUT 2
+
+#define TRACE_NO_GPIO 0xff
+
+struct TraceEvent_t {
+  uint64_t start;
+  uint32_t duration;
+  uint16_t name;
+  uint8_t gpio;
+  uint8_t flags;
+  uint32_t arg0;
+  uint32_t arg1;
+};
+
+struct TraceBuffer_t {
+  pid_t tid;
+  const char *threadName;
+  uint32_t epoch;
+  uint32_t count;
+  uint32_t dropped;
+  bool free;
+  TraceEvent_t events[TRACE_BUFFER_EVENTS];
+};
+
+static bool traceEnabled_g;
+static uint32_t traceEpoch_g;
+static uv_mutex_t traceMutex_g;
+static std::vector<TraceBuffer_t *> traceBuffers_g;
+static pthread_key_t traceBufferKey_g;
+static __thread TraceBuffer_t *traceBuffer_t;
+static __thread const char *traceThreadName_t;
+
+
+// Returns the start time of a span or 0 if tracing is disabled.
+static inline uint64_t traceBegin() {
+  return __atomic_load_n(&traceEnabled_g, __ATOMIC_RELAXED) ? uv_hrtime() : 0;
+}
+
+
+// Called when a thread that recorded events exits.
+static void traceThreadExit(void *data) {
+  TraceBuffer_t *buffer = (TraceBuffer_t *) data;
+
+  uv_mutex_lock(&traceMutex_g);
+  buffer->free = true;
+  uv_mutex_unlock(&traceMutex_g);
+}
+
+
+// Returns a free buffer that holds no events of the current epoch or 0 if
+// there is none. Must be called with traceMutex_g locked.
+static TraceBuffer_t *traceReuseBuffer(uint32_t epoch) {
+  for (size_t i = 0; i != traceBuffers_g.size(); ++i) {
+    TraceBuffer_t *buffer = traceBuffers_g[i];
+
+    if (buffer->free &&
+        __atomic_load_n(&buffer->epoch, __ATOMIC_RELAXED) != epoch) {
+      buffer->free = false;
+      return buffer;
+    }
+  }
+
+  return 0;
+}
+
+
+static TraceBuffer_t *traceThreadBuffer(uint32_t epoch) {
+  TraceBuffer_t *buffer = traceBuffer_t;
+
+  if (buffer == 0) {
+    uv_mutex_lock(&traceMutex_g);
+    buffer = traceReuseBuffer(epoch);
+    uv_mutex_unlock(&traceMutex_g);
+
+    if (buffer == 0) {
+      buffer = (TraceBuffer_t *) calloc(1, sizeof(TraceBuffer_t));
+      if (buffer == 0) {
+        return 0;
+      }
+
+      buffer->epoch = epoch;
+
+      uv_mutex_lock(&traceMutex_g);
+      traceBuffers_g.push_back(buffer);
+      uv_mutex_unlock(&traceMutex_g);
+    } else {
+      // The event loop skips the buffer until its epoch is current, so reset
+      // the buffer before publishing the epoch.
+      __atomic_store_n(&buffer->count, 0, __ATOMIC_RELEASE);
+      buffer->dropped = 0;
+    }
+
+    buffer->tid = syscall(SYS_gettid);
+    buffer->threadName = traceThreadName_t ? traceThreadName_t : "pigpio";
+    __atomic_store_n(&buffer->epoch, epoch, __ATOMIC_RELEASE);
+
+    pthread_setspecific(traceBufferKey_g, buffer);
+    traceBuffer_t = buffer;
+  } else if (__atomic_load_n(&buffer->epoch, __ATOMIC_RELAXED) != epoch) {
+    __atomic_store_n(&buffer->count, 0, __ATOMIC_RELEASE);
+    buffer->dropped = 0;
+    __atomic_store_n(&buffer->epoch, epoch, __ATOMIC_RELEASE);
+  }
+
+  return buffer;
+}
+
+
+// Records a span from start to now. Does nothing if start is 0, that is, if
+// tracing was disabled when the span began.
+static void traceEnd(
+  unsigned name,
+  uint64_t start,
+  int gpio,
+  uint32_t arg0,
+  uint32_t arg1,
+  unsigned flags
+) {
+  if (start == 0) {
+    return;
+  }
+
+  uint64_t end = uv_hrtime();
+
+  TraceBuffer_t *buffer =
+    traceThreadBuffer(__atomic_load_n(&traceEpoch_g, __ATOMIC_ACQUIRE));
+  if (buffer == 0) {
+    return;
+  }
+
+  uint32_t count = buffer->count;
+  if (count == TRACE_BUFFER_EVENTS) {
+    buffer->dropped += 1;
+    return;
+  }
+
+  TraceEvent_t &event = buffer->events[count];
+  event.start = start;
+  event.duration = end - start > UINT32_MAX ? UINT32_MAX : end - start;
+  event.name = name;
+  event.gpio = gpio < 0 ? TRACE_NO_GPIO : gpio;
+  event.flags = flags;
+  event.arg0 = arg0;
+  event.arg1 = arg1;
+
+  __atomic_store_n(&buffer->count, count + 1, __ATOMIC_RELEASE);
+}
+
+
+// Starts tracing. Events recorded since the previous start are discarded.
+NAN_METHOD(traceEnable) {
+  __atomic_add_fetch(&traceEpoch_g, 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&traceEnabled_g, true, __ATOMIC_RELEASE);
+}
+
+
+NAN_METHOD(traceDisable) {
+  __atomic_store_n(&traceEnabled_g, false, __ATOMIC_RELEASE);
+}
+
+
+// Returns the events recorded since tracing was started as an array with
+// an entry [tid, threadName, dropped, events] per thread. events is a
+// Buffer of TraceEvent_t.
+NAN_METHOD(traceCollect) {
+  uint32_t epoch = __atomic_load_n(&traceEpoch_g, __ATOMIC_ACQUIRE);
+
+  uv_mutex_lock(&traceMutex_g);
+  std::vector<TraceBuffer_t *> buffers = traceBuffers_g;
+  uv_mutex_unlock(&traceMutex_g);
+
+  v8::Local<v8::Array> threads = Nan::New<v8::Array>();
+  uint32_t index = 0;
+
+  for (size_t i = 0; i != buffers.size(); ++i) {
+    TraceBuffer_t *buffer = buffers[i];
+
+    if (__atomic_load_n(&buffer->epoch, __ATOMIC_ACQUIRE) != epoch) {
+      continue;
+    }
+
+    uint32_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+    if (count == 0) {
+      continue;
+    }
+
+    v8::Local<v8::Object> events =
+      Nan::CopyBuffer((const char *) buffer->events, count * sizeof(TraceEvent_t)).
+      ToLocalChecked();
+
+    v8::Local<v8::Array> thread = Nan::New<v8::Array>(4);
+    Nan::Set(thread, 0, Nan::New<v8::Integer>(buffer->tid));
+    Nan::Set(thread, 1, Nan::New<v8::String>(buffer->threadName).ToLocalChecked());
+    Nan::Set(thread, 2, Nan::New<v8::Uint32>(buffer->dropped));
+    Nan::Set(thread, 3, events);
+
+    Nan::Set(threads, index++, thread);
+  }
+
+  info.GetReturnValue().Set(threads);
+}
+
+
 /* ------------------------------------------------------------------------ */
 /* Gpio                                                                     */
 /* ------------------------------------------------------------------------ */
 
 
+// Events for a GPIO can optionally be coalesced. While coalescing, at most
+// one event per window is passed to JavaScript. The event contains the latest
+// level, the first and last tick, and the number of edges collapsed into it.
+// Edges that are collapsed don't wake the event loop.
+//
+// Most processes never coalesce so the state needed for coalescing is only
+// created the first time coalescing is enabled for a GPIO. The handles of a
+// GpioCoalesce_t refer to the GpioCallback_t that owns it until it's closed.
+struct GpioCoalesce_t {
+  uv_mutex_t mutex;
+  uv_async_t async;
+  uv_timer_t timer;
+  unsigned openHandles;
+
+  // Protected by mutex
+  unsigned gpio;
+  uint32_t window;
+  bool holdoff;
+  uint32_t edges;
+  int level;
+  uint32_t firstTick;
+  uint32_t lastTick;
+};
+
+
+static void gpioCoalesceCloseHandler(uv_handle_t* handle) {
+  GpioCoalesce_t *coalesce = (GpioCoalesce_t *) handle->data;
+
+  if (--coalesce->openHandles == 0) {
+    uv_mutex_destroy(&coalesce->mutex);
+    delete coalesce;
+  }
+}
+
+
 class GpioCallback_t {
 public:
-  GpioCallback_t() : callback_(0), async_resource_(0) {
-    Nan::HandleScope scope;
+  GpioCallback_t()
+    : callback_(0),
+      async_resource_(0),
+      coalesce_(0) {
   }
 
   virtual ~GpioCallback_t() {
@@ -33,8 +463,16 @@ public:
 
     uv_close((uv_handle_t *) &async_, 0);
 
+    if (coalesce_) {
+      coalesce_->async.data = coalesce_;
+      coalesce_->timer.data = coalesce_;
+      uv_close((uv_handle_t *) &coalesce_->async, gpioCoalesceCloseHandler);
+      uv_close((uv_handle_t *) &coalesce_->timer, gpioCoalesceCloseHandler);
+    }
+
     callback_ = 0;
     async_resource_ = 0;
+    coalesce_ = 0;
   }
 
   void AsyncSend() {
@@ -68,15 +506,152 @@ public:
     return async_resource_;
   }
 
+  // A window of 0 microseconds disables coalescing. SetCoalesce is executed
+  // in the event loop thread.
+  void SetCoalesce(unsigned gpio, uint32_t window) {
+    GpioCoalesce_t *coalesce = coalesce_;
+
+    if (coalesce == 0) {
+      if (window == 0) {
+        return;
+      }
+
+      coalesce = new GpioCoalesce_t();
+
+      uv_mutex_init(&coalesce->mutex);
+
+      uv_async_init(
+        uv_default_loop(), &coalesce->async, gpioCoalesceEventLoopHandler
+      );
+      coalesce->async.data = this;
+      uv_unref((uv_handle_t *) &coalesce->async);
+
+      uv_timer_init(uv_default_loop(), &coalesce->timer);
+      coalesce->timer.data = this;
+      uv_unref((uv_handle_t *) &coalesce->timer);
+
+      coalesce->openHandles = 2;
+
+      // Coalesce reads coalesce_ on the thread that calls the handlers.
+      __atomic_store_n(&coalesce_, coalesce, __ATOMIC_RELEASE);
+    }
+
+    uv_timer_stop(&coalesce->timer);
+
+    uv_mutex_lock(&coalesce->mutex);
+    coalesce->gpio = gpio;
+    coalesce->window = window;
+    coalesce->holdoff = false;
+    coalesce->edges = 0;
+    uv_mutex_unlock(&coalesce->mutex);
+  }
+
+  // Coalesce is not executed in the event loop thread. Returns false if
+  // coalescing is disabled and the event needs to be passed to JavaScript.
+  bool Coalesce(int level, uint32_t tick) {
+    GpioCoalesce_t *coalesce = __atomic_load_n(&coalesce_, __ATOMIC_ACQUIRE);
+
+    if (coalesce == 0) {
+      return false;
+    }
+
+    uv_mutex_lock(&coalesce->mutex);
+
+    if (coalesce->window == 0) {
+      uv_mutex_unlock(&coalesce->mutex);
+      return false;
+    }
+
+    if (coalesce->edges == 0) {
+      coalesce->firstTick = tick;
+    }
+
+    coalesce->edges += 1;
+    coalesce->level = level;
+    coalesce->lastTick = tick;
+
+    bool wakeup = !coalesce->holdoff;
+    coalesce->holdoff = true;
+
+    uv_mutex_unlock(&coalesce->mutex);
+
+    if (wakeup) {
+      uv_async_send(&coalesce->async);
+    }
+
+    return true;
+  }
+
+  // DeliverCoalesced is executed in the event loop thread. Once an event has
+  // been delivered, the timer holds off further deliveries until the window
+  // has elapsed.
+  void DeliverCoalesced(bool timer) {
+    Nan::HandleScope scope;
+
+    GpioCoalesce_t *coalesce = coalesce_;
+
+    uv_mutex_lock(&coalesce->mutex);
+
+    uint32_t edges = coalesce->edges;
+    unsigned gpio = coalesce->gpio;
+    uint32_t window = coalesce->window;
+    int level = coalesce->level;
+    uint32_t firstTick = coalesce->firstTick;
+    uint32_t lastTick = coalesce->lastTick;
+
+    coalesce->edges = 0;
+
+    if (edges == 0 && timer) {
+      coalesce->holdoff = false;
+    }
+
+    uv_mutex_unlock(&coalesce->mutex);
+
+    if (edges == 0 || window == 0) {
+      return;
+    }
+
+    uv_timer_start(
+      &coalesce->timer, gpioCoalesceTimerHandler, (window + 999) / 1000, 0
+    );
+
+    if (callback_) {
+      v8::Local<v8::Value> args[7] = {
+        Nan::New<v8::Integer>(gpio),
+        Nan::New<v8::Integer>(level),
+        Nan::New<v8::Uint32>(lastTick),
+        Nan::New<v8::Uint32>((uint32_t) (extendTick(lastTick) >> 32)),
+        Nan::New<v8::Uint32>(edges),
+        Nan::New<v8::Uint32>(firstTick),
+        Nan::New<v8::Uint32>((uint32_t) (extendTick(firstTick) >> 32))
+      };
+
+      callback_->Call(7, args, async_resource_);
+    }
+  }
+
 protected:
   uv_async_t async_;
 
 private:
   Nan::Callback *callback_;
   Nan::AsyncResource *async_resource_;
+  GpioCoalesce_t *coalesce_;
 };
 
 
+// gpioCoalesceEventLoopHandler is executed in the event loop thread.
+static void gpioCoalesceEventLoopHandler(uv_async_t* handle) {
+  ((GpioCallback_t *) handle->data)->DeliverCoalesced(false);
+}
+
+
+// gpioCoalesceTimerHandler is executed in the event loop thread.
+static void gpioCoalesceTimerHandler(uv_timer_t* handle) {
+  ((GpioCallback_t *) handle->data)->DeliverCoalesced(true);
+}
+
+
 class GpioISR_t : public GpioCallback_t {
 public:
   GpioISR_t() : GpioCallback_t() {
@@ -104,8 +679,22 @@ static GpioAlert_t *gpioAlert_g;
 static int gpio_g;
 static int level_g;
 static uint32_t tick_g;
+static uint32_t tickHi_g;
+static uint64_t traceSend_g;
 static uv_sem_t sem_g;
 
+// pigpio can't read back pull-up/down settings and logs an error when the
+// PWM duty cycle or servo pulse width of a GPIO not generating them is
+// requested. The settings made through this module are therefore tracked
+// here so that snapshots can avoid such requests.
+#define GPIO_USE_NONE 0
+#define GPIO_USE_PWM 1
+#define GPIO_USE_HARDWARE_PWM 2
+#define GPIO_USE_SERVO 3
+
+static uint8_t gpioUse_g[PI_MAX_GPIO + 1];
+static int8_t gpioPullUpDown_g[PI_MAX_GPIO + 1];
+
 
 void ThrowPigpioError(int err, const char *pigpiocall) {
   char buf[128];
@@ -121,6 +710,11 @@ NAN_METHOD(gpioHardwareRevision) {
 }
 
 
+NAN_METHOD(gpioVersion) {
+  info.GetReturnValue().Set(gpioVersion());
+}
+
+
 NAN_METHOD(gpioCfgInterfaces) {
   if (info.Length() < 1 || !info[0]->IsUint32()) {
     return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioCfgInterfaces", ""));
@@ -137,17 +731,175 @@ NAN_METHOD(gpioCfgInterfaces) {
 }
 
 
+// gpioInitialise can take a noticeable amount of time so it can optionally
+// be executed on a thread of the libuv thread pool. Functions that need the
+// library while asynchronous initialization is pending wait for it with
+// waitForInitialise rather than initializing again.
+static uv_mutex_t initMutex_g;
+static uv_cond_t initCond_g;
+static bool initPending_g;
+static int initRc_g;
+static bool initCompleted_g;
+static unsigned initGeneration_g;
+
+
+// Waits for a pending asynchronous initialization and returns its result.
+static int waitForInitialise() {
+  uv_mutex_lock(&initMutex_g);
+
+  while (initPending_g) {
+    uv_cond_wait(&initCond_g, &initMutex_g);
+  }
+
+  int rc = initRc_g;
+
+  uv_mutex_unlock(&initMutex_g);
+
+  return rc;
+}
+
+
+// Completes initialization in the event loop thread.
+static void completeInitialise() {
+  if (!initCompleted_g) {
+    tickStart();
+    initCompleted_g = true;
+  }
+}
+
+
+class InitialiseWorker_t : public Nan::AsyncWorker {
+public:
+  InitialiseWorker_t(Nan::Callback *callback)
+    : Nan::AsyncWorker(callback, "pigpio:initialise"),
+      generation_(initGeneration_g),
+      rc_(0),
+      start_(0),
+      end_(0) {
+  }
+
+  // Execute is not executed in the event loop thread.
+  void Execute() {
+    traceThreadName_t = "worker";
+
+    start_ = uv_hrtime();
+    rc_ = gpioInitialise();
+    end_ = uv_hrtime();
+
+    if (__atomic_load_n(&traceEnabled_g, __ATOMIC_RELAXED)) {
+      traceEnd(TRACE_INITIALISE, start_, -1, rc_, 0, 0);
+    }
+
+    uv_mutex_lock(&initMutex_g);
+    initRc_g = rc_;
+    initPending_g = false;
+    uv_cond_broadcast(&initCond_g);
+    uv_mutex_unlock(&initMutex_g);
+
+    if (rc_ < 0) {
+      char buf[128];
+      snprintf(buf, sizeof(buf), "pigpio error %d in gpioInitialise", rc_);
+      SetErrorMessage(buf);
+    }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    if (generation_ != initGeneration_g) {
+      v8::Local<v8::Value> args[1] = {
+        Nan::Error("pigpio terminated before initialization completed")
+      };
+
+      callback->Call(1, args, async_resource);
+      return;
+    }
+
+    completeInitialise();
+
+    v8::Local<v8::Value> args[4] = {
+      Nan::Null(),
+      Nan::New<v8::Integer>(rc_),
+      Nan::New<v8::Number>((double) start_),
+      Nan::New<v8::Number>((double) end_)
+    };
+
+    callback->Call(4, args, async_resource);
+  }
+
+private:
+  unsigned generation_;
+  int rc_;
+  uint64_t start_;
+  uint64_t end_;
+};
+
+
 NAN_METHOD(gpioInitialise) {
+  uint64_t traceStart = traceBegin();
+
   int rc = gpioInitialise();
+
+  traceEnd(TRACE_INITIALISE, traceStart, -1, rc, 0, 0);
+
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioInitialise");
+  }
+
+  initCompleted_g = false;
+  completeInitialise();
+
+  info.GetReturnValue().Set(rc);
+}
+
+
+// Starts gpioInitialise on a thread of the thread pool. The callback is
+// passed an error or null, the pigpio version, and the times in nanoseconds
+// at which gpioInitialise was started and completed.
+NAN_METHOD(gpioInitialiseAsync) {
+  if (info.Length() < 1 || !info[0]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioInitialiseAsync", ""));
+  }
+
+  uv_mutex_lock(&initMutex_g);
+  bool pending = initPending_g;
+  initPending_g = true;
+  uv_mutex_unlock(&initMutex_g);
+
+  if (pending) {
+    return Nan::ThrowError(Nan::ErrnoException(EBUSY, "gpioInitialiseAsync", ""));
+  }
+
+  initCompleted_g = false;
+
+  Nan::Callback *callback = new Nan::Callback(info[0].As<v8::Function>());
+  Nan::AsyncQueueWorker(new InitialiseWorker_t(callback));
+}
+
+
+// Waits for a pending asynchronous initialization and completes it without
+// returning to the event loop.
+NAN_METHOD(gpioInitialiseWait) {
+  int rc = waitForInitialise();
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioInitialise");
   }
 
+  completeInitialise();
+
   info.GetReturnValue().Set(rc);
 }
 
 
 NAN_METHOD(gpioTerminate) {
+  // Terminating while initialization is in progress on another thread
+  // would leave the library initialized.
+  waitForInitialise();
+
+  initGeneration_g += 1;
+  initCompleted_g = false;
+
+  tickStop();
   gpioTerminate();
 }
 
@@ -164,6 +916,10 @@ NAN_METHOD(gpioSetMode) {
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioSetMode");
   }
+
+  if (mode != PI_OUTPUT) {
+    gpioUse_g[gpio] = GPIO_USE_NONE;
+  }
 }
 
 
@@ -195,6 +951,8 @@ NAN_METHOD(gpioSetPullUpDown) {
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioSetPullUpDown");
   }
+
+  gpioPullUpDown_g[gpio] = pud;
 }
 
 
@@ -226,6 +984,8 @@ NAN_METHOD(gpioWrite) {
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioWrite");
   }
+
+  gpioUse_g[gpio] = GPIO_USE_NONE;
 }
 
 
@@ -251,18 +1011,49 @@ NAN_METHOD(gpioTick) {
 }
 
 
-NAN_METHOD(gpioPWM) {
-  if (info.Length() < 2 || !info[0]->IsUint32() || !info[1]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioPWM", ""));
-  }
+// 64 bit ticks are passed to JavaScript as doubles which represent them
+// exactly for the next few hundred years.
+NAN_METHOD(gpioTick64) {
+  info.GetReturnValue().Set((double) extendTick(gpioTick()));
+}
 
-  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
-  unsigned dutycycle = Nan::To<uint32_t>(info[1]).FromJust();
 
-  int rc = gpioPWM(user_gpio, dutycycle);
+NAN_METHOD(gpioTickExtend) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioTickExtend", ""));
+  }
+
+  uint32_t tick = Nan::To<uint32_t>(info[0]).FromJust();
+
+  info.GetReturnValue().Set((double) extendTick(tick));
+}
+
+
+NAN_METHOD(gpioTickOffset) {
+  if (info.Length() < 1 || !info[0]->IsNumber()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioTickOffset", ""));
+  }
+
+  uint64_t tick64 = (uint64_t) Nan::To<double>(info[0]).FromJust();
+
+  info.GetReturnValue().Set(tickOffset(tick64));
+}
+
+
+NAN_METHOD(gpioPWM) {
+  if (info.Length() < 2 || !info[0]->IsUint32() || !info[1]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioPWM", ""));
+  }
+
+  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
+  unsigned dutycycle = Nan::To<uint32_t>(info[1]).FromJust();
+
+  int rc = gpioPWM(user_gpio, dutycycle);
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioPWM");
   }
+
+  gpioUse_g[user_gpio] = GPIO_USE_PWM;
 }
 
 
@@ -282,6 +1073,8 @@ NAN_METHOD(gpioHardwarePWM) {
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioHardwarePWM");
   }
+
+  gpioUse_g[gpio] = frequency == 0 ? GPIO_USE_NONE : GPIO_USE_HARDWARE_PWM;
 }
 
 
@@ -391,6 +1184,8 @@ NAN_METHOD(gpioServo) {
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioServo");
   }
+
+  gpioUse_g[user_gpio] = pulsewidth == 0 ? GPIO_USE_NONE : GPIO_USE_SERVO;
 }
 
 
@@ -410,15 +1205,49 @@ NAN_METHOD(gpioGetServoPulsewidth) {
 }
 
 
-// gpioISRHandler is not executed in the event loop thread
-static void gpioISRHandler(int gpio, int level, uint32_t tick) {
+// dispatchISR is not executed in the event loop thread. It's executed in
+// the pigpio thread or, if it's running, in the dispatcher thread.
+static void dispatchISR(int gpio, int level, uint32_t tick, bool dispatcher) {
+  if (level != PI_TIMEOUT && gpioISR_g[gpio].Coalesce(level, tick)) {
+    return;
+  }
+
+  if (dispatcher) {
+    dispatcherPost(DISPATCH_ISR, gpio, level, tick);
+    return;
+  }
+
+  uint64_t traceStart = traceBegin();
+
   uv_sem_wait(&sem_g);
 
+  traceEnd(TRACE_SEM_WAIT, traceStart, gpio, tick, level,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+
   gpio_g = gpio;
   level_g = level;
   tick_g = tick;
+  tickHi_g = extendTick(tick) >> 32;
+
+  uint64_t traceSend = traceBegin();
+  traceSend_g = traceSend;
 
   gpioISR_g[gpio].AsyncSend();
+
+  traceEnd(TRACE_ASYNC_SEND, traceSend, gpio, tick, level,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+}
+
+
+// gpioISRHandler is not executed in the event loop thread
+static void gpioISRHandler(int gpio, int level, uint32_t tick) {
+  uint64_t traceStart = traceBegin();
+
+  if (!dispatcherEnqueue(DISPATCH_ISR, gpio, level, tick)) {
+    dispatchISR(gpio, level, tick, false);
+  }
+
+  traceEnd(TRACE_ISR_HANDLER, traceStart, gpio, tick, level, TRACE_FLOW_OUT);
 }
 
 
@@ -426,20 +1255,28 @@ static void gpioISRHandler(int gpio, int level, uint32_t tick) {
 static void gpioISREventLoopHandler(uv_async_t* handle) {
   Nan::HandleScope scope;
 
+  traceEnd(TRACE_EVENT_LOOP_WAKEUP, traceSend_g, gpio_g, tick_g, level_g,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+
+  uint64_t traceStart = traceBegin();
+
   if (gpioISR_g[gpio_g].Callback()) {
-    v8::Local<v8::Value> args[3] = {
+    v8::Local<v8::Value> args[4] = {
       Nan::New<v8::Integer>(gpio_g),
       Nan::New<v8::Integer>(level_g),
-      Nan::New<v8::Integer>(tick_g)
+      Nan::New<v8::Integer>(tick_g),
+      Nan::New<v8::Integer>(tickHi_g)
     };
 
     gpioISR_g[gpio_g].Callback()->Call(
-      3,
+      4,
       args,
       gpioISR_g[gpio_g].Resource()
     );
   }
 
+  traceEnd(TRACE_ISR_CALLBACK, traceStart, gpio_g, tick_g, level_g, TRACE_FLOW_IN);
+
   uv_sem_post(&sem_g);
 }
 
@@ -459,256 +1296,4879 @@ static NAN_METHOD(gpioSetISRFunc) {
     return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSetISRFunc", ""));
   }
 
-  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
-  unsigned edge = Nan::To<uint32_t>(info[1]).FromJust();
-  int timeout = Nan::To<int32_t>(info[2]).FromJust();
-  Nan::Callback *callback = 0;
-  gpioISRFunc_t isrFunc = 0;
+  if (info.Length() >= 5 && !info[4]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSetISRFunc", ""));
+  }
+
+  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
+  unsigned edge = Nan::To<uint32_t>(info[1]).FromJust();
+  int timeout = Nan::To<int32_t>(info[2]).FromJust();
+  uint32_t coalesce = 0;
+  Nan::Callback *callback = 0;
+  gpioISRFunc_t isrFunc = 0;
+
+  if (user_gpio > PI_MAX_USER_GPIO) {
+    return ThrowPigpioError(PI_BAD_USER_GPIO, "gpioSetISRFunc");
+  }
+
+  if (info.Length() >= 4 && info[3]->IsFunction()) {
+    callback = new Nan::Callback(info[3].As<v8::Function>());
+    isrFunc = gpioISRHandler;
+
+    if (info.Length() >= 5) {
+      coalesce = Nan::To<uint32_t>(info[4]).FromJust();
+    }
+  }
+
+  gpioISR_g[user_gpio].SetCoalesce(user_gpio, coalesce);
+  gpioISR_g[user_gpio].SetCallback(callback);
+
+  int rc = gpioSetISRFunc(user_gpio, edge, timeout, isrFunc);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioSetISRFunc");
+  }
+}
+
+
+// Native alert listeners are informed about state changes on the pigpio
+// thread before the state change is passed on to JavaScript. They allow
+// high frequency input signals to be processed without waking the event
+// loop for every edge. Alert is called with alertListenersMutex_g locked
+// so it must not block or register/unregister listeners.
+class AlertListener_t {
+public:
+  virtual ~AlertListener_t() {}
+  virtual void Alert(int gpio, int level, uint32_t tick) = 0;
+};
+
+
+static std::vector<AlertListener_t *> alertListeners_g[PI_MAX_USER_GPIO + 1];
+static bool alertToJs_g[PI_MAX_USER_GPIO + 1];
+static uv_mutex_t alertListenersMutex_g;
+
+
+// dispatchAlert is not executed in the event loop thread. It's executed in
+// the pigpio thread or, if it's running, in the dispatcher thread.
+static void dispatchAlert(int gpio, int level, uint32_t tick, bool dispatcher) {
+  uint64_t traceStart = traceBegin();
+
+  uv_mutex_lock(&alertListenersMutex_g);
+
+  std::vector<AlertListener_t *> &listeners = alertListeners_g[gpio];
+  for (size_t i = 0; i != listeners.size(); ++i) {
+    listeners[i]->Alert(gpio, level, tick);
+  }
+
+  bool toJs = alertToJs_g[gpio];
+
+  uv_mutex_unlock(&alertListenersMutex_g);
+
+  traceEnd(TRACE_ALERT_LISTENERS, traceStart, gpio, tick, level,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+
+  if (!toJs) {
+    return;
+  }
+
+  if (level != PI_TIMEOUT && gpioAlert_g[gpio].Coalesce(level, tick)) {
+    return;
+  }
+
+  if (dispatcher) {
+    dispatcherPost(DISPATCH_ALERT, gpio, level, tick);
+    return;
+  }
+
+  traceStart = traceBegin();
+
+  uv_sem_wait(&sem_g);
+
+  traceEnd(TRACE_SEM_WAIT, traceStart, gpio, tick, level,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+
+  gpio_g = gpio;
+  level_g = level;
+  tick_g = tick;
+  tickHi_g = extendTick(tick) >> 32;
+
+  uint64_t traceSend = traceBegin();
+  traceSend_g = traceSend;
+
+  gpioAlert_g[gpio].AsyncSend();
+
+  traceEnd(TRACE_ASYNC_SEND, traceSend, gpio, tick, level,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+}
+
+
+// gpioAlertHandler is not executed in the event loop thread
+static void gpioAlertHandler(int gpio, int level, uint32_t tick) {
+  uint64_t traceStart = traceBegin();
+
+  if (!dispatcherEnqueue(DISPATCH_ALERT, gpio, level, tick)) {
+    dispatchAlert(gpio, level, tick, false);
+  }
+
+  traceEnd(TRACE_ALERT_HANDLER, traceStart, gpio, tick, level, TRACE_FLOW_OUT);
+}
+
+
+// pigpio supports one alert function per GPIO. The alert function is
+// installed as long as JavaScript or at least one native listener is
+// interested in alerts for the GPIO.
+static int updateAlertFunc(unsigned user_gpio) {
+  uv_mutex_lock(&alertListenersMutex_g);
+  bool active = alertToJs_g[user_gpio] || !alertListeners_g[user_gpio].empty();
+  uv_mutex_unlock(&alertListenersMutex_g);
+
+  return gpioSetAlertFunc(user_gpio, active ? gpioAlertHandler : 0);
+}
+
+
+static int addAlertListener(unsigned user_gpio, AlertListener_t *listener) {
+  uv_mutex_lock(&alertListenersMutex_g);
+  alertListeners_g[user_gpio].push_back(listener);
+  uv_mutex_unlock(&alertListenersMutex_g);
+
+  return updateAlertFunc(user_gpio);
+}
+
+
+// When removeAlertListener returns the listener is no longer being called
+// and can be deleted.
+static int removeAlertListener(unsigned user_gpio, AlertListener_t *listener) {
+  uv_mutex_lock(&alertListenersMutex_g);
+
+  std::vector<AlertListener_t *> &listeners = alertListeners_g[user_gpio];
+  for (size_t i = 0; i != listeners.size(); ++i) {
+    if (listeners[i] == listener) {
+      listeners.erase(listeners.begin() + i);
+      break;
+    }
+  }
+
+  uv_mutex_unlock(&alertListenersMutex_g);
+
+  return updateAlertFunc(user_gpio);
+}
+
+
+// gpioAlertEventLoopHandler is executed in the event loop thread.
+static void gpioAlertEventLoopHandler(uv_async_t* handle) {
+  Nan::HandleScope scope;
+
+  traceEnd(TRACE_EVENT_LOOP_WAKEUP, traceSend_g, gpio_g, tick_g, level_g,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+
+  uint64_t traceStart = traceBegin();
+
+  if (gpioAlert_g[gpio_g].Callback()) {
+    v8::Local<v8::Value> args[4] = {
+      Nan::New<v8::Integer>(gpio_g),
+      Nan::New<v8::Integer>(level_g),
+      Nan::New<v8::Integer>(tick_g),
+      Nan::New<v8::Integer>(tickHi_g)
+    };
+
+    gpioAlert_g[gpio_g].Callback()->Call(
+      4,
+      args,
+      gpioAlert_g[gpio_g].Resource()
+    );
+  }
+
+  traceEnd(TRACE_ALERT_CALLBACK, traceStart, gpio_g, tick_g, level_g, TRACE_FLOW_IN);
+
+  uv_sem_post(&sem_g);
+}
+
+
+static NAN_METHOD(gpioSetAlertFunc) {
+  if (info.Length() < 1 ||
+      !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSetAlertFunc"));
+  }
+
+  if (info.Length() >= 2 &&
+      !info[1]->IsFunction() &&
+      !info[1]->IsNull() &&
+      !info[1]->IsUndefined()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSetAlertFunc"));
+  }
+
+  if (info.Length() >= 3 && !info[2]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSetAlertFunc"));
+  }
+
+  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
+  uint32_t coalesce = 0;
+  Nan::Callback *callback = 0;
+
+  if (user_gpio > PI_MAX_USER_GPIO) {
+    return ThrowPigpioError(PI_BAD_USER_GPIO, "gpioSetAlertFunc");
+  }
+
+  if (info.Length() >= 2 && info[1]->IsFunction()) {
+    callback = new Nan::Callback(info[1].As<v8::Function>());
+
+    if (info.Length() >= 3) {
+      coalesce = Nan::To<uint32_t>(info[2]).FromJust();
+    }
+  }
+
+  uv_mutex_lock(&alertListenersMutex_g);
+  alertToJs_g[user_gpio] = callback != 0;
+  uv_mutex_unlock(&alertListenersMutex_g);
+
+  gpioAlert_g[user_gpio].SetCoalesce(user_gpio, coalesce);
+  gpioAlert_g[user_gpio].SetCallback(callback);
+
+  int rc = updateAlertFunc(user_gpio);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioSetAlertFunc");
+  }
+}
+
+
+NAN_METHOD(gpioGlitchFilter) {
+  if (info.Length() < 2 || !info[0]->IsUint32() || !info[1]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioGlitchFilter", ""));
+  }
+
+  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
+  unsigned steady = Nan::To<uint32_t>(info[1]).FromJust();
+
+  int rc = gpioGlitchFilter(user_gpio, steady);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioGlitchFilter");
+  }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Dispatcher                                                               */
+/* ------------------------------------------------------------------------ */
+
+
+// By default events are dispatched in the pigpio thread. This includes
+// running native alert listeners and waiting for JavaScript to accept the
+// event. Once the dispatcher is started, the pigpio thread only queues raw
+// events and the dispatcher thread does the rest. Unlike the pigpio thread,
+// the dispatcher thread can be given a real-time scheduling policy and
+// pinned to a CPU. The dispatcher runs until the process exits.
+//
+// If the queue is full the pigpio thread waits for the dispatcher. This is
+// the same back pressure that the pigpio thread experiences without the
+// dispatcher when JavaScript can't keep up.
+//
+// The dispatcher thread never waits for JavaScript. Rather than handing
+// events to the event loop one at a time through sem_g, it appends them to
+// a second queue that the event loop drains, so native listeners aren't
+// delayed by garbage collection or I/O in the event loop. If JavaScript
+// falls DISPATCHER_JS_QUEUE_SIZE events behind further events for
+// JavaScript are dropped and counted.
+
+#define DISPATCHER_QUEUE_SIZE 4096 // must be a power of two
+#define DISPATCHER_JS_QUEUE_SIZE 65536 // must be a power of two
+
+#define DISPATCHER_POLICY_OTHER 0
+#define DISPATCHER_POLICY_FIFO 1
+#define DISPATCHER_POLICY_RR 2
+
+struct DispatcherEvent_t {
+  int type;
+  int gpio;
+  int level;
+  uint32_t tick;
+  uint64_t traceQueued;
+};
+
+static DispatcherEvent_t dispatcherQueue_g[DISPATCHER_QUEUE_SIZE];
+static uint32_t dispatcherHead_g;
+static uint32_t dispatcherTail_g;
+static uv_mutex_t dispatcherMutex_g;
+static uv_cond_t dispatcherNotEmpty_g;
+static uv_cond_t dispatcherNotFull_g;
+static uv_thread_t dispatcherThread_g;
+static bool dispatcherStarted_g;
+
+struct DispatcherJsEvent_t {
+  int type;
+  int gpio;
+  int level;
+  uint32_t tick;
+  uint32_t tickHi;
+  uint64_t traceSend;
+};
+
+static DispatcherJsEvent_t dispatcherJsQueue_g[DISPATCHER_JS_QUEUE_SIZE];
+static uint32_t dispatcherJsHead_g;
+static uint32_t dispatcherJsTail_g;
+static uint32_t dispatcherJsDropped_g;
+static uv_mutex_t dispatcherJsMutex_g;
+static uv_async_t dispatcherJsAsync_g;
+
+
+// dispatcherEnqueue is not executed in the event loop thread. Returns false
+// if the dispatcher isn't running and the event needs to be dispatched by the
+// caller.
+static bool dispatcherEnqueue(int type, int gpio, int level, uint32_t tick) {
+  if (!__atomic_load_n(&dispatcherStarted_g, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  uv_mutex_lock(&dispatcherMutex_g);
+
+  while (dispatcherTail_g - dispatcherHead_g == DISPATCHER_QUEUE_SIZE) {
+    uv_cond_wait(&dispatcherNotFull_g, &dispatcherMutex_g);
+  }
+
+  DispatcherEvent_t &event =
+    dispatcherQueue_g[dispatcherTail_g & (DISPATCHER_QUEUE_SIZE - 1)];
+  event.type = type;
+  event.gpio = gpio;
+  event.level = level;
+  event.tick = tick;
+  event.traceQueued = traceBegin();
+  dispatcherTail_g += 1;
+
+  uv_cond_signal(&dispatcherNotEmpty_g);
+  uv_mutex_unlock(&dispatcherMutex_g);
+
+  return true;
+}
+
+
+// dispatcherPost is executed in the dispatcher thread. It passes an event
+// to JavaScript without waiting for JavaScript.
+static void dispatcherPost(int type, int gpio, int level, uint32_t tick) {
+  uint64_t traceSend = traceBegin();
+  uint32_t tickHi = extendTick(tick) >> 32;
+
+  uv_mutex_lock(&dispatcherJsMutex_g);
+
+  if (dispatcherJsTail_g - dispatcherJsHead_g == DISPATCHER_JS_QUEUE_SIZE) {
+    dispatcherJsDropped_g += 1;
+    uv_mutex_unlock(&dispatcherJsMutex_g);
+    return;
+  }
+
+  DispatcherJsEvent_t &event =
+    dispatcherJsQueue_g[dispatcherJsTail_g & (DISPATCHER_JS_QUEUE_SIZE - 1)];
+  event.type = type;
+  event.gpio = gpio;
+  event.level = level;
+  event.tick = tick;
+  event.tickHi = tickHi;
+  event.traceSend = traceSend;
+
+  bool wakeup = dispatcherJsTail_g == dispatcherJsHead_g;
+  dispatcherJsTail_g += 1;
+
+  uv_mutex_unlock(&dispatcherJsMutex_g);
+
+  if (wakeup) {
+    uv_async_send(&dispatcherJsAsync_g);
+  }
+
+  traceEnd(TRACE_ASYNC_SEND, traceSend, gpio, tick, level,
+    TRACE_FLOW_IN | TRACE_FLOW_OUT);
+}
+
+
+// dispatcherJsEventLoopHandler is executed in the event loop thread. It
+// delivers the events queued by the dispatcher thread in order.
+static void dispatcherJsEventLoopHandler(uv_async_t* handle) {
+  Nan::HandleScope scope;
+
+  while (true) {
+    uv_mutex_lock(&dispatcherJsMutex_g);
+
+    if (dispatcherJsHead_g == dispatcherJsTail_g) {
+      uv_mutex_unlock(&dispatcherJsMutex_g);
+      break;
+    }
+
+    DispatcherJsEvent_t event =
+      dispatcherJsQueue_g[dispatcherJsHead_g & (DISPATCHER_JS_QUEUE_SIZE - 1)];
+    dispatcherJsHead_g += 1;
+
+    uv_mutex_unlock(&dispatcherJsMutex_g);
+
+    traceEnd(TRACE_EVENT_LOOP_WAKEUP, event.traceSend, event.gpio, event.tick,
+      event.level, TRACE_FLOW_IN | TRACE_FLOW_OUT);
+
+    uint64_t traceStart = traceBegin();
+
+    GpioCallback_t *target;
+    if (event.type == DISPATCH_ISR) {
+      target = &gpioISR_g[event.gpio];
+    } else {
+      target = &gpioAlert_g[event.gpio];
+    }
+
+    if (target->Callback()) {
+      v8::Local<v8::Value> args[4] = {
+        Nan::New<v8::Integer>(event.gpio),
+        Nan::New<v8::Integer>(event.level),
+        Nan::New<v8::Integer>(event.tick),
+        Nan::New<v8::Integer>(event.tickHi)
+      };
+
+      target->Callback()->Call(4, args, target->Resource());
+    }
+
+    traceEnd(
+      event.type == DISPATCH_ISR ? TRACE_ISR_CALLBACK : TRACE_ALERT_CALLBACK,
+      traceStart, event.gpio, event.tick, event.level, TRACE_FLOW_IN
+    );
+  }
+}
+
+
+// dispatcherThread is not executed in the event loop thread.
+static void dispatcherThread(void *arg) {
+  traceThreadName_t = "dispatcher";
+
+  while (true) {
+    uv_mutex_lock(&dispatcherMutex_g);
+
+    while (dispatcherHead_g == dispatcherTail_g) {
+      uv_cond_wait(&dispatcherNotEmpty_g, &dispatcherMutex_g);
+    }
+
+    DispatcherEvent_t event =
+      dispatcherQueue_g[dispatcherHead_g & (DISPATCHER_QUEUE_SIZE - 1)];
+    dispatcherHead_g += 1;
+
+    uv_cond_signal(&dispatcherNotFull_g);
+    uv_mutex_unlock(&dispatcherMutex_g);
+
+    traceEnd(TRACE_DISPATCHER_QUEUE, event.traceQueued, event.gpio, event.tick,
+      event.level, TRACE_FLOW_IN | TRACE_FLOW_OUT);
+
+    if (event.type == DISPATCH_ISR) {
+      dispatchISR(event.gpio, event.level, event.tick, true);
+    } else {
+      dispatchAlert(event.gpio, event.level, event.tick, true);
+    }
+  }
+}
+
+
+static int dispatcherPolicyToSched(unsigned policy) {
+  switch (policy) {
+    case DISPATCHER_POLICY_FIFO: return SCHED_FIFO;
+    case DISPATCHER_POLICY_RR: return SCHED_RR;
+    default: return SCHED_OTHER;
+  }
+}
+
+
+static unsigned dispatcherSchedToPolicy(int sched) {
+  switch (sched) {
+    case SCHED_FIFO: return DISPATCHER_POLICY_FIFO;
+    case SCHED_RR: return DISPATCHER_POLICY_RR;
+    default: return DISPATCHER_POLICY_OTHER;
+  }
+}
+
+
+// Starts the dispatcher if it isn't running yet and applies the scheduling
+// policy, priority and CPU affinity to it. A cpu of -1 leaves the affinity
+// unchanged. Settings that can't be applied, for example because the process
+// lacks the required privileges, are left unchanged. Returns the settings
+// actually in effect as [policy, priority, cpu, ...].
+NAN_METHOD(dispatcherConfigure) {
+  if (info.Length() < 3 ||
+      !info[0]->IsInt32() ||
+      !info[1]->IsUint32() ||
+      !info[2]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "dispatcherConfigure", ""));
+  }
+
+  int cpu = Nan::To<int32_t>(info[0]).FromJust();
+  unsigned policy = Nan::To<uint32_t>(info[1]).FromJust();
+  unsigned priority = Nan::To<uint32_t>(info[2]).FromJust();
+
+  if (cpu < -1 || cpu >= CPU_SETSIZE || policy > DISPATCHER_POLICY_RR) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "dispatcherConfigure", ""));
+  }
+
+  if (!dispatcherStarted_g) {
+    if (dispatcherJsAsync_g.data == 0) {
+      uv_async_init(
+        uv_default_loop(), &dispatcherJsAsync_g, dispatcherJsEventLoopHandler
+      );
+      dispatcherJsAsync_g.data = &dispatcherJsAsync_g;
+
+      // The asyncs of the GPIOs with callbacks keep the event loop alive.
+      uv_unref((uv_handle_t *) &dispatcherJsAsync_g);
+    }
+
+    if (uv_thread_create(&dispatcherThread_g, dispatcherThread, 0) != 0) {
+      return Nan::ThrowError(Nan::ErrnoException(EAGAIN, "dispatcherConfigure", ""));
+    }
+
+    __atomic_store_n(&dispatcherStarted_g, true, __ATOMIC_RELEASE);
+  }
+
+  if (cpu >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_setaffinity_np(dispatcherThread_g, sizeof(cpus), &cpus);
+  }
+
+  int sched = dispatcherPolicyToSched(policy);
+  struct sched_param param;
+  param.sched_priority = sched == SCHED_OTHER ? 0 : priority;
+  pthread_setschedparam(dispatcherThread_g, sched, &param);
+
+  v8::Local<v8::Array> settings = Nan::New<v8::Array>();
+  unsigned length = 0;
+
+  if (pthread_getschedparam(dispatcherThread_g, &sched, &param) != 0) {
+    sched = SCHED_OTHER;
+    param.sched_priority = 0;
+  }
+
+  Nan::Set(settings, length++,
+    Nan::New<v8::Uint32>(dispatcherSchedToPolicy(sched)));
+  Nan::Set(settings, length++, Nan::New<v8::Int32>(param.sched_priority));
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+
+  if (pthread_getaffinity_np(dispatcherThread_g, sizeof(cpus), &cpus) == 0) {
+    for (int i = 0; i != CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &cpus)) {
+        Nan::Set(settings, length++, Nan::New<v8::Int32>(i));
+      }
+    }
+  }
+
+  info.GetReturnValue().Set(settings);
+}
+
+
+// Returns the number of events for JavaScript that the dispatcher dropped
+// because JavaScript fell too far behind.
+NAN_METHOD(dispatcherDropped) {
+  uv_mutex_lock(&dispatcherJsMutex_g);
+  uint32_t dropped = dispatcherJsDropped_g;
+  uv_mutex_unlock(&dispatcherJsMutex_g);
+
+  info.GetReturnValue().Set(dropped);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* GpioBank                                                                 */
+/* ------------------------------------------------------------------------ */
+
+
+NAN_METHOD(GpioReadBits_0_31) {
+  info.GetReturnValue().Set(gpioRead_Bits_0_31());
+}
+
+
+NAN_METHOD(GpioReadBits_32_53) {
+  info.GetReturnValue().Set(gpioRead_Bits_32_53());
+}
+
+
+NAN_METHOD(GpioWriteBitsSet_0_31) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsSet_0_31", ""));
+  }
+
+  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+
+  int rc = gpioWrite_Bits_0_31_Set(bits);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "GpioWriteBitsSet_0_31");
+  }
+
+  info.GetReturnValue().Set(rc);
+}
+
+
+NAN_METHOD(GpioWriteBitsSet_32_53) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsSet_32_53", ""));
+  }
+
+  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+
+  int rc = gpioWrite_Bits_32_53_Set(bits);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "GpioWriteBitsSet_32_53");
+  }
+
+  info.GetReturnValue().Set(rc);
+}
+
+
+NAN_METHOD(GpioWriteBitsClear_0_31) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsClear_0_31", ""));
+  }
+
+  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+
+  int rc = gpioWrite_Bits_0_31_Clear(bits);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "GpioWriteBitsClear_0_31");
+  }
+
+  info.GetReturnValue().Set(rc);
+}
+
+
+NAN_METHOD(GpioWriteBitsClear_32_53) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsClear_32_53", ""));
+  }
+
+  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+
+  int rc = gpioWrite_Bits_32_53_Clear(bits);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "GpioWriteBitsClear_32_53");
+  }
+
+  info.GetReturnValue().Set(rc);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* State mirror                                                             */
+/* ------------------------------------------------------------------------ */
+
+
+// The state mirror is a SharedArrayBuffer of 32 bit words that is kept up to
+// date on the pigpio thread with the samples pigpio uses to generate alerts.
+// It can be read from JavaScript, including worker threads, without calling
+// into the binding. Bank 2 levels are sampled each time the mirror is
+// updated, they don't have edge ticks or counts.
+//
+// Writes are guarded by a sequence lock. The sequence word is odd while an
+// update is in progress. A reader that sees the same even sequence before and
+// after reading has a consistent view.
+
+#define STATE_MIRROR_SEQUENCE 0
+#define STATE_MIRROR_LEVELS_0_31 1
+#define STATE_MIRROR_LEVELS_32_53 2
+#define STATE_MIRROR_TICK 3
+#define STATE_MIRROR_TICK_HI 4
+#define STATE_MIRROR_EDGE_TICK 8
+#define STATE_MIRROR_EDGE_TICK_HI (STATE_MIRROR_EDGE_TICK + PI_MAX_USER_GPIO + 1)
+#define STATE_MIRROR_EDGE_COUNT (STATE_MIRROR_EDGE_TICK_HI + PI_MAX_USER_GPIO + 1)
+#define STATE_MIRROR_WORDS (STATE_MIRROR_EDGE_COUNT + PI_MAX_USER_GPIO + 1)
+
+static uint32_t stateMirror_g[STATE_MIRROR_WORDS] __attribute__((aligned(8)));
+static Nan::Persistent<v8::SharedArrayBuffer> stateMirrorBuffer_g;
+
+
+static inline void stateMirrorStore(unsigned word, uint32_t value) {
+  __atomic_store_n(&stateMirror_g[word], value, __ATOMIC_RELAXED);
+}
+
+
+static inline void stateMirrorBeginUpdate() {
+  stateMirrorStore(STATE_MIRROR_SEQUENCE, stateMirror_g[STATE_MIRROR_SEQUENCE] + 1);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+static inline void stateMirrorEndUpdate() {
+  __atomic_store_n(
+    &stateMirror_g[STATE_MIRROR_SEQUENCE],
+    stateMirror_g[STATE_MIRROR_SEQUENCE] + 1,
+    __ATOMIC_RELEASE
+  );
+}
+
+
+// stateMirrorSamples is not executed in the event loop thread. It's the only
+// writer of the mirror once the mirror has been started.
+static void stateMirrorSamples(const gpioSample_t *samples, int numSamples) {
+  if (numSamples <= 0) {
+    return;
+  }
+
+  uint32_t levels = stateMirror_g[STATE_MIRROR_LEVELS_0_31];
+  uint64_t tick64 = 0;
+
+  stateMirrorBeginUpdate();
+
+  for (int i = 0; i != numSamples; ++i) {
+    uint32_t changed = samples[i].level ^ levels;
+
+    if (changed == 0) {
+      continue;
+    }
+
+    tick64 = extendTick(samples[i].tick);
+
+    for (unsigned gpio = 0; changed != 0; ++gpio, changed >>= 1) {
+      if (changed & 1) {
+        stateMirrorStore(STATE_MIRROR_EDGE_TICK + gpio, (uint32_t) tick64);
+        stateMirrorStore(STATE_MIRROR_EDGE_TICK_HI + gpio, tick64 >> 32);
+        stateMirrorStore(
+          STATE_MIRROR_EDGE_COUNT + gpio,
+          stateMirror_g[STATE_MIRROR_EDGE_COUNT + gpio] + 1
+        );
+      }
+    }
+
+    levels = samples[i].level;
+  }
+
+  if (tick64 == 0) {
+    tick64 = extendTick(samples[numSamples - 1].tick);
+  }
+
+  stateMirrorStore(STATE_MIRROR_LEVELS_0_31, levels);
+  stateMirrorStore(STATE_MIRROR_LEVELS_32_53, gpioRead_Bits_32_53());
+  stateMirrorStore(STATE_MIRROR_TICK, (uint32_t) tick64);
+  stateMirrorStore(STATE_MIRROR_TICK_HI, tick64 >> 32);
+
+  stateMirrorEndUpdate();
+}
+
+
+// Starts the state mirror and returns its SharedArrayBuffer. The same buffer is returned by every call.
+NAN_METHOD(stateMirror) {
+  if (stateMirrorBuffer_g.IsEmpty()) {
+    uint64_t tick64 = extendTick(gpioTick());
+
+    stateMirrorBeginUpdate();
+    stateMirrorStore(STATE_MIRROR_LEVELS_0_31, gpioRead_Bits_0_31());
+    stateMirrorStore(STATE_MIRROR_LEVELS_32_53, gpioRead_Bits_32_53());
+    stateMirrorStore(STATE_MIRROR_TICK, (uint32_t) tick64);
+    stateMirrorStore(STATE_MIRROR_TICK_HI, tick64 >> 32);
+    stateMirrorEndUpdate();
+
+    v8::Isolate *isolate = v8::Isolate::GetCurrent();
+
+    // The mirror is static so the memory is never released.
+#if V8_MAJOR_VERSION >= 8
+    std::shared_ptr<v8::BackingStore> store =
+      v8::SharedArrayBuffer::NewBackingStore(
+        stateMirror_g,
+        sizeof(stateMirror_g),
+        [](void *data, size_t length, void *deleterData) {},
+        0
+      );
+    v8::Local<v8::SharedArrayBuffer> buffer =
+      v8::SharedArrayBuffer::New(isolate, store);
+#else
+    v8::Local<v8::SharedArrayBuffer> buffer = v8::SharedArrayBuffer::New(
+      isolate, stateMirror_g, sizeof(stateMirror_g)
+    );
+#endif
+
+    stateMirrorBuffer_g.Reset(buffer);
+  }
+
+  // The samples function is installed on every call as pigpio forgets it
+  // when it's terminated.
+  int rc = gpioSetGetSamplesFunc(stateMirrorSamples, 0xffffffff);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "stateMirror");
+  }
+
+  info.GetReturnValue().Set(Nan::New(stateMirrorBuffer_g));
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Snapshot                                                                 */
+/* ------------------------------------------------------------------------ */
+
+
+// A snapshot has SNAPSHOT_FIELDS 32 bit integers for each of GPIOs 0 to 53.
+// Fields that are unknown or don't apply to a GPIO are set to -1.
+
+#define SNAPSHOT_MODE 0
+#define SNAPSHOT_LEVEL 1
+#define SNAPSHOT_PULL_UP_DOWN 2
+#define SNAPSHOT_PWM_DUTY_CYCLE 3
+#define SNAPSHOT_PWM_RANGE 4
+#define SNAPSHOT_PWM_REAL_RANGE 5
+#define SNAPSHOT_PWM_FREQUENCY 6
+#define SNAPSHOT_SERVO_PULSE_WIDTH 7
+#define SNAPSHOT_FIELDS 8
+
+
+static inline int32_t snapshotValue(int rc) {
+  return rc < 0 ? -1 : rc;
+}
+
+
+NAN_METHOD(gpioSnapshot) {
+  if (info.Length() < 3 ||
+      !info[0]->IsUint32() ||
+      !info[1]->IsUint32() ||
+      !info[2]->IsInt32Array()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSnapshot", ""));
+  }
+
+  uint32_t mask_0_31 = Nan::To<uint32_t>(info[0]).FromJust();
+  uint32_t mask_32_53 = Nan::To<uint32_t>(info[1]).FromJust();
+  Nan::TypedArrayContents<int32_t> snapshot(info[2]);
+
+  if (snapshot.length() < (PI_MAX_GPIO + 1) * SNAPSHOT_FIELDS) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSnapshot", ""));
+  }
+
+  for (unsigned gpio = 0; gpio <= PI_MAX_GPIO; ++gpio) {
+    int32_t *fields = *snapshot + gpio * SNAPSHOT_FIELDS;
+
+    for (unsigned i = 0; i != SNAPSHOT_FIELDS; ++i) {
+      fields[i] = -1;
+    }
+
+    uint32_t mask = gpio < 32 ? mask_0_31 : mask_32_53;
+    if ((mask & (1u << (gpio & 31))) == 0) {
+      continue;
+    }
+
+    fields[SNAPSHOT_MODE] = snapshotValue(gpioGetMode(gpio));
+    fields[SNAPSHOT_LEVEL] = snapshotValue(gpioRead(gpio));
+    fields[SNAPSHOT_PULL_UP_DOWN] = gpioPullUpDown_g[gpio];
+
+    if (gpio > PI_MAX_USER_GPIO) {
+      continue;
+    }
+
+    fields[SNAPSHOT_PWM_RANGE] = snapshotValue(gpioGetPWMrange(gpio));
+    fields[SNAPSHOT_PWM_REAL_RANGE] = snapshotValue(gpioGetPWMrealRange(gpio));
+    fields[SNAPSHOT_PWM_FREQUENCY] = snapshotValue(gpioGetPWMfrequency(gpio));
+
+    if (gpioUse_g[gpio] == GPIO_USE_PWM ||
+        gpioUse_g[gpio] == GPIO_USE_HARDWARE_PWM) {
+      fields[SNAPSHOT_PWM_DUTY_CYCLE] =
+        snapshotValue(gpioGetPWMdutycycle(gpio));
+    } else if (gpioUse_g[gpio] == GPIO_USE_SERVO) {
+      fields[SNAPSHOT_SERVO_PULSE_WIDTH] =
+        snapshotValue(gpioGetServoPulsewidth(gpio));
+    }
+  }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Notifier                                                                 */
+/* ------------------------------------------------------------------------ */
+
+
+NAN_METHOD(gpioNotifyOpen) {
+  int rc = gpioNotifyOpen();
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioNotifyOpen");
+  }
+
+  info.GetReturnValue().Set(rc);
+}
+
+
+NAN_METHOD(gpioNotifyOpenWithSize) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyOpenWithSize", ""));
+  }
+
+  unsigned bufSize = Nan::To<uint32_t>(info[0]).FromJust();
+
+  int rc = gpioNotifyOpenWithSize(bufSize);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioNotifyOpen");
+  }
+
+  info.GetReturnValue().Set(rc);
+}
+
+
+NAN_METHOD(gpioNotifyBegin) {
+  if (info.Length() < 2 || !info[0]->IsUint32() || !info[1]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyBegin", ""));
+  }
+
+  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+  unsigned bits = Nan::To<uint32_t>(info[1]).FromJust();
+
+  int rc = gpioNotifyBegin(handle, bits);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioNotifyBegin");
+  }
+}
+
+
+NAN_METHOD(gpioNotifyPause) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyPause", ""));
+  }
+
+  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+
+  int rc = gpioNotifyPause(handle);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioNotifyPause");
+  }
+}
+
+
+NAN_METHOD(gpioNotifyClose) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyClose", ""));
+  }
+
+  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+
+  int rc = gpioNotifyClose(handle);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioNotifyClose");
+  }
+}
+
+
+// The notification hub shares a single pigpio notification handle between
+// any number of subscribers. The notification pipe is read once by a native
+// thread and each report is passed on to the subscribers interested in it.
+// Each subscriber has its own buffer so a slow subscriber doesn't affect the
+// others.
+
+#define NOTIFICATION_LENGTH 12
+#define NOTIFY_HUB_READ_SIZE (NOTIFICATION_LENGTH * 512)
+#define NOTIFY_HUB_PIPE_PATH_PREFIX "/dev/pigpio"
+
+static void notifySubscriberAsyncHandler(uv_async_t* handle);
+static void notifySubscriberCloseHandler(uv_handle_t* handle);
+
+
+class NotifySubscriber_t {
+public:
+  NotifySubscriber_t(unsigned bufferSize, Nan::Callback *callback)
+    : bits_(0),
+      lastLevel_(0),
+      first_(true),
+      seqno_(0),
+      bufferSize_(bufferSize),
+      paused_(false),
+      dropped_(0),
+      callback_(callback),
+      async_resource_(new Nan::AsyncResource("pigpio:notifyHub")) {
+    uv_async_init(uv_default_loop(), &async_, notifySubscriberAsyncHandler);
+    async_.data = this;
+  }
+
+  ~NotifySubscriber_t() {
+    delete callback_;
+    delete async_resource_;
+  }
+
+  // Report is executed in the hub thread with the hub mutex locked.
+  void Report(const uint8_t *report) {
+    uint16_t flags = report[2] | (report[3] << 8);
+    uint32_t level = report[8] | (report[9] << 8) |
+      (report[10] << 16) | ((uint32_t) report[11] << 24);
+    bool deliver;
+
+    if (bits_ == 0) {
+      deliver = false;
+    } else if (flags & PI_NTFY_FLAGS_WDOG) {
+      deliver = (bits_ & (1 << PI_NTFY_FLAGS_BIT(flags))) != 0;
+    } else if (flags != 0) {
+      deliver = true;
+    } else {
+      deliver = first_ || ((level ^ lastLevel_) & bits_) != 0;
+    }
+
+    lastLevel_ = level;
+
+    if (!deliver) {
+      return;
+    }
+
+    first_ = false;
+
+    if (buffer_.size() + NOTIFICATION_LENGTH > bufferSize_) {
+      dropped_ += 1;
+      return;
+    }
+
+    // Reports are renumbered so that the seqnos seen by each subscriber
+    // increment by one.
+    size_t offset = buffer_.size();
+    buffer_.insert(buffer_.end(), report, report + NOTIFICATION_LENGTH);
+    buffer_[offset] = seqno_ & 0xff;
+    buffer_[offset + 1] = seqno_ >> 8;
+    seqno_ += 1;
+
+    if (!paused_) {
+      uv_async_send(&async_);
+    }
+  }
+
+  void SetBits(uint32_t bits) {
+    bits_ = bits;
+    first_ = true;
+  }
+
+  uint32_t Bits() { return bits_; }
+
+  // Deliver is executed in the event loop thread
+  void Deliver();
+
+  void Resume() {
+    paused_ = false;
+    uv_async_send(&async_);
+  }
+
+  void Close() {
+    uv_close((uv_handle_t *) &async_, notifySubscriberCloseHandler);
+  }
+
+  uint32_t Dropped() { return dropped_; }
+
+private:
+  // Protected by the hub mutex
+  uint32_t bits_;
+  uint32_t lastLevel_;
+  bool first_;
+  uint16_t seqno_;
+  unsigned bufferSize_;
+  std::vector<uint8_t> buffer_;
+  bool paused_;
+  uint32_t dropped_;
+
+  uv_async_t async_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+// The thread that reads the notification pipe of a notification handle.
+// When the handle is closed the thread is woken up through a self-pipe so
+// that it exits promptly rather than when pigpio gets round to closing the
+// notification pipe. Once it has exited it's joined in the event loop
+// thread so joining never waits.
+struct NotifyHubThread_t {
+  uv_thread_t thread;
+  int fd;
+  int wakeup[2];
+  bool stopped; // Protected by notifyHubMutex_g
+  uv_async_t async;
+};
+
+
+static uv_mutex_t notifyHubMutex_g;
+static std::vector<NotifySubscriber_t *> notifyHubSubscribers_g;
+static int notifyHubHandle_g = -1;
+static uint32_t notifyHubBits_g;
+static NotifyHubThread_t *notifyHubThread_g;
+
+
+void NotifySubscriber_t::Deliver() {
+  Nan::HandleScope scope;
+
+  std::vector<uint8_t> buffer;
+
+  uv_mutex_lock(&notifyHubMutex_g);
+  buffer.swap(buffer_);
+  uv_mutex_unlock(&notifyHubMutex_g);
+
+  if (buffer.size() == 0) {
+    return;
+  }
+
+  v8::Local<v8::Value> args[1] = {
+    Nan::CopyBuffer((const char *) &buffer[0], buffer.size()).ToLocalChecked()
+  };
+
+  // The callback returns false if the consumer can't accept more data for
+  // the time being. Data is then buffered until Resume is called.
+  Nan::MaybeLocal<v8::Value> rc = callback_->Call(1, args, async_resource_);
+
+  if (!rc.IsEmpty() && rc.ToLocalChecked()->IsFalse()) {
+    uv_mutex_lock(&notifyHubMutex_g);
+    paused_ = true;
+    uv_mutex_unlock(&notifyHubMutex_g);
+  }
+}
+
+
+// notifySubscriberAsyncHandler is executed in the event loop thread.
+static void notifySubscriberAsyncHandler(uv_async_t* handle) {
+  ((NotifySubscriber_t *) handle->data)->Deliver();
+}
+
+
+static void notifySubscriberCloseHandler(uv_handle_t* handle) {
+  delete (NotifySubscriber_t *) handle->data;
+}
+
+
+// notifyHubThread is not executed in the event loop thread. It terminates
+// when it's woken up by notifyHubStop or the notification pipe is closed.
+static void notifyHubThread(void *arg) {
+  NotifyHubThread_t *hub = (NotifyHubThread_t *) arg;
+  uint8_t buf[NOTIFY_HUB_READ_SIZE];
+  size_t length = 0;
+
+  struct pollfd fds[2] = {
+    {hub->fd, POLLIN, 0},
+    {hub->wakeup[0], POLLIN, 0}
+  };
+
+  while (true) {
+    int ready = poll(fds, 2, -1);
+
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (ready < 0 || fds[1].revents != 0) {
+      break;
+    }
+
+    ssize_t rc = read(hub->fd, buf + length, sizeof(buf) - length);
+
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (rc <= 0) {
+      break;
+    }
+
+    length += rc;
+
+    size_t reports = length / NOTIFICATION_LENGTH;
+
+    uv_mutex_lock(&notifyHubMutex_g);
+
+    // The subscribers of a stopped hub thread may already belong to the
+    // next notification handle.
+    for (size_t r = 0; r != reports && !hub->stopped; ++r) {
+      const uint8_t *report = buf + r * NOTIFICATION_LENGTH;
+
+      for (size_t i = 0; i != notifyHubSubscribers_g.size(); ++i) {
+        if (notifyHubSubscribers_g[i] != 0) {
+          notifyHubSubscribers_g[i]->Report(report);
+        }
+      }
+    }
+
+    uv_mutex_unlock(&notifyHubMutex_g);
+
+    // Keep any partial report for the next read.
+    size_t used = reports * NOTIFICATION_LENGTH;
+    memmove(buf, buf + used, length - used);
+    length -= used;
+  }
+
+  close(hub->fd);
+
+  uv_async_send(&hub->async);
+}
+
+
+static void notifyHubThreadCloseHandler(uv_handle_t* handle) {
+  delete (NotifyHubThread_t *) handle->data;
+}
+
+
+// notifyHubThreadAsyncHandler is executed in the event loop thread once the
+// hub thread has exited.
+static void notifyHubThreadAsyncHandler(uv_async_t* handle) {
+  NotifyHubThread_t *hub = (NotifyHubThread_t *) handle->data;
+
+  uv_thread_join(&hub->thread);
+
+  close(hub->wakeup[0]);
+  close(hub->wakeup[1]);
+
+  uv_close((uv_handle_t *) &hub->async, notifyHubThreadCloseHandler);
+}
+
+
+// Asks the hub thread to exit without waiting for it.
+static void notifyHubStop() {
+  NotifyHubThread_t *hub = notifyHubThread_g;
+  if (hub == 0) {
+    return;
+  }
+
+  notifyHubThread_g = 0;
+
+  uv_mutex_lock(&notifyHubMutex_g);
+  hub->stopped = true;
+  uv_mutex_unlock(&notifyHubMutex_g);
+
+  char byte = 0;
+  while (write(hub->wakeup[1], &byte, 1) < 0 && errno == EINTR) {
+  }
+}
+
+
+static int notifyHubOpen() {
+  int handle = gpioNotifyOpenWithSize(0);
+  if (handle < 0) {
+    return handle;
+  }
+
+  char path[32];
+  snprintf(path, sizeof(path), "%s%d", NOTIFY_HUB_PIPE_PATH_PREFIX, handle);
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    gpioNotifyClose(handle);
+    return PI_BAD_HANDLE;
+  }
+
+  NotifyHubThread_t *hub = new NotifyHubThread_t;
+
+  if (pipe(hub->wakeup) < 0) {
+    delete hub;
+    close(fd);
+    gpioNotifyClose(handle);
+    return PI_BAD_HANDLE;
+  }
+
+  hub->fd = fd;
+  hub->stopped = false;
+
+  uv_async_init(uv_default_loop(), &hub->async, notifyHubThreadAsyncHandler);
+  hub->async.data = hub;
+  uv_unref((uv_handle_t *) &hub->async);
+
+  uv_thread_create(&hub->thread, notifyHubThread, hub);
+  notifyHubThread_g = hub;
+  notifyHubHandle_g = handle;
+  notifyHubBits_g = 0;
+
+  return 0;
+}
+
+
+// Restarts the shared notification handle with the union of the bits of
+// all subscribers.
+static int notifyHubUpdate() {
+  uint32_t bits = 0;
+
+  uv_mutex_lock(&notifyHubMutex_g);
+  for (size_t i = 0; i != notifyHubSubscribers_g.size(); ++i) {
+    if (notifyHubSubscribers_g[i] != 0) {
+      bits |= notifyHubSubscribers_g[i]->Bits();
+    }
+  }
+  uv_mutex_unlock(&notifyHubMutex_g);
+
+  if (notifyHubSubscribers_g.size() == 0) {
+    notifyHubStop();
+    gpioNotifyClose(notifyHubHandle_g);
+    notifyHubHandle_g = -1;
+    return 0;
+  }
+
+  if (bits == notifyHubBits_g) {
+    return 0;
+  }
+
+  notifyHubBits_g = bits;
+
+  return bits == 0 ?
+    gpioNotifyPause(notifyHubHandle_g) :
+    gpioNotifyBegin(notifyHubHandle_g, bits);
+}
+
+
+static NotifySubscriber_t *getNotifySubscriber(v8::Local<v8::Value> value) {
+  if (!value->IsUint32()) {
+    return 0;
+  }
+
+  unsigned handle = Nan::To<uint32_t>(value).FromJust();
+  if (handle >= notifyHubSubscribers_g.size()) {
+    return 0;
+  }
+
+  return notifyHubSubscribers_g[handle];
+}
+
+
+NAN_METHOD(notifyHubSubscribe) {
+  if (info.Length() < 2 || !info[0]->IsUint32() || !info[1]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "notifyHubSubscribe", ""));
+  }
+
+  unsigned bufferSize = Nan::To<uint32_t>(info[0]).FromJust();
+
+  if (notifyHubHandle_g < 0) {
+    int rc = notifyHubOpen();
+    if (rc < 0) {
+      return ThrowPigpioError(rc, "notifyHubSubscribe");
+    }
+  }
+
+  NotifySubscriber_t *subscriber = new NotifySubscriber_t(
+    bufferSize, new Nan::Callback(info[1].As<v8::Function>())
+  );
+
+  // Handles are indexes into notifyHubSubscribers_g, closed subscribers
+  // leave a hole that's reused.
+  uv_mutex_lock(&notifyHubMutex_g);
+
+  unsigned handle = 0;
+  while (handle != notifyHubSubscribers_g.size() &&
+      notifyHubSubscribers_g[handle] != 0) {
+    handle += 1;
+  }
+
+  if (handle == notifyHubSubscribers_g.size()) {
+    notifyHubSubscribers_g.push_back(subscriber);
+  } else {
+    notifyHubSubscribers_g[handle] = subscriber;
+  }
+
+  uv_mutex_unlock(&notifyHubMutex_g);
+
+  info.GetReturnValue().Set(handle);
+}
+
+
+NAN_METHOD(notifyHubBegin) {
+  NotifySubscriber_t *subscriber = getNotifySubscriber(info[0]);
+  if (subscriber == 0 || info.Length() < 2 || !info[1]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "notifyHubBegin", ""));
+  }
+
+  uint32_t bits = Nan::To<uint32_t>(info[1]).FromJust();
+
+  uv_mutex_lock(&notifyHubMutex_g);
+  subscriber->SetBits(bits);
+  uv_mutex_unlock(&notifyHubMutex_g);
+
+  int rc = notifyHubUpdate();
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "notifyHubBegin");
+  }
+}
+
+
+NAN_METHOD(notifyHubResume) {
+  NotifySubscriber_t *subscriber = getNotifySubscriber(info[0]);
+  if (subscriber == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "notifyHubResume", ""));
+  }
+
+  uv_mutex_lock(&notifyHubMutex_g);
+  subscriber->Resume();
+  uv_mutex_unlock(&notifyHubMutex_g);
+}
+
+
+NAN_METHOD(notifyHubDropped) {
+  NotifySubscriber_t *subscriber = getNotifySubscriber(info[0]);
+  if (subscriber == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "notifyHubDropped", ""));
+  }
+
+  uv_mutex_lock(&notifyHubMutex_g);
+  uint32_t dropped = subscriber->Dropped();
+  uv_mutex_unlock(&notifyHubMutex_g);
+
+  info.GetReturnValue().Set(dropped);
+}
+
+
+NAN_METHOD(notifyHubClose) {
+  NotifySubscriber_t *subscriber = getNotifySubscriber(info[0]);
+  if (subscriber == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "notifyHubClose", ""));
+  }
+
+  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+
+  uv_mutex_lock(&notifyHubMutex_g);
+
+  notifyHubSubscribers_g[handle] = 0;
+  while (notifyHubSubscribers_g.size() != 0 &&
+      notifyHubSubscribers_g.back() == 0) {
+    notifyHubSubscribers_g.pop_back();
+  }
+
+  uv_mutex_unlock(&notifyHubMutex_g);
+
+  subscriber->Close();
+
+  int rc = notifyHubUpdate();
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "notifyHubClose");
+  }
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Watchdog                                                                 */
+/* ------------------------------------------------------------------------ */
+
+
+static void watchdogAsyncHandler(uv_async_t* handle);
+static void watchdogTimerHandler(uv_timer_t* handle);
+
+
+// The Watchdog_t detects GPIOs that have had no edges for a given number of
+// milliseconds. Edges only update the level and tick of the last edge on the
+// pigpio thread, they never wake the event loop. A single timer in the event
+// loop is armed for the earliest deadline. When it fires all GPIOs that have
+// timed out are passed to JavaScript in one callback and the timer is armed
+// for the next deadline. A GPIO times out once per period of inactivity, the
+// event loop is woken by its next edge so that its deadline can be tracked
+// again.
+//
+// Each timeout passed to JavaScript is three 32 bit words, the low and high
+// 32 bits of the extended tick of the last edge and the GPIO | level << 8.
+
+#define WATCHDOG_RECORD_WORDS 3
+#define WATCHDOG_MAX_TIMEOUT 60000
+
+class Watchdog_t : public AlertListener_t {
+public:
+  Watchdog_t() : enabled_(0), callback_(0), async_resource_(0) {
+    uv_mutex_init(&mutex_);
+
+    for (unsigned gpio = 0; gpio <= PI_MAX_USER_GPIO; ++gpio) {
+      timeout_[gpio] = 0;
+      lastTick_[gpio] = 0;
+      lastLevel_[gpio] = 0;
+      expired_[gpio] = false;
+    }
+
+    uv_async_init(uv_default_loop(), &async_, watchdogAsyncHandler);
+    async_.data = this;
+    uv_unref((uv_handle_t *) &async_);
+
+    uv_timer_init(uv_default_loop(), &timer_);
+    timer_.data = this;
+    uv_unref((uv_handle_t *) &timer_);
+  }
+
+  // Alert is not executed in the event loop thread
+  void Alert(int gpio, int level, uint32_t tick) {
+    if (level == PI_TIMEOUT) {
+      return;
+    }
+
+    uv_mutex_lock(&mutex_);
+
+    bool expired = expired_[gpio];
+
+    lastTick_[gpio] = tick;
+    lastLevel_[gpio] = level;
+    expired_[gpio] = false;
+
+    uv_mutex_unlock(&mutex_);
+
+    if (expired) {
+      uv_async_send(&async_);
+    }
+  }
+
+  void SetCallback(Nan::Callback *callback) {
+    delete callback_;
+    delete async_resource_;
+
+    callback_ = callback;
+    async_resource_ = new Nan::AsyncResource("pigpio:watchdog");
+  }
+
+  // Enable and Disable are executed in the event loop thread
+  void Enable(unsigned gpio, uint32_t timeout) {
+    uv_mutex_lock(&mutex_);
+
+    if (timeout_[gpio] == 0) {
+      enabled_ += 1;
+    }
+
+    timeout_[gpio] = timeout;
+    lastTick_[gpio] = gpioTick();
+    lastLevel_[gpio] = gpioRead(gpio);
+    expired_[gpio] = false;
+
+    uv_mutex_unlock(&mutex_);
+
+    uv_ref((uv_handle_t *) &async_);
+
+    // Check calls into JavaScript so rather than calling it from within
+    // watchdogEnable, let the timer call it on the next loop iteration.
+    uv_timer_start(&timer_, watchdogTimerHandler, 0, 0);
+  }
+
+  void Disable(unsigned gpio) {
+    uv_mutex_lock(&mutex_);
+
+    if (timeout_[gpio] != 0) {
+      enabled_ -= 1;
+    }
+
+    timeout_[gpio] = 0;
+    bool idle = enabled_ == 0;
+
+    uv_mutex_unlock(&mutex_);
+
+    if (idle) {
+      uv_timer_stop(&timer_);
+      uv_unref((uv_handle_t *) &async_);
+    }
+  }
+
+  // Check is executed in the event loop thread. It passes the GPIOs that
+  // have timed out to JavaScript and arms the timer for the next deadline.
+  void Check() {
+    Nan::HandleScope scope;
+
+    std::vector<uint32_t> records;
+    uint32_t next = UINT32_MAX;
+
+    uv_mutex_lock(&mutex_);
+
+    uint32_t tick = gpioTick();
+
+    for (unsigned gpio = 0; gpio <= PI_MAX_USER_GPIO; ++gpio) {
+      if (timeout_[gpio] == 0 || expired_[gpio]) {
+        continue;
+      }
+
+      uint32_t elapsed = tick - lastTick_[gpio];
+      uint32_t timeout = timeout_[gpio] * 1000;
+
+      if (elapsed >= timeout) {
+        uint64_t tick64 = extendTick(lastTick_[gpio]);
+
+        records.push_back((uint32_t) tick64);
+        records.push_back((uint32_t) (tick64 >> 32));
+        records.push_back(gpio | lastLevel_[gpio] << 8);
+
+        expired_[gpio] = true;
+      } else if (timeout - elapsed < next) {
+        next = timeout - elapsed;
+      }
+    }
+
+    uv_mutex_unlock(&mutex_);
+
+    uv_timer_stop(&timer_);
+    if (next != UINT32_MAX) {
+      uv_timer_start(&timer_, watchdogTimerHandler, (next + 999) / 1000, 0);
+    }
+
+    if (!records.empty() && callback_ != 0) {
+      v8::Local<v8::Value> args[1] = {
+        Nan::CopyBuffer(
+          (const char *) &records[0], records.size() * sizeof(uint32_t)
+        ).ToLocalChecked()
+      };
+
+      callback_->Call(1, args, async_resource_);
+    }
+  }
+
+private:
+  // Protected by mutex_
+  unsigned enabled_;
+  uint32_t timeout_[PI_MAX_USER_GPIO + 1];
+  uint32_t lastTick_[PI_MAX_USER_GPIO + 1];
+  int lastLevel_[PI_MAX_USER_GPIO + 1];
+  bool expired_[PI_MAX_USER_GPIO + 1];
+
+  uv_mutex_t mutex_;
+  uv_async_t async_;
+  uv_timer_t timer_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+static Watchdog_t *watchdog_g;
+
+
+// watchdogAsyncHandler is executed in the event loop thread.
+static void watchdogAsyncHandler(uv_async_t* handle) {
+  ((Watchdog_t *) handle->data)->Check();
+}
+
+
+// watchdogTimerHandler is executed in the event loop thread.
+static void watchdogTimerHandler(uv_timer_t* handle) {
+  ((Watchdog_t *) handle->data)->Check();
+}
+
+
+// watchdogEnable(gpio, timeout, callback)
+//
+// The callback is shared by all GPIOs, the most recently passed callback is
+// used for the timeouts of all GPIOs.
+NAN_METHOD(watchdogEnable) {
+  if (info.Length() < 3 ||
+      !info[0]->IsUint32() ||
+      !info[1]->IsUint32() ||
+      !info[2]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "watchdogEnable", ""));
+  }
+
+  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
+  uint32_t timeout = Nan::To<uint32_t>(info[1]).FromJust();
+
+  if (user_gpio > PI_MAX_USER_GPIO) {
+    return ThrowPigpioError(PI_BAD_USER_GPIO, "watchdogEnable");
+  }
+
+  if (timeout == 0 || timeout > WATCHDOG_MAX_TIMEOUT) {
+    return ThrowPigpioError(PI_BAD_WDOG_TIMEOUT, "watchdogEnable");
+  }
+
+  if (watchdog_g == 0) {
+    watchdog_g = new Watchdog_t();
+  }
+
+  watchdog_g->SetCallback(new Nan::Callback(info[2].As<v8::Function>()));
+
+  // Removing first ensures that the listener is only registered once.
+  removeAlertListener(user_gpio, watchdog_g);
+
+  int rc = addAlertListener(user_gpio, watchdog_g);
+  if (rc < 0) {
+    removeAlertListener(user_gpio, watchdog_g);
+    return ThrowPigpioError(rc, "watchdogEnable");
+  }
+
+  watchdog_g->Enable(user_gpio, timeout);
+}
+
+
+NAN_METHOD(watchdogDisable) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "watchdogDisable", ""));
+  }
+
+  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
+
+  if (user_gpio > PI_MAX_USER_GPIO) {
+    return ThrowPigpioError(PI_BAD_USER_GPIO, "watchdogDisable");
+  }
+
+  if (watchdog_g == 0) {
+    return;
+  }
+
+  removeAlertListener(user_gpio, watchdog_g);
+  watchdog_g->Disable(user_gpio);
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Encoder                                                                  */
+/* ------------------------------------------------------------------------ */
+
+
+static void encoderAsyncHandler(uv_async_t* handle);
+static void encoderTimerHandler(uv_timer_t* handle);
+static void encoderCloseHandler(uv_handle_t* handle);
+
+
+// Indexed by (previous state << 2) | current state where a state is
+// (level A << 1) | level B. 1 and -1 are steps forward and backward, 2 is an
+// invalid transition where both A and B changed.
+static const int quadratureTable_g[16] = {
+   0, -1,  1,  2,
+   1,  0,  2, -1,
+  -1,  2,  0,  1,
+   2,  1, -1,  0
+};
+
+
+// A Quadrature_t tracks the state of the A and B channels of a quadrature
+// encoder. pigpio samples all GPIOs at once and alerts for edges detected in
+// the same sample have the same tick, so an edge on one channel with the same
+// tick as the previous edge on the other channel means that both channels
+// changed at the same time. The two edges are combined into one transition
+// and the step already taken for the first edge is undone.
+class Quadrature_t {
+public:
+  Quadrature_t()
+    : state_(0),
+      prevState_(0),
+      lastTick_(0),
+      lastBit_(0),
+      lastStep_(0) {
+  }
+
+  void Reset(unsigned state) {
+    state_ = state;
+    lastBit_ = 0;
+  }
+
+  // Returns the change in position caused by an edge, bit is 2 for A and 1
+  // for B. *invalid is set if the edge completes an invalid transition.
+  int Edge(unsigned bit, int level, uint32_t tick, bool *invalid) {
+    unsigned state = level ? state_ | bit : state_ & ~bit;
+    int delta;
+
+    *invalid = false;
+
+    if (lastBit_ != 0 && lastBit_ != bit && tick == lastTick_) {
+      int step = quadratureTable_g[(prevState_ << 2) | state];
+
+      delta = -lastStep_;
+      if (step == 2) {
+        *invalid = true;
+      } else {
+        delta += step;
+      }
+
+      lastBit_ = 0;
+    } else {
+      int step = quadratureTable_g[(state_ << 2) | state];
+
+      if (step == 2) {
+        *invalid = true;
+        step = 0;
+      }
+
+      delta = step;
+      prevState_ = state_;
+      lastTick_ = tick;
+      lastBit_ = bit;
+      lastStep_ = step;
+    }
+
+    state_ = state;
+
+    return delta;
+  }
+
+private:
+  unsigned state_;
+  unsigned prevState_;
+  uint32_t lastTick_;
+  unsigned lastBit_;
+  int lastStep_;
+};
+
+
+// An Encoder_t decodes the signals from a quadrature encoder on the pigpio
+// thread. JavaScript is informed about the position and velocity at a fixed
+// interval and/or whenever the position has changed by a given number of
+// counts rather than once per edge.
+class Encoder_t : public AlertListener_t {
+public:
+  Encoder_t(
+    unsigned gpioA,
+    unsigned gpioB,
+    unsigned counts,
+    unsigned interval,
+    Nan::Callback *callback
+  ) : gpioA_(gpioA),
+      gpioB_(gpioB),
+      counts_(counts),
+      interval_(interval),
+      position_(0),
+      invalid_(0),
+      reportedPosition_(0),
+      lastPosition_(0),
+      lastTick_(0),
+      openHandles_(2),
+      callback_(callback),
+      async_resource_(new Nan::AsyncResource("pigpio:encoder")) {
+    uv_mutex_init(&mutex_);
+
+    uv_async_init(uv_default_loop(), &async_, encoderAsyncHandler);
+    async_.data = this;
+
+    uv_timer_init(uv_default_loop(), &timer_);
+    timer_.data = this;
+  }
+
+  virtual ~Encoder_t() {
+    uv_mutex_destroy(&mutex_);
+    delete callback_;
+    delete async_resource_;
+  }
+
+  void Start() {
+    quadrature_.Reset(
+      (gpioRead(gpioA_) == 1 ? 2 : 0) | (gpioRead(gpioB_) == 1 ? 1 : 0)
+    );
+    lastTick_ = gpioTick();
+
+    if (interval_ != 0) {
+      uv_timer_start(&timer_, encoderTimerHandler, interval_, interval_);
+    }
+  }
+
+  // Alert is not executed in the event loop thread
+  void Alert(int gpio, int level, uint32_t tick) {
+    if (level == PI_TIMEOUT) {
+      return;
+    }
+
+    uv_mutex_lock(&mutex_);
+
+    bool invalid;
+    position_ += quadrature_.Edge(
+      (unsigned) gpio == gpioA_ ? 2 : 1, level, tick, &invalid
+    );
+
+    if (invalid) {
+      invalid_ += 1;
+    }
+
+    bool report = false;
+
+    if (counts_ != 0) {
+      int64_t delta = position_ - reportedPosition_;
+      if (delta >= counts_ || delta <= -(int64_t) counts_) {
+        reportedPosition_ = position_;
+        report = true;
+      }
+    }
+
+    uv_mutex_unlock(&mutex_);
+
+    if (report) {
+      uv_async_send(&async_);
+    }
+  }
+
+  // Report is executed in the event loop thread
+  void Report() {
+    Nan::HandleScope scope;
+
+    uint32_t tick = gpioTick();
+
+    uv_mutex_lock(&mutex_);
+    int64_t position = position_;
+    uint32_t invalid = invalid_;
+    reportedPosition_ = position_;
+    uv_mutex_unlock(&mutex_);
+
+    uint32_t elapsed = tick - lastTick_;
+    double velocity = elapsed == 0 ? 0 :
+      (double) (position - lastPosition_) * 1000000.0 / elapsed;
+
+    lastPosition_ = position;
+    lastTick_ = tick;
+
+    v8::Local<v8::Value> args[4] = {
+      Nan::New<v8::Number>((double) position),
+      Nan::New<v8::Number>(velocity),
+      Nan::New<v8::Uint32>(invalid),
+      Nan::New<v8::Uint32>(tick)
+    };
+
+    callback_->Call(4, args, async_resource_);
+  }
+
+  int64_t Position() {
+    uv_mutex_lock(&mutex_);
+    int64_t position = position_;
+    uv_mutex_unlock(&mutex_);
+
+    return position;
+  }
+
+  void SetPosition(int64_t position) {
+    uv_mutex_lock(&mutex_);
+    position_ = position;
+    reportedPosition_ = position;
+    invalid_ = 0;
+    uv_mutex_unlock(&mutex_);
+
+    lastPosition_ = position;
+  }
+
+  // The Encoder_t deletes itself once both of its libuv handles are closed.
+  void Close() {
+    uv_timer_stop(&timer_);
+    uv_close((uv_handle_t *) &async_, encoderCloseHandler);
+    uv_close((uv_handle_t *) &timer_, encoderCloseHandler);
+  }
+
+  void HandleClosed() {
+    if (--openHandles_ == 0) {
+      delete this;
+    }
+  }
+
+  unsigned GpioA() { return gpioA_; }
+  unsigned GpioB() { return gpioB_; }
+
+private:
+  unsigned gpioA_;
+  unsigned gpioB_;
+  unsigned counts_;
+  unsigned interval_;
+
+  // Accessed on the pigpio thread, protected by mutex_
+  Quadrature_t quadrature_;
+  int64_t position_;
+  uint32_t invalid_;
+  int64_t reportedPosition_;
+
+  // Only accessed in the event loop thread
+  int64_t lastPosition_;
+  uint32_t lastTick_;
+  int openHandles_;
+
+  uv_mutex_t mutex_;
+  uv_async_t async_;
+  uv_timer_t timer_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+#define MAX_ENCODERS ((PI_MAX_USER_GPIO + 1) / 2)
+
+static Encoder_t *encoders_g[MAX_ENCODERS];
+
+
+// encoderAsyncHandler is executed in the event loop thread.
+static void encoderAsyncHandler(uv_async_t* handle) {
+  ((Encoder_t *) handle->data)->Report();
+}
+
+
+// encoderTimerHandler is executed in the event loop thread.
+static void encoderTimerHandler(uv_timer_t* handle) {
+  ((Encoder_t *) handle->data)->Report();
+}
+
+
+static void encoderCloseHandler(uv_handle_t* handle) {
+  ((Encoder_t *) handle->data)->HandleClosed();
+}
+
+
+static Encoder_t *getEncoder(v8::Local<v8::Value> value) {
+  if (!value->IsUint32()) {
+    return 0;
+  }
+
+  unsigned handle = Nan::To<uint32_t>(value).FromJust();
+  if (handle >= MAX_ENCODERS) {
+    return 0;
+  }
+
+  return encoders_g[handle];
+}
+
+
+NAN_METHOD(encoderOpen) {
+  if (info.Length() < 5 ||
+      !info[0]->IsUint32() ||
+      !info[1]->IsUint32() ||
+      !info[2]->IsUint32() ||
+      !info[3]->IsUint32() ||
+      !info[4]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "encoderOpen", ""));
+  }
+
+  unsigned gpioA = Nan::To<uint32_t>(info[0]).FromJust();
+  unsigned gpioB = Nan::To<uint32_t>(info[1]).FromJust();
+  unsigned counts = Nan::To<uint32_t>(info[2]).FromJust();
+  unsigned interval = Nan::To<uint32_t>(info[3]).FromJust();
+
+  if (gpioA > PI_MAX_USER_GPIO || gpioB > PI_MAX_USER_GPIO) {
+    return ThrowPigpioError(PI_BAD_USER_GPIO, "encoderOpen");
+  }
+
+  if (gpioA == gpioB) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "encoderOpen", ""));
+  }
+
+  unsigned handle = 0;
+  while (handle != MAX_ENCODERS && encoders_g[handle] != 0) {
+    handle += 1;
+  }
+
+  if (handle == MAX_ENCODERS) {
+    return Nan::ThrowError(Nan::ErrnoException(EMFILE, "encoderOpen", ""));
+  }
+
+  Encoder_t *encoder = new Encoder_t(
+    gpioA,
+    gpioB,
+    counts,
+    interval,
+    new Nan::Callback(info[4].As<v8::Function>())
+  );
+
+  encoder->Start();
+
+  int rc = addAlertListener(gpioA, encoder);
+  if (rc >= 0) {
+    rc = addAlertListener(gpioB, encoder);
+  }
+
+  if (rc < 0) {
+    removeAlertListener(gpioA, encoder);
+    removeAlertListener(gpioB, encoder);
+    encoder->Close();
+    return ThrowPigpioError(rc, "encoderOpen");
+  }
+
+  encoders_g[handle] = encoder;
+
+  info.GetReturnValue().Set(handle);
+}
+
+
+NAN_METHOD(encoderPosition) {
+  Encoder_t *encoder = getEncoder(info[0]);
+  if (encoder == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "encoderPosition", ""));
+  }
+
+  info.GetReturnValue().Set((double) encoder->Position());
+}
+
+
+NAN_METHOD(encoderSetPosition) {
+  Encoder_t *encoder = getEncoder(info[0]);
+  if (encoder == 0 || info.Length() < 2 || !info[1]->IsNumber()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "encoderSetPosition", ""));
+  }
+
+  encoder->SetPosition((int64_t) Nan::To<double>(info[1]).FromJust());
+}
+
+
+NAN_METHOD(encoderClose) {
+  Encoder_t *encoder = getEncoder(info[0]);
+  if (encoder == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "encoderClose", ""));
+  }
+
+  encoders_g[Nan::To<uint32_t>(info[0]).FromJust()] = 0;
+
+  removeAlertListener(encoder->GpioA(), encoder);
+  removeAlertListener(encoder->GpioB(), encoder);
+
+  encoder->Close();
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Controller                                                               */
+/* ------------------------------------------------------------------------ */
+
+
+static void controllerAsyncHandler(uv_async_t* handle);
+static void controllerCloseHandler(uv_handle_t* handle);
+static void controllerThread(void *arg);
+
+
+// A Controller_t is a PID controller that runs at a fixed rate on its own
+// thread. Its input is measured from edges on the pigpio thread and its
+// output drives a GPIO with PWM, hardware PWM or servo pulses. Neither the
+// measurement nor the control loop involve JavaScript, so the loop timing
+// doesn't depend on the load of the event loop. The gains, setpoint and
+// output limits can be changed at any time. Every nth iteration a telemetry
+// record is queued for JavaScript.
+//
+// The derivative term acts on the measurement rather than the error so that
+// setpoint changes don't cause output spikes. The integral term is clamped
+// to the output limits and isn't accumulated while the output is saturated
+// in the direction of the error (anti-windup).
+//
+// Each telemetry record is five doubles, the extended tick, the setpoint,
+// the measurement, the output and the integral term.
+
+enum {
+  CONTROLLER_INPUT_FREQUENCY = 0,
+  CONTROLLER_INPUT_PULSE_WIDTH = 1,
+  CONTROLLER_INPUT_ENCODER = 2
+};
+
+enum {
+  CONTROLLER_OUTPUT_PWM = 0,
+  CONTROLLER_OUTPUT_HARDWARE_PWM = 1,
+  CONTROLLER_OUTPUT_SERVO = 2
+};
+
+// The order of the parameters must match CONTROLLER_PARAMS in pigpio.js.
+enum {
+  CONTROLLER_KP = 0,
+  CONTROLLER_KI = 1,
+  CONTROLLER_KD = 2,
+  CONTROLLER_SETPOINT = 3,
+  CONTROLLER_MIN = 4,
+  CONTROLLER_MAX = 5,
+  CONTROLLER_PARAM_COUNT = 6
+};
+
+#define CONTROLLER_RECORD_DOUBLES 5
+#define CONTROLLER_MAX_PENDING 4096
+#define CONTROLLER_MIN_INTERVAL 100
+#define CONTROLLER_MAX_INTERVAL 1000000
+
+class Controller_t : public AlertListener_t {
+public:
+  Controller_t(
+    unsigned inputType,
+    unsigned gpioA,
+    unsigned gpioB,
+    unsigned outputType,
+    unsigned outputGpio,
+    unsigned outputFrequency,
+    uint32_t interval,
+    uint32_t decimation,
+    const double *params,
+    Nan::Callback *callback
+  ) : inputType_(inputType),
+      gpioA_(gpioA),
+      gpioB_(gpioB),
+      outputType_(outputType),
+      outputGpio_(outputGpio),
+      outputFrequency_(outputFrequency),
+      interval_(interval),
+      decimation_(decimation),
+      position_(0),
+      riseTick_(0),
+      period_(0),
+      pulseWidth_(0),
+      rising_(false),
+      reset_(true),
+      stop_(false),
+      dropped_(0),
+      integral_(0),
+      lastMeasurement_(0),
+      started_(false),
+      joined_(false),
+      callback_(callback),
+      async_resource_(new Nan::AsyncResource("pigpio:controller")) {
+    for (unsigned i = 0; i != CONTROLLER_PARAM_COUNT; ++i) {
+      params_[i] = params[i];
+    }
+
+    // The encoder state is read before the alert listeners are added.
+    if (inputType_ == CONTROLLER_INPUT_ENCODER) {
+      quadrature_.Reset(
+        (gpioRead(gpioA_) == 1 ? 2 : 0) | (gpioRead(gpioB_) == 1 ? 1 : 0)
+      );
+    }
+
+    uv_mutex_init(&mutex_);
+    uv_cond_init(&cond_);
+
+    uv_async_init(uv_default_loop(), &async_, controllerAsyncHandler);
+    async_.data = this;
+  }
+
+  virtual ~Controller_t() {
+    uv_cond_destroy(&cond_);
+    uv_mutex_destroy(&mutex_);
+    delete callback_;
+    delete async_resource_;
+  }
+
+  void Start() {
+    uv_thread_create(&thread_, controllerThread, this);
+    started_ = true;
+  }
+
+  // Alert is not executed in the event loop thread
+  void Alert(int gpio, int level, uint32_t tick) {
+    if (level == PI_TIMEOUT) {
+      return;
+    }
+
+    uv_mutex_lock(&mutex_);
+
+    if (inputType_ == CONTROLLER_INPUT_ENCODER) {
+      bool invalid;
+
+      position_ += quadrature_.Edge(
+        (unsigned) gpio == gpioA_ ? 2 : 1, level, tick, &invalid
+      );
+    } else if (level == 1) {
+      if (rising_) {
+        period_ = tick - riseTick_;
+      }
+
+      riseTick_ = tick;
+      rising_ = true;
+    } else if (rising_) {
+      pulseWidth_ = tick - riseTick_;
+    }
+
+    uv_mutex_unlock(&mutex_);
+  }
+
+  void Set(const double *params, bool reset) {
+    uv_mutex_lock(&mutex_);
+
+    for (unsigned i = 0; i != CONTROLLER_PARAM_COUNT; ++i) {
+      params_[i] = params[i];
+    }
+
+    if (reset) {
+      reset_ = true;
+    }
+
+    uv_mutex_unlock(&mutex_);
+  }
+
+  void Stop() {
+    uv_mutex_lock(&mutex_);
+    stop_ = true;
+    uv_cond_signal(&cond_);
+    uv_mutex_unlock(&mutex_);
+  }
+
+  // Run is not executed in the event loop thread.
+  void Run() {
+    traceThreadName_t = "controller";
+
+    uint32_t next = gpioTick();
+    uint32_t lastTick = next;
+    uint32_t iteration = 0;
+
+    while (true) {
+      uv_mutex_lock(&mutex_);
+
+      // Wait on cond_ rather than sleeping so that Stop, and with it
+      // Close in the event loop thread, doesn't wait for up to an interval.
+      int32_t wait = (int32_t) (next - gpioTick());
+      while (!stop_ && wait > 0) {
+        uv_cond_timedwait(&cond_, &mutex_, (uint64_t) wait * 1000);
+        wait = (int32_t) (next - gpioTick());
+      }
+
+      uint32_t tick = gpioTick();
+      double params[CONTROLLER_PARAM_COUNT];
+
+      if (stop_) {
+        uv_mutex_unlock(&mutex_);
+        break;
+      }
+
+      for (unsigned i = 0; i != CONTROLLER_PARAM_COUNT; ++i) {
+        params[i] = params_[i];
+      }
+
+      bool reset = reset_;
+      reset_ = false;
+
+      double measurement = Measure(tick);
+
+      uv_mutex_unlock(&mutex_);
+
+      uint64_t traceStart = traceBegin();
+
+      double dt = (tick - lastTick) / 1000000.0;
+      double output = Step(params, measurement, reset ? 0 : dt);
+
+      Drive(output);
+
+      traceEnd(TRACE_CONTROL_STEP, traceStart, outputGpio_, tick,
+        (uint32_t) output, 0);
+
+      if (decimation_ != 0 && ++iteration == decimation_) {
+        iteration = 0;
+        Queue(tick, params[CONTROLLER_SETPOINT], measurement, output);
+      }
+
+      lastTick = tick;
+
+      // If the loop fell behind, for example because the thread was
+      // preempted, continue at the current time rather than catching up
+      // with a burst of iterations.
+      next += interval_;
+      if ((int32_t) (gpioTick() - next) > (int32_t) interval_) {
+        next = gpioTick();
+      }
+    }
+  }
+
+  // Deliver is executed in the event loop thread
+  void Deliver() {
+    Nan::HandleScope scope;
+
+    std::vector<double> records;
+
+    uv_mutex_lock(&mutex_);
+    records.swap(pending_);
+    uint32_t dropped = dropped_;
+    uv_mutex_unlock(&mutex_);
+
+    if (records.empty()) {
+      return;
+    }
+
+    v8::Local<v8::Value> args[2] = {
+      Nan::CopyBuffer(
+        (const char *) &records[0], records.size() * sizeof(double)
+      ).ToLocalChecked(),
+      Nan::New<v8::Uint32>(dropped)
+    };
+
+    callback_->Call(2, args, async_resource_);
+  }
+
+  // The Controller_t deletes itself once its libuv handle is closed.
+  void Close() {
+    Stop();
+    Join();
+    uv_close((uv_handle_t *) &async_, controllerCloseHandler);
+  }
+
+  int Drive(double output) {
+    unsigned value = (unsigned) (output + 0.5);
+
+    if (outputType_ == CONTROLLER_OUTPUT_PWM) {
+      return gpioPWM(outputGpio_, value);
+    } else if (outputType_ == CONTROLLER_OUTPUT_HARDWARE_PWM) {
+      return gpioHardwarePWM(outputGpio_, outputFrequency_, value);
+    }
+
+    return gpioServo(outputGpio_, value);
+  }
+
+  unsigned InputType() { return inputType_; }
+  unsigned GpioA() { return gpioA_; }
+  unsigned GpioB() { return gpioB_; }
+  unsigned OutputGpio() { return outputGpio_; }
+
+  unsigned OutputUse() {
+    if (outputType_ == CONTROLLER_OUTPUT_PWM) {
+      return GPIO_USE_PWM;
+    } else if (outputType_ == CONTROLLER_OUTPUT_HARDWARE_PWM) {
+      return GPIO_USE_HARDWARE_PWM;
+    }
+
+    return GPIO_USE_SERVO;
+  }
+
+private:
+  void Join() {
+    if (started_ && !joined_) {
+      uv_thread_join(&thread_);
+      joined_ = true;
+    }
+  }
+
+  // Returns the frequency in Hz, the pulse width in microseconds or the
+  // encoder position. A frequency decays towards 0 when the edges stop, as
+  // the period is at least the time since the last rising edge. Called with
+  // mutex_ locked.
+  double Measure(uint32_t tick) {
+    if (inputType_ == CONTROLLER_INPUT_ENCODER) {
+      return (double) position_;
+    }
+
+    if (inputType_ == CONTROLLER_INPUT_PULSE_WIDTH) {
+      return pulseWidth_;
+    }
+
+    if (!rising_ || period_ == 0) {
+      return 0;
+    }
+
+    uint32_t sinceRise = tick - riseTick_;
+    uint32_t period = sinceRise > period_ ? sinceRise : period_;
+
+    return 1000000.0 / period;
+  }
+
+  // Computes the output for a measurement. dt is 0 on the first iteration
+  // and after a reset which clears the integral and derivative history.
+  double Step(const double *params, double measurement, double dt) {
+    double min = params[CONTROLLER_MIN];
+    double max = params[CONTROLLER_MAX];
+    double error = params[CONTROLLER_SETPOINT] - measurement;
+    double derivative = 0;
+
+    if (dt == 0) {
+      integral_ = 0;
+    } else {
+      derivative = -params[CONTROLLER_KD] *
+        (measurement - lastMeasurement_) / dt;
+    }
+
+    lastMeasurement_ = measurement;
+
+    double proportional = params[CONTROLLER_KP] * error;
+    double output = proportional + integral_ + derivative;
+
+    if (!((output >= max && error > 0) || (output <= min && error < 0))) {
+      integral_ += params[CONTROLLER_KI] * error * dt;
+      integral_ = integral_ > max ? max : integral_ < min ? min : integral_;
+      output = proportional + integral_ + derivative;
+    }
+
+    return output > max ? max : output < min ? min : output;
+  }
+
+
+  void Queue(uint32_t tick, double setpoint, double measurement, double output) {
+    bool wakeup = false;
+
+    uv_mutex_lock(&mutex_);
+
+    if (pending_.size() == CONTROLLER_MAX_PENDING * CONTROLLER_RECORD_DOUBLES) {
+      dropped_ += 1;
+    } else {
+      pending_.push_back((double) extendTick(tick));
+      pending_.push_back(setpoint);
+      pending_.push_back(measurement);
+      pending_.push_back(output);
+      pending_.push_back(integral_);
+      wakeup = pending_.size() == CONTROLLER_RECORD_DOUBLES;
+    }
+
+    uv_mutex_unlock(&mutex_);
+
+    if (wakeup) {
+      uv_async_send(&async_);
+    }
+  }
+
+  const unsigned inputType_;
+  const unsigned gpioA_;
+  const unsigned gpioB_;
+  const unsigned outputType_;
+  const unsigned outputGpio_;
+  const unsigned outputFrequency_;
+  const uint32_t interval_;
+  const uint32_t decimation_;
+
+  // Protected by mutex_
+  Quadrature_t quadrature_;
+  int64_t position_;
+  uint32_t riseTick_;
+  uint32_t period_;
+  uint32_t pulseWidth_;
+  bool rising_;
+  double params_[CONTROLLER_PARAM_COUNT];
+  bool reset_;
+  bool stop_;
+  std::vector<double> pending_;
+  uint32_t dropped_;
+
+  // Only accessed by the controller thread
+  double integral_;
+  double lastMeasurement_;
+
+  uv_thread_t thread_;
+  bool started_;
+  bool joined_;
+  uv_mutex_t mutex_;
+  uv_cond_t cond_;
+  uv_async_t async_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+#define MAX_CONTROLLERS 8
+
+static Controller_t *controllers_g[MAX_CONTROLLERS];
+
+
+// controllerThread is not executed in the event loop thread.
+static void controllerThread(void *arg) {
+  ((Controller_t *) arg)->Run();
+}
+
+
+// controllerAsyncHandler is executed in the event loop thread.
+static void controllerAsyncHandler(uv_async_t* handle) {
+  ((Controller_t *) handle->data)->Deliver();
+}
+
+
+static void controllerCloseHandler(uv_handle_t* handle) {
+  delete (Controller_t *) handle->data;
+}
+
+
+static Controller_t *getController(v8::Local<v8::Value> value) {
+  if (!value->IsUint32()) {
+    return 0;
+  }
+
+  unsigned handle = Nan::To<uint32_t>(value).FromJust();
+  if (handle >= MAX_CONTROLLERS) {
+    return 0;
+  }
+
+  return controllers_g[handle];
+}
+
+
+static bool getControllerParams(v8::Local<v8::Value> value, double *params) {
+  if (!value->IsFloat64Array()) {
+    return false;
+  }
+
+  Nan::TypedArrayContents<double> contents(value);
+  if (contents.length() != CONTROLLER_PARAM_COUNT) {
+    return false;
+  }
+
+  for (unsigned i = 0; i != CONTROLLER_PARAM_COUNT; ++i) {
+    params[i] = (*contents)[i];
+  }
+
+  return params[CONTROLLER_MIN] <= params[CONTROLLER_MAX] &&
+    params[CONTROLLER_MIN] >= 0;
+}
+
+
+static void removeControllerListeners(Controller_t *controller) {
+  removeAlertListener(controller->GpioA(), controller);
+
+  if (controller->InputType() == CONTROLLER_INPUT_ENCODER) {
+    removeAlertListener(controller->GpioB(), controller);
+  }
+}
+
+
+// controllerOpen(inputType, gpioA, gpioB, outputType, outputGpio,
+//   outputFrequency, interval, decimation, params, callback)
+NAN_METHOD(controllerOpen) {
+  if (info.Length() < 10 ||
+      !info[9]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "controllerOpen", ""));
+  }
+
+  uint32_t args[8];
+
+  for (int i = 0; i != 8; ++i) {
+    if (!info[i]->IsUint32()) {
+      return Nan::ThrowError(Nan::ErrnoException(EINVAL, "controllerOpen", ""));
+    }
+
+    args[i] = Nan::To<uint32_t>(info[i]).FromJust();
+  }
+
+  unsigned inputType = args[0];
+  unsigned gpioA = args[1];
+  unsigned gpioB = args[2];
+  unsigned outputType = args[3];
+  unsigned outputGpio = args[4];
+  double params[CONTROLLER_PARAM_COUNT];
+
+  if (inputType > CONTROLLER_INPUT_ENCODER ||
+      outputType > CONTROLLER_OUTPUT_SERVO ||
+      args[6] < CONTROLLER_MIN_INTERVAL ||
+      args[6] > CONTROLLER_MAX_INTERVAL ||
+      !getControllerParams(info[8], params)) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "controllerOpen", ""));
+  }
+
+  if (gpioA > PI_MAX_USER_GPIO ||
+      gpioB > PI_MAX_USER_GPIO ||
+      outputGpio > PI_MAX_GPIO) {
+    return ThrowPigpioError(PI_BAD_USER_GPIO, "controllerOpen");
+  }
+
+  if (inputType == CONTROLLER_INPUT_ENCODER && gpioA == gpioB) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "controllerOpen", ""));
+  }
+
+  unsigned handle = 0;
+  while (handle != MAX_CONTROLLERS && controllers_g[handle] != 0) {
+    handle += 1;
+  }
+
+  if (handle == MAX_CONTROLLERS) {
+    return Nan::ThrowError(Nan::ErrnoException(EMFILE, "controllerOpen", ""));
+  }
+
+  Controller_t *controller = new Controller_t(
+    inputType,
+    gpioA,
+    gpioB,
+    outputType,
+    outputGpio,
+    args[5],
+    args[6],
+    args[7],
+    params,
+    new Nan::Callback(info[9].As<v8::Function>())
+  );
+
+  // Driving the lower output limit checks that the output GPIO supports the
+  // output type before the control loop starts.
+  int rc = controller->Drive(params[CONTROLLER_MIN]);
+
+  if (rc >= 0) {
+    rc = addAlertListener(gpioA, controller);
+  }
+
+  if (rc >= 0 && inputType == CONTROLLER_INPUT_ENCODER) {
+    rc = addAlertListener(gpioB, controller);
+  }
+
+  // The control loop isn't started until everything else has succeeded so
+  // closing the controller on failure doesn't have a thread to join.
+  if (rc < 0) {
+    removeControllerListeners(controller);
+    controller->Close();
+    return ThrowPigpioError(rc, "controllerOpen");
+  }
+
+  controller->Start();
+
+  gpioUse_g[outputGpio] = controller->OutputUse();
+  controllers_g[handle] = controller;
+
+  info.GetReturnValue().Set(handle);
+}
+
+
+// controllerSet(handle, params, reset)
+NAN_METHOD(controllerSet) {
+  Controller_t *controller = getController(info[0]);
+  double params[CONTROLLER_PARAM_COUNT];
+
+  if (controller == 0 ||
+      info.Length() < 3 ||
+      !getControllerParams(info[1], params) ||
+      !info[2]->IsBoolean()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "controllerSet", ""));
+  }
+
+  controller->Set(params, Nan::To<bool>(info[2]).FromJust());
+}
+
+
+NAN_METHOD(controllerClose) {
+  Controller_t *controller = getController(info[0]);
+  if (controller == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "controllerClose", ""));
+  }
+
+  controllers_g[Nan::To<uint32_t>(info[0]).FromJust()] = 0;
+  gpioUse_g[controller->OutputGpio()] = GPIO_USE_NONE;
+
+  removeControllerListeners(controller);
+
+  controller->Close();
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Decoder                                                                  */
+/* ------------------------------------------------------------------------ */
+
+
+static void decoderAsyncHandler(uv_async_t* handle);
+static void decoderTimerHandler(uv_timer_t* handle);
+static void decoderCloseHandler(uv_handle_t* handle);
+
+
+#define MAX_FRAME_BITS 256
+
+enum {
+  DECODER_PULSE = 0,
+  DECODER_RC5 = 1,
+  DECODER_DHT = 2,
+  DECODER_WIEGAND = 3
+};
+
+
+struct Frame_t {
+  uint8_t data[MAX_FRAME_BITS / 8];
+  unsigned bits;
+  uint32_t tick;
+  uint32_t deviation;
+};
+
+
+// A Decoder_t is a state machine that decodes an edge timing protocol on the
+// pigpio thread. The state machine is fed with the level and duration of
+// each period between two edges. Only completed frames are passed on to
+// JavaScript. Protocols whose frames end with a pause rather than an edge
+// poll for the end of the frame in the event loop thread with a timer.
+class Decoder_t : public AlertListener_t {
+public:
+  Decoder_t(Nan::Callback *callback)
+    : openHandles_(2),
+      callback_(callback),
+      async_resource_(new Nan::AsyncResource("pigpio:decoder")) {
+    for (unsigned i = 0; i != 2; ++i) {
+      gpios_[i] = 0;
+      lastTick_[i] = 0;
+      started_[i] = false;
+    }
+    gpioCount_ = 0;
+
+    uv_mutex_init(&mutex_);
+
+    uv_async_init(uv_default_loop(), &async_, decoderAsyncHandler);
+    async_.data = this;
+
+    uv_timer_init(uv_default_loop(), &timer_);
+    timer_.data = this;
+
+    Reset();
+  }
+
+  virtual ~Decoder_t() {
+    uv_mutex_destroy(&mutex_);
+    delete callback_;
+    delete async_resource_;
+  }
+
+  void AddGpio(unsigned gpio) {
+    gpios_[gpioCount_++] = gpio;
+  }
+
+  unsigned GpioCount() { return gpioCount_; }
+  unsigned Gpio(unsigned i) { return gpios_[i]; }
+
+  // Alert is not executed in the event loop thread
+  void Alert(int gpio, int level, uint32_t tick) {
+    unsigned ix = (unsigned) gpio == gpios_[0] ? 0 : 1;
+
+    if (level == PI_TIMEOUT) {
+      return;
+    }
+
+    if (started_[ix]) {
+      Period(ix, 1 - level, tick - lastTick_[ix], tick);
+    }
+
+    started_[ix] = true;
+    lastTick_[ix] = tick;
+  }
+
+  // Deliver is executed in the event loop thread
+  void Deliver() {
+    Nan::HandleScope scope;
+
+    std::vector<Frame_t> frames;
+
+    Poll();
+
+    uv_mutex_lock(&mutex_);
+    frames.swap(frames_);
+    uv_mutex_unlock(&mutex_);
+
+    for (size_t i = 0; i != frames.size(); ++i) {
+      v8::Local<v8::Value> args[4] = {
+        Nan::CopyBuffer(
+          (const char *) frames[i].data, (frames[i].bits + 7) / 8
+        ).ToLocalChecked(),
+        Nan::New<v8::Uint32>(frames[i].bits),
+        Nan::New<v8::Uint32>(frames[i].tick),
+        Nan::New<v8::Uint32>(frames[i].deviation)
+      };
+
+      callback_->Call(4, args, async_resource_);
+    }
+  }
+
+  // The Decoder_t deletes itself once both of its libuv handles are closed.
+  void Close() {
+    uv_timer_stop(&timer_);
+    uv_close((uv_handle_t *) &async_, decoderCloseHandler);
+    uv_close((uv_handle_t *) &timer_, decoderCloseHandler);
+  }
+
+  void HandleClosed() {
+    if (--openHandles_ == 0) {
+      delete this;
+    }
+  }
+
+protected:
+  // Period informs the state machine that gpios_[ix] was at level for
+  // duration microseconds. tick is the end of the period.
+  virtual void Period(unsigned ix, int level, uint32_t duration, uint32_t tick) = 0;
+
+  // Poll is executed in the event loop thread before frames are delivered,
+  // when the decoder is woken up or when its timer expires.
+  virtual void Poll() {
+  }
+
+  // Wakes up the event loop thread to poll. May be called from any thread.
+  void Wakeup() {
+    uv_async_send(&async_);
+  }
+
+  // Polls again after timeout milliseconds. Only called in the event loop
+  // thread.
+  void PollAfter(uint64_t timeout) {
+    uv_timer_start(&timer_, decoderTimerHandler, timeout, 0);
+  }
+
+  void Reset() {
+    memset(&frame_, 0, sizeof(frame_));
+  }
+
+  void AppendBit(unsigned bit, bool msbFirst) {
+    if (frame_.bits == MAX_FRAME_BITS) {
+      return;
+    }
+
+    unsigned byte = frame_.bits / 8;
+    unsigned shift = msbFirst ? 7 - frame_.bits % 8 : frame_.bits % 8;
+
+    frame_.data[byte] |= (bit & 1) << shift;
+    frame_.bits += 1;
+  }
+
+  // Returns true if duration is within tolerance percent of nominal and
+  // records the deviation in the current frame.
+  bool Matches(uint32_t duration, uint32_t nominal, uint32_t tolerance) {
+    uint32_t deviation = duration > nominal ?
+      duration - nominal : nominal - duration;
+
+    return deviation <= nominal * tolerance / 100;
+  }
+
+  void Measured(uint32_t duration, uint32_t nominal) {
+    uint32_t deviation = duration > nominal ?
+      duration - nominal : nominal - duration;
+
+    if (deviation > frame_.deviation) {
+      frame_.deviation = deviation;
+    }
+  }
+
+  void EmitFrame(uint32_t tick) {
+    frame_.tick = tick;
+
+    uv_mutex_lock(&mutex_);
+    frames_.push_back(frame_);
+    uv_mutex_unlock(&mutex_);
+
+    uv_async_send(&async_);
+
+    Reset();
+  }
+
+  Frame_t frame_;
+
+private:
+  unsigned gpios_[2];
+  unsigned gpioCount_;
+  uint32_t lastTick_[2];
+  bool started_[2];
+
+  uv_mutex_t mutex_;
+  std::vector<Frame_t> frames_;
+  uv_async_t async_;
+  uv_timer_t timer_;
+  unsigned openHandles_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+// Table driven decoder for pulse distance and pulse width protocols such as
+// NEC or Sony SIRC. A bit consists of a mark followed by a space and the
+// value of the bit is determined by the lengths of the mark and space.
+enum {
+  PULSE_HEADER_MARK,
+  PULSE_HEADER_SPACE,
+  PULSE_REPEAT_SPACE,
+  PULSE_ZERO_MARK,
+  PULSE_ZERO_SPACE,
+  PULSE_ONE_MARK,
+  PULSE_ONE_SPACE,
+  PULSE_BITS,
+  PULSE_TOLERANCE,
+  PULSE_ACTIVE_LOW,
+  PULSE_MSB_FIRST,
+  PULSE_PARAMS
+};
+
+
+class PulseDecoder_t : public Decoder_t {
+public:
+  PulseDecoder_t(const uint32_t *params, Nan::Callback *callback)
+    : Decoder_t(callback) {
+    memcpy(params_, params, sizeof(params_));
+    state_ = IDLE;
+  }
+
+protected:
+  void Period(unsigned ix, int level, uint32_t duration, uint32_t tick) {
+    bool mark = level == (params_[PULSE_ACTIVE_LOW] ? 0 : 1);
+
+    if (!Step(mark, duration, tick)) {
+      // Not part of the current frame, it may be the start of the next one.
+      Reset();
+      state_ = IDLE;
+      Step(mark, duration, tick);
+    }
+  }
+
+private:
+  enum { IDLE, HEADER_SPACE, BIT_MARK, BIT_SPACE };
+
+  bool Matches(uint32_t duration, unsigned param) {
+    return Decoder_t::Matches(
+      duration, params_[param], params_[PULSE_TOLERANCE]
+    );
+  }
+
+  bool Step(bool mark, uint32_t duration, uint32_t tick) {
+    bool pulseWidth =
+      params_[PULSE_ZERO_MARK] != params_[PULSE_ONE_MARK];
+    bool lastBit = frame_.bits + 1 == params_[PULSE_BITS];
+
+    switch (state_) {
+      case IDLE:
+        if (params_[PULSE_HEADER_MARK] == 0) {
+          state_ = BIT_MARK;
+          return Step(mark, duration, tick);
+        }
+
+        if (!mark || !Matches(duration, PULSE_HEADER_MARK)) {
+          return mark ? false : true;
+        }
+
+        Measured(duration, params_[PULSE_HEADER_MARK]);
+        state_ = HEADER_SPACE;
+        return true;
+
+      case HEADER_SPACE:
+        if (mark) {
+          return false;
+        }
+
+        if (params_[PULSE_REPEAT_SPACE] != 0 &&
+            Matches(duration, PULSE_REPEAT_SPACE)) {
+          // A repeat frame has no data bits.
+          Measured(duration, params_[PULSE_REPEAT_SPACE]);
+          EmitFrame(tick);
+          state_ = IDLE;
+          return true;
+        }
+
+        if (!Matches(duration, PULSE_HEADER_SPACE)) {
+          return false;
+        }
+
+        Measured(duration, params_[PULSE_HEADER_SPACE]);
+        state_ = BIT_MARK;
+        return true;
+
+      case BIT_MARK:
+        if (!mark) {
+          return params_[PULSE_HEADER_MARK] == 0 && frame_.bits == 0;
+        }
+
+        if (Matches(duration, PULSE_ZERO_MARK)) {
+          markBit_ = 0;
+          Measured(duration, params_[PULSE_ZERO_MARK]);
+        } else if (Matches(duration, PULSE_ONE_MARK)) {
+          markBit_ = 1;
+          Measured(duration, params_[PULSE_ONE_MARK]);
+        } else {
+          return false;
+        }
+
+        if (pulseWidth && lastBit) {
+          // The space after the last bit of a pulse width protocol merges
+          // with the gap before the next frame.
+          AppendBit(markBit_, params_[PULSE_MSB_FIRST]);
+          EmitFrame(tick);
+          state_ = IDLE;
+          return true;
+        }
+
+        state_ = BIT_SPACE;
+        return true;
+
+      case BIT_SPACE: {
+        if (mark) {
+          return false;
+        }
+
+        unsigned bit;
+
+        if (Matches(duration, PULSE_ZERO_SPACE) &&
+            (!pulseWidth || markBit_ == 0)) {
+          bit = 0;
+          Measured(duration, params_[PULSE_ZERO_SPACE]);
+        } else if (Matches(duration, PULSE_ONE_SPACE) &&
+            (!pulseWidth || markBit_ == 1)) {
+          bit = 1;
+          Measured(duration, params_[PULSE_ONE_SPACE]);
+        } else {
+          return false;
+        }
+
+        AppendBit(bit, params_[PULSE_MSB_FIRST]);
+
+        if (frame_.bits == params_[PULSE_BITS]) {
+          EmitFrame(tick);
+          state_ = IDLE;
+        } else {
+          state_ = BIT_MARK;
+        }
+
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  uint32_t params_[PULSE_PARAMS];
+  unsigned state_;
+  unsigned markBit_;
+};
+
+
+// Philips RC5. Each of the 14 bits is Manchester encoded with two 889us
+// halves, a 1 is a space followed by a mark. Frames are three bytes, the
+// address, the command including the RC5X seventh command bit, and the
+// toggle bit.
+#define RC5_HALF_BIT 889
+#define RC5_BITS 14
+
+class Rc5Decoder_t : public Decoder_t {
+public:
+  Rc5Decoder_t(bool activeLow, Nan::Callback *callback)
+    : Decoder_t(callback), activeLow_(activeLow), halves_(0) {
+  }
+
+protected:
+  void Period(unsigned ix, int level, uint32_t duration, uint32_t tick) {
+    bool mark = level == (activeLow_ ? 0 : 1);
+    unsigned count;
+
+    if (Decoder_t::Matches(duration, RC5_HALF_BIT, 30)) {
+      count = 1;
+      Measured(duration, RC5_HALF_BIT);
+    } else if (Decoder_t::Matches(duration, 2 * RC5_HALF_BIT, 30)) {
+      count = 2;
+      Measured(duration, 2 * RC5_HALF_BIT);
+    } else {
+      Restart();
+      return;
+    }
+
+    if (halves_ == 0) {
+      if (!mark) {
+        return;
+      }
+
+      // The first half of the first start bit is a space which can't be
+      // distinguished from idle.
+      half_[halves_++] = false;
+    }
+
+    for (unsigned i = 0; i != count && halves_ != 2 * RC5_BITS; ++i) {
+      half_[halves_++] = mark;
+    }
+
+    if (halves_ == 2 * RC5_BITS - 1 && half_[halves_ - 1]) {
+      // The last half is a space if the last bit is 0 and merges with idle.
+      half_[halves_++] = false;
+    }
+
+    if (halves_ == 2 * RC5_BITS) {
+      Decode(tick);
+    }
+  }
+
+private:
+  void Restart() {
+    Reset();
+    halves_ = 0;
+  }
+
+  void Decode(uint32_t tick) {
+    unsigned bits = 0;
+
+    halves_ = 0;
+
+    for (unsigned i = 0; i != RC5_BITS; ++i) {
+      bool first = half_[2 * i];
+      bool second = half_[2 * i + 1];
+
+      if (first == second) {
+        Reset();
+        return;
+      }
+
+      bits = (bits << 1) | (second ? 1 : 0);
+    }
+
+    Reset();
+
+    frame_.data[0] = (bits >> 6) & 0x1f;
+    frame_.data[1] = (bits & 0x3f) | ((~bits >> 6) & 0x40);
+    frame_.data[2] = (bits >> 11) & 1;
+    frame_.bits = 24;
+
+    EmitFrame(tick);
+  }
+
+  bool activeLow_;
+  bool half_[2 * RC5_BITS];
+  unsigned halves_;
+};
+
+
+// DHT11/DHT22 style single wire sensors. A start signal, a low pulse of at
+// least 1ms on the data line, is followed by a response of 80us low and 80us
+// high and then 40 bits, each 50us low and either ~27us high (0) or ~70us
+// high (1). Frames are the 5 data bytes and are only emitted if the checksum
+// is correct.
+#define DHT_START_MIN 800
+#define DHT_BITS 40
+
+class DhtDecoder_t : public Decoder_t {
+public:
+  DhtDecoder_t(Nan::Callback *callback)
+    : Decoder_t(callback), falling_(-1) {
+  }
+
+protected:
+  void Period(unsigned ix, int level, uint32_t duration, uint32_t tick) {
+    if (level == 0) {
+      if (duration >= DHT_START_MIN) {
+        Reset();
+        falling_ = 0;
+      } else if (falling_ > 2) {
+        Measured(duration, 50);
+      }
+      return;
+    }
+
+    if (falling_ < 0) {
+      return;
+    }
+
+    falling_ += 1;
+
+    // The first two falling edges are the sensor pulling the line low after
+    // the start signal and the end of the response.
+    if (falling_ <= 2) {
+      return;
+    }
+
+    if (duration > 120) {
+      falling_ = -1;
+      return;
+    }
+
+    unsigned bit = duration > 48 ? 1 : 0;
+    Measured(duration, bit ? 70 : 27);
+    AppendBit(bit, true);
+
+    if (frame_.bits == DHT_BITS) {
+      falling_ = -1;
+
+      const uint8_t *d = frame_.data;
+      if (((d[0] + d[1] + d[2] + d[3]) & 0xff) == d[4]) {
+        EmitFrame(tick);
+      } else {
+        Reset();
+      }
+    }
+  }
+
+private:
+  int falling_;
+};
+
+
+// Wiegand card readers. A low pulse on D0 is a 0 bit and a low pulse on D1
+// is a 1 bit. The frame ends when no bits have been received for gap
+// milliseconds. The first bit of a frame wakes up the event loop thread
+// which polls for the end of the frame with the decoder timer, so the pigpio
+// watchdogs of D0 and D1 are left alone.
+class WiegandDecoder_t : public Decoder_t {
+public:
+  WiegandDecoder_t(unsigned gap, Nan::Callback *callback)
+    : Decoder_t(callback), gap_(gap), lastBitTick_(0) {
+    uv_mutex_init(&frameMutex_);
+  }
+
+  virtual ~WiegandDecoder_t() {
+    uv_mutex_destroy(&frameMutex_);
+  }
+
+protected:
+  void Period(unsigned ix, int level, uint32_t duration, uint32_t tick) {
+    if (level == 0 && duration < 1000) {
+      uv_mutex_lock(&frameMutex_);
+      AppendBit(ix, true);
+      lastBitTick_ = tick;
+      bool first = frame_.bits == 1;
+      uv_mutex_unlock(&frameMutex_);
+
+      if (first) {
+        Wakeup();
+      }
+    }
+  }
+
+  void Poll() {
+    uv_mutex_lock(&frameMutex_);
+
+    if (frame_.bits != 0) {
+      uint32_t elapsed = gpioTick() - lastBitTick_;
+
+      if (elapsed >= gap_ * 1000) {
+        EmitFrame(lastBitTick_);
+      } else {
+        PollAfter((gap_ * 1000 - elapsed + 999) / 1000);
+      }
+    }
+
+    uv_mutex_unlock(&frameMutex_);
+  }
+
+private:
+  unsigned gap_;
+
+  // frame_ and lastBitTick_ are protected by frameMutex_
+  uint32_t lastBitTick_;
+  uv_mutex_t frameMutex_;
+};
+
+
+#define MAX_DECODERS 32
+
+static Decoder_t *decoders_g[MAX_DECODERS];
+
+
+// decoderAsyncHandler is executed in the event loop thread.
+static void decoderAsyncHandler(uv_async_t* handle) {
+  ((Decoder_t *) handle->data)->Deliver();
+}
+
+
+// decoderTimerHandler is executed in the event loop thread.
+static void decoderTimerHandler(uv_timer_t* handle) {
+  ((Decoder_t *) handle->data)->Deliver();
+}
+
+
+static void decoderCloseHandler(uv_handle_t* handle) {
+  ((Decoder_t *) handle->data)->HandleClosed();
+}
+
+
+NAN_METHOD(decoderOpen) {
+  if (info.Length() < 4 ||
+      !info[0]->IsUint32() ||
+      !info[1]->IsArray() ||
+      !info[2]->IsArray() ||
+      !info[3]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderOpen", ""));
+  }
+
+  unsigned type = Nan::To<uint32_t>(info[0]).FromJust();
+  v8::Local<v8::Array> gpioArray = info[1].As<v8::Array>();
+  v8::Local<v8::Array> paramArray = info[2].As<v8::Array>();
+
+  unsigned gpios[2];
+  unsigned gpioCount = gpioArray->Length();
+  uint32_t params[PULSE_PARAMS];
+  unsigned paramCount = paramArray->Length();
+
+  if (gpioCount != (type == DECODER_WIEGAND ? 2 : 1) ||
+      paramCount > PULSE_PARAMS) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderOpen", ""));
+  }
+
+  for (unsigned i = 0; i != gpioCount; ++i) {
+    v8::Local<v8::Value> gpio = Nan::Get(gpioArray, i).ToLocalChecked();
+    if (!gpio->IsUint32()) {
+      return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderOpen", ""));
+    }
+
+    gpios[i] = Nan::To<uint32_t>(gpio).FromJust();
+    if (gpios[i] > PI_MAX_USER_GPIO) {
+      return ThrowPigpioError(PI_BAD_USER_GPIO, "decoderOpen");
+    }
+  }
+
+  for (unsigned i = 0; i != PULSE_PARAMS; ++i) {
+    params[i] = 0;
+
+    if (i < paramCount) {
+      v8::Local<v8::Value> param = Nan::Get(paramArray, i).ToLocalChecked();
+      if (!param->IsUint32()) {
+        return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderOpen", ""));
+      }
+
+      params[i] = Nan::To<uint32_t>(param).FromJust();
+    }
+  }
+
+  unsigned handle = 0;
+  while (handle != MAX_DECODERS && decoders_g[handle] != 0) {
+    handle += 1;
+  }
+
+  if (handle == MAX_DECODERS) {
+    return Nan::ThrowError(Nan::ErrnoException(EMFILE, "decoderOpen", ""));
+  }
+
+  Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+  Decoder_t *decoder;
+
+  switch (type) {
+    case DECODER_PULSE:
+      if (params[PULSE_BITS] == 0 || params[PULSE_BITS] > MAX_FRAME_BITS) {
+        delete callback;
+        return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderOpen", ""));
+      }
+      decoder = new PulseDecoder_t(params, callback);
+      break;
+    case DECODER_RC5:
+      decoder = new Rc5Decoder_t(params[0] != 0, callback);
+      break;
+    case DECODER_DHT:
+      decoder = new DhtDecoder_t(callback);
+      break;
+    case DECODER_WIEGAND:
+      decoder = new WiegandDecoder_t(params[0], callback);
+      break;
+    default:
+      delete callback;
+      return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderOpen", ""));
+  }
+
+  int rc = 0;
+
+  for (unsigned i = 0; i != gpioCount; ++i) {
+    decoder->AddGpio(gpios[i]);
+
+    if (rc >= 0) {
+      rc = addAlertListener(gpios[i], decoder);
+    }
+  }
+
+  if (rc < 0) {
+    for (unsigned i = 0; i != gpioCount; ++i) {
+      removeAlertListener(gpios[i], decoder);
+    }
+    decoder->Close();
+    return ThrowPigpioError(rc, "decoderOpen");
+  }
+
+  decoders_g[handle] = decoder;
+
+  info.GetReturnValue().Set(handle);
+}
+
+
+NAN_METHOD(decoderClose) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderClose", ""));
+  }
+
+  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+
+  if (handle >= MAX_DECODERS || decoders_g[handle] == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "decoderClose", ""));
+  }
+
+  Decoder_t *decoder = decoders_g[handle];
+  decoders_g[handle] = 0;
+
+  for (unsigned i = 0; i != decoder->GpioCount(); ++i) {
+    removeAlertListener(decoder->Gpio(i), decoder);
+  }
+
+  decoder->Close();
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Edge trigger                                                             */
+/* ------------------------------------------------------------------------ */
+
+
+static void edgeTriggerAsyncHandler(uv_async_t* handle);
+static void edgeTriggerCloseHandler(uv_handle_t* handle);
+
+
+// An EdgeTrigger_t evaluates a trigger expression against each edge on the
+// GPIOs that the expression refers to. The expression is compiled to a
+// program for a small stack machine in JavaScript and validated once when
+// the trigger is opened. The program is evaluated on the pigpio thread so
+// only matching edges, optionally surrounded by a window of the edges
+// preceding and following them, are passed on to JavaScript.
+//
+// Each edge in a window is three 32 bit words, the low and high 32 bits of
+// the extended tick and the GPIO | level << 8.
+
+// The order of the opcodes must match EDGE_TRIGGER_OP in pigpio.js.
+enum {
+  EDGE_TRIGGER_OP_RISING = 0,   // gpio: push the edge is a rising edge on gpio
+  EDGE_TRIGGER_OP_FALLING = 1,  // gpio: push the edge is a falling edge on gpio
+  EDGE_TRIGGER_OP_EDGE = 2,     // gpio: push the edge is an edge on gpio
+  EDGE_TRIGGER_OP_HIGH = 3,     // gpio: push gpio is high
+  EDGE_TRIGGER_OP_LOW = 4,      // gpio: push gpio is low
+  EDGE_TRIGGER_OP_QUIET = 5,    // gpio, us: push no prior edge on gpio for us
+  EDGE_TRIGGER_OP_NOT = 6,
+  EDGE_TRIGGER_OP_AND = 7,
+  EDGE_TRIGGER_OP_OR = 8,
+  EDGE_TRIGGER_OP_COUNT = 9
+};
+
+#define EDGE_TRIGGER_MAX_PROGRAM 1024
+#define EDGE_TRIGGER_MAX_STACK 32
+#define EDGE_TRIGGER_MAX_WINDOW 4096
+#define EDGE_TRIGGER_MAX_PENDING 256
+#define EDGE_TRIGGER_RECORD_WORDS 3
+
+// The number of operand words that follow each opcode.
+static const unsigned edgeTriggerOperands_g[EDGE_TRIGGER_OP_COUNT] = {
+  1, 1, 1, 1, 1, 2, 0, 0, 0
+};
+
+
+struct EdgeTriggerWindow_t {
+  std::vector<uint32_t> records;
+  uint32_t triggerIndex;
+};
+
+
+class EdgeTrigger_t : public AlertListener_t {
+public:
+  EdgeTrigger_t(
+    const std::vector<uint32_t> &program,
+    uint32_t gpioMask,
+    unsigned pre,
+    unsigned post,
+    Nan::Callback *callback
+  ) : program_(program),
+      gpioMask_(gpioMask),
+      pre_(pre),
+      post_(post),
+      levels_(0),
+      seen_(0),
+      history_(pre * EDGE_TRIGGER_RECORD_WORDS),
+      historyCount_(0),
+      historyNext_(0),
+      postRemaining_(0),
+      matches_(0),
+      dropped_(0),
+      callback_(callback),
+      async_resource_(new Nan::AsyncResource("pigpio:edgetrigger")) {
+    uv_mutex_init(&mutex_);
+
+    uv_async_init(uv_default_loop(), &async_, edgeTriggerAsyncHandler);
+    async_.data = this;
+  }
+
+  virtual ~EdgeTrigger_t() {
+    uv_mutex_destroy(&mutex_);
+    delete callback_;
+    delete async_resource_;
+  }
+
+  // A valid program only refers to user GPIOs, never pops an empty stack,
+  // never exceeds the maximum stack depth and leaves exactly one value on
+  // the stack. The GPIOs that the program refers to are returned in
+  // gpioMask.
+  static bool Validate(const std::vector<uint32_t> &program, uint32_t *gpioMask) {
+    unsigned depth = 0;
+    uint32_t mask = 0;
+
+    for (size_t pc = 0; pc < program.size(); ) {
+      uint32_t op = program[pc];
+
+      if (op >= EDGE_TRIGGER_OP_COUNT ||
+          pc + edgeTriggerOperands_g[op] >= program.size()) {
+        return false;
+      }
+
+      if (op <= EDGE_TRIGGER_OP_QUIET) {
+        if (program[pc + 1] > PI_MAX_USER_GPIO ||
+            depth == EDGE_TRIGGER_MAX_STACK) {
+          return false;
+        }
+
+        mask |= 1u << program[pc + 1];
+        depth += 1;
+      } else if (op == EDGE_TRIGGER_OP_NOT) {
+        if (depth < 1) {
+          return false;
+        }
+      } else {
+        if (depth < 2) {
+          return false;
+        }
+
+        depth -= 1;
+      }
+
+      pc += 1 + edgeTriggerOperands_g[op];
+    }
+
+    *gpioMask = mask;
+
+    return depth == 1;
+  }
+
+  void Start() {
+    uv_mutex_lock(&mutex_);
+    levels_ = gpioRead_Bits_0_31();
+    uv_mutex_unlock(&mutex_);
+  }
+
+  // Alert is not executed in the event loop thread
+  void Alert(int gpio, int level, uint32_t tick) {
+    if (level == PI_TIMEOUT) {
+      return;
+    }
+
+    uint32_t bit = 1u << gpio;
+    uint64_t tick64 = extendTick(tick);
+    bool wakeup = false;
+
+    uv_mutex_lock(&mutex_);
+
+    levels_ = level ? levels_ | bit : levels_ & ~bit;
+
+    if (postRemaining_ != 0) {
+      // Edges following a match belong to its window and aren't evaluated.
+      Append(current_.records, gpio, level, tick64);
+
+      if (--postRemaining_ == 0) {
+        wakeup = Complete();
+      }
+    } else if (Evaluate(gpio, level, tick)) {
+      matches_ += 1;
+
+      current_.records.clear();
+      current_.triggerIndex = historyCount_;
+
+      for (unsigned i = 0; i != historyCount_; ++i) {
+        unsigned slot = (historyNext_ + pre_ - historyCount_ + i) % pre_;
+        const uint32_t *record = &history_[slot * EDGE_TRIGGER_RECORD_WORDS];
+        current_.records.insert(
+          current_.records.end(), record, record + EDGE_TRIGGER_RECORD_WORDS
+        );
+      }
+
+      Append(current_.records, gpio, level, tick64);
+
+      if (post_ == 0) {
+        wakeup = Complete();
+      } else {
+        postRemaining_ = post_;
+      }
+    }
+
+    lastEdge_[gpio] = tick;
+    seen_ |= bit;
+
+    if (pre_ != 0) {
+      uint32_t *record = &history_[historyNext_ * EDGE_TRIGGER_RECORD_WORDS];
+      record[0] = (uint32_t) tick64;
+      record[1] = (uint32_t) (tick64 >> 32);
+      record[2] = gpio | level << 8;
+      historyNext_ = (historyNext_ + 1) % pre_;
+      if (historyCount_ < pre_) {
+        historyCount_ += 1;
+      }
+    }
+
+    uv_mutex_unlock(&mutex_);
+
+    if (wakeup) {
+      uv_async_send(&async_);
+    }
+  }
+
+  // Deliver is executed in the event loop thread
+  void Deliver() {
+    Nan::HandleScope scope;
+
+    std::vector<EdgeTriggerWindow_t> windows;
+
+    uv_mutex_lock(&mutex_);
+    windows.swap(pending_);
+    uint32_t matches = matches_;
+    uint32_t dropped = dropped_;
+    uv_mutex_unlock(&mutex_);
+
+    for (size_t i = 0; i != windows.size(); ++i) {
+      const std::vector<uint32_t> &records = windows[i].records;
+      size_t size = records.size() * sizeof(uint32_t);
+
+      v8::Local<v8::Object> buffer =
+        Nan::CopyBuffer((const char *) &records[0], size).ToLocalChecked();
+
+      v8::Local<v8::Value> args[4] = {
+        buffer,
+        Nan::New<v8::Uint32>(windows[i].triggerIndex),
+        Nan::New<v8::Uint32>(matches),
+        Nan::New<v8::Uint32>(dropped)
+      };
+
+      callback_->Call(4, args, async_resource_);
+    }
+  }
+
+  // The EdgeTrigger_t deletes itself once its libuv handle is closed.
+  void Close() {
+    uv_close((uv_handle_t *) &async_, edgeTriggerCloseHandler);
+  }
+
+  uint32_t GpioMask() { return gpioMask_; }
+
+private:
+  static void Append(
+    std::vector<uint32_t> &records, int gpio, int level, uint64_t tick64
+  ) {
+    records.push_back((uint32_t) tick64);
+    records.push_back((uint32_t) (tick64 >> 32));
+    records.push_back(gpio | level << 8);
+  }
+
+  // Moves the current window to the pending windows. Returns true if the
+  // event loop needs to be woken up. Called with mutex_ locked.
+  bool Complete() {
+    if (pending_.size() == EDGE_TRIGGER_MAX_PENDING) {
+      dropped_ += 1;
+      return false;
+    }
+
+    pending_.push_back(current_);
+
+    return pending_.size() == 1;
+  }
+
+  // Evaluates the program for an edge. levels_ already reflects the edge,
+  // lastEdge_ and seen_ don't. Called with mutex_ locked.
+  bool Evaluate(int gpio, int level, uint32_t tick) {
+    bool stack[EDGE_TRIGGER_MAX_STACK];
+    unsigned sp = 0;
+    const uint32_t *program = &program_[0];
+    size_t size = program_.size();
+
+    for (size_t pc = 0; pc < size; ) {
+      uint32_t op = program[pc];
+      uint32_t g = op <= EDGE_TRIGGER_OP_QUIET ? program[pc + 1] : 0;
+
+      switch (op) {
+        case EDGE_TRIGGER_OP_RISING:
+          stack[sp++] = (unsigned) gpio == g && level == 1;
+          break;
+        case EDGE_TRIGGER_OP_FALLING:
+          stack[sp++] = (unsigned) gpio == g && level == 0;
+          break;
+        case EDGE_TRIGGER_OP_EDGE:
+          stack[sp++] = (unsigned) gpio == g;
+          break;
+        case EDGE_TRIGGER_OP_HIGH:
+          stack[sp++] = ((levels_ >> g) & 1) == 1;
+          break;
+        case EDGE_TRIGGER_OP_LOW:
+          stack[sp++] = ((levels_ >> g) & 1) == 0;
+          break;
+        case EDGE_TRIGGER_OP_QUIET:
+          stack[sp++] = (seen_ & (1u << g)) == 0 ||
+            tick - lastEdge_[g] >= program[pc + 2];
+          break;
+        case EDGE_TRIGGER_OP_NOT:
+          stack[sp - 1] = !stack[sp - 1];
+          break;
+        case EDGE_TRIGGER_OP_AND:
+          sp -= 1;
+          stack[sp - 1] = stack[sp - 1] && stack[sp];
+          break;
+        case EDGE_TRIGGER_OP_OR:
+          sp -= 1;
+          stack[sp - 1] = stack[sp - 1] || stack[sp];
+          break;
+      }
+
+      pc += 1 + edgeTriggerOperands_g[op];
+    }
+
+    return stack[0];
+  }
+
+  const std::vector<uint32_t> program_;
+  const uint32_t gpioMask_;
+  const unsigned pre_;
+  const unsigned post_;
+
+  // Accessed on the pigpio thread, protected by mutex_
+  uint32_t levels_;
+  uint32_t seen_;
+  uint32_t lastEdge_[PI_MAX_USER_GPIO + 1];
+  std::vector<uint32_t> history_;
+  unsigned historyCount_;
+  unsigned historyNext_;
+  EdgeTriggerWindow_t current_;
+  unsigned postRemaining_;
+  std::vector<EdgeTriggerWindow_t> pending_;
+  uint32_t matches_;
+  uint32_t dropped_;
+
+  uv_mutex_t mutex_;
+  uv_async_t async_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+#define MAX_EDGE_TRIGGERS 16
+
+static EdgeTrigger_t *edgeTriggers_g[MAX_EDGE_TRIGGERS];
+
+
+// edgeTriggerAsyncHandler is executed in the event loop thread.
+static void edgeTriggerAsyncHandler(uv_async_t* handle) {
+  ((EdgeTrigger_t *) handle->data)->Deliver();
+}
+
+
+static void edgeTriggerCloseHandler(uv_handle_t* handle) {
+  delete (EdgeTrigger_t *) handle->data;
+}
+
+
+static void removeEdgeTriggerListeners(EdgeTrigger_t *trigger) {
+  for (unsigned gpio = 0; gpio <= PI_MAX_USER_GPIO; ++gpio) {
+    if (trigger->GpioMask() & (1u << gpio)) {
+      removeAlertListener(gpio, trigger);
+    }
+  }
+}
+
+
+// edgeTriggerOpen(program, pre, post, callback)
+NAN_METHOD(edgeTriggerOpen) {
+  if (info.Length() < 4 ||
+      !info[0]->IsUint32Array() ||
+      !info[1]->IsUint32() ||
+      !info[2]->IsUint32() ||
+      !info[3]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "edgeTriggerOpen", ""));
+  }
+
+  Nan::TypedArrayContents<uint32_t> contents(info[0]);
+  unsigned pre = Nan::To<uint32_t>(info[1]).FromJust();
+  unsigned post = Nan::To<uint32_t>(info[2]).FromJust();
+
+  std::vector<uint32_t> program(*contents, *contents + contents.length());
+  uint32_t gpioMask = 0;
+
+  if (program.empty() ||
+      program.size() > EDGE_TRIGGER_MAX_PROGRAM ||
+      pre > EDGE_TRIGGER_MAX_WINDOW ||
+      post > EDGE_TRIGGER_MAX_WINDOW ||
+      pre + post > EDGE_TRIGGER_MAX_WINDOW ||
+      !EdgeTrigger_t::Validate(program, &gpioMask)) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "edgeTriggerOpen", ""));
+  }
+
+  unsigned handle = 0;
+  while (handle != MAX_EDGE_TRIGGERS && edgeTriggers_g[handle] != 0) {
+    handle += 1;
+  }
+
+  if (handle == MAX_EDGE_TRIGGERS) {
+    return Nan::ThrowError(Nan::ErrnoException(EMFILE, "edgeTriggerOpen", ""));
+  }
+
+  EdgeTrigger_t *trigger = new EdgeTrigger_t(
+    program,
+    gpioMask,
+    pre,
+    post,
+    new Nan::Callback(info[3].As<v8::Function>())
+  );
+
+  trigger->Start();
+
+  int rc = 0;
+  for (unsigned gpio = 0; gpio <= PI_MAX_USER_GPIO && rc >= 0; ++gpio) {
+    if (gpioMask & (1u << gpio)) {
+      rc = addAlertListener(gpio, trigger);
+    }
+  }
+
+  if (rc < 0) {
+    removeEdgeTriggerListeners(trigger);
+    trigger->Close();
+    return ThrowPigpioError(rc, "edgeTriggerOpen");
+  }
+
+  edgeTriggers_g[handle] = trigger;
+
+  info.GetReturnValue().Set(handle);
+}
+
+
+NAN_METHOD(edgeTriggerClose) {
+  if (info.Length() < 1 || !info[0]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "edgeTriggerClose", ""));
+  }
+
+  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+
+  if (handle >= MAX_EDGE_TRIGGERS || edgeTriggers_g[handle] == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "edgeTriggerClose", ""));
+  }
+
+  EdgeTrigger_t *trigger = edgeTriggers_g[handle];
+  edgeTriggers_g[handle] = 0;
+
+  removeEdgeTriggerListeners(trigger);
+
+  trigger->Close();
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Capture                                                                  */
+/* ------------------------------------------------------------------------ */
+
+
+static void captureAsyncHandler(uv_async_t* handle);
+static void captureCloseHandler(uv_handle_t* handle);
+static void captureThread(void *arg);
+
+
+// A Capture_t samples the levels of a set of GPIOs at a fixed rate on its
+// own thread. Samples are run-length encoded: a record is written whenever
+// the sampled levels change. Each record is three 32 bit words, the levels
+// of GPIOs 0-31, the levels of GPIOs 32-53 and the time in microseconds for
+// which the levels were held.
+//
+// Records are written to a preallocated ring. If a chunk size is specified
+// full chunks of records are passed to JavaScript as they become available.
+// The records that remain when the capture ends, all of them if no chunk
+// size is specified, are passed to JavaScript with the end event. The
+// capture ends early if the ring is full.
+
+#define CAPTURE_RECORD_WORDS 3
+#define CAPTURE_SLEEP_THRESHOLD 200
+
+#define CAPTURE_EVENT_DATA 0
+#define CAPTURE_EVENT_END 1
+
+class Capture_t {
+public:
+  Capture_t(
+    uint32_t mask_0_31,
+    uint32_t mask_32_53,
+    uint32_t interval,
+    uint32_t duration,
+    uint32_t triggerMask,
+    uint32_t triggerLevels,
+    uint32_t triggerTimeout,
+    uint32_t capacity,
+    uint32_t chunk,
+    Nan::Callback *callback
+  ) : mask_0_31_(mask_0_31),
+      mask_32_53_(mask_32_53),
+      interval_(interval),
+      duration_(duration),
+      triggerMask_(triggerMask),
+      triggerLevels_(triggerLevels),
+      triggerTimeout_(triggerTimeout),
+      capacity_(capacity),
+      chunk_(chunk),
+      records_(capacity * CAPTURE_RECORD_WORDS),
+      head_(0),
+      tail_(0),
+      stop_(false),
+      done_(false),
+      wakeupPending_(false),
+      startTick_(0),
+      samples_(0),
+      triggered_(false),
+      truncated_(false),
+      joined_(false),
+      callback_(callback),
+      async_resource_(new Nan::AsyncResource("pigpio:capture")) {
+    uv_mutex_init(&mutex_);
+
+    uv_async_init(uv_default_loop(), &async_, captureAsyncHandler);
+    async_.data = this;
+  }
+
+  virtual ~Capture_t() {
+    uv_mutex_destroy(&mutex_);
+    delete callback_;
+    delete async_resource_;
+  }
+
+  void Start() {
+    uv_thread_create(&thread_, captureThread, this);
+  }
+
+  void Stop() {
+    uv_mutex_lock(&mutex_);
+    stop_ = true;
+    uv_mutex_unlock(&mutex_);
+  }
+
+  // Run is not executed in the event loop thread.
+  void Run() {
+    triggered_ = Trigger();
+
+    if (triggered_) {
+      Sample();
+    }
+
+    uv_mutex_lock(&mutex_);
+    done_ = true;
+    uv_mutex_unlock(&mutex_);
+
+    uv_async_send(&async_);
+  }
+
+  // Deliver is executed in the event loop thread.
+  void Deliver() {
+    Nan::HandleScope scope;
+
+    uv_mutex_lock(&mutex_);
+    uint32_t head = head_;
+    uint32_t tail = tail_;
+    bool done = done_;
+    wakeupPending_ = false;
+    uv_mutex_unlock(&mutex_);
+
+    if (chunk_ != 0) {
+      for (; tail - head >= chunk_; head += chunk_) {
+        v8::Local<v8::Value> args[2] = {
+          Nan::New<v8::Integer>(CAPTURE_EVENT_DATA),
+          TakeRecords(head, head + chunk_)
+        };
+
+        callback_->Call(2, args, async_resource_);
+      }
+    }
+
+    if (done) {
+      Join();
+
+      uint64_t startTick64 = extendTick(startTick_);
+
+      v8::Local<v8::Value> args[8] = {
+        Nan::New<v8::Integer>(CAPTURE_EVENT_END),
+        Nan::New<v8::Uint32>(startTick_),
+        Nan::New<v8::Uint32>((uint32_t) (startTick64 >> 32)),
+        Nan::New<v8::Number>((double) samples_),
+        Nan::New<v8::Boolean>(triggered_),
+        Nan::New<v8::Boolean>(truncated_),
+        Nan::New<v8::Uint32>(interval_),
+        TakeRecords(head, tail)
+      };
+
+      callback_->Call(8, args, async_resource_);
+    }
+  }
+
+  // The Capture_t deletes itself once its libuv handle is closed.
+  void Close() {
+    Stop();
+    Join();
+    uv_close((uv_handle_t *) &async_, captureCloseHandler);
+  }
+
+private:
+  void Join() {
+    if (!joined_) {
+      uv_thread_join(&thread_);
+      joined_ = true;
+    }
+  }
+
+  bool Stopped() {
+    uv_mutex_lock(&mutex_);
+    bool stop = stop_;
+    uv_mutex_unlock(&mutex_);
+
+    return stop;
+  }
+
+  // Waits until the trigger condition is met. The levels are polled at the
+  // sample interval. Returns false if the capture was stopped or the trigger
+  // timed out.
+  bool Trigger() {
+    if (triggerMask_ == 0) {
+      return true;
+    }
+
+    uint32_t start = gpioTick();
+    uint32_t next = start;
+
+    while (true) {
+      if ((gpioRead_Bits_0_31() & triggerMask_) == triggerLevels_) {
+        return true;
+      }
+
+      if (Stopped()) {
+        return false;
+      }
+
+      uint32_t tick = gpioTick();
+
+      if (triggerTimeout_ != 0 && tick - start >= triggerTimeout_) {
+        return false;
+      }
+
+      next += interval_;
+      if ((int32_t) (tick - next) > (int32_t) interval_) {
+        next = tick;
+      }
+
+      Pace(next);
+    }
+  }
+
+  // Waits until tick next. Long waits sleep, the rest of the wait polls the
+  // tick for accuracy.
+  void Pace(uint32_t next) {
+    int32_t wait = (int32_t) (next - gpioTick());
+
+    while (wait > 0) {
+      if (wait > CAPTURE_SLEEP_THRESHOLD) {
+        usleep(wait - CAPTURE_SLEEP_THRESHOLD / 2);
+      }
+
+      wait = (int32_t) (next - gpioTick());
+    }
+  }
+
+  void Sample() {
+    uint32_t tick = gpioTick();
+    uint32_t next = tick;
+    uint32_t runTick = tick;
+    uint32_t runLevels_0_31 = 0;
+    uint32_t runLevels_32_53 = 0;
+
+    startTick_ = tick;
+
+    while (true) {
+      Pace(next);
+      tick = gpioTick();
+
+      uint32_t levels_0_31 = gpioRead_Bits_0_31() & mask_0_31_;
+      uint32_t levels_32_53 =
+        mask_32_53_ == 0 ? 0 : gpioRead_Bits_32_53() & mask_32_53_;
+
+      if (samples_ == 0) {
+        runLevels_0_31 = levels_0_31;
+        runLevels_32_53 = levels_32_53;
+      } else if (levels_0_31 != runLevels_0_31 ||
+          levels_32_53 != runLevels_32_53) {
+        if (!Append(runLevels_0_31, runLevels_32_53, tick - runTick)) {
+          truncated_ = true;
+          return;
+        }
+
+        runLevels_0_31 = levels_0_31;
+        runLevels_32_53 = levels_32_53;
+        runTick = tick;
+      }
+
+      samples_ += 1;
+
+      if (tick - startTick_ >= duration_ || ((samples_ & 1023) == 0 && Stopped())) {
+        break;
+      }
+
+      // If sampling fell behind, for example because the thread was
+      // preempted, continue at the current time rather than catching up
+      // with a burst of samples.
+      next += interval_;
+      tick = gpioTick();
+      if ((int32_t) (tick - next) > (int32_t) interval_) {
+        next = tick;
+      }
+    }
+
+    if (!Append(runLevels_0_31, runLevels_32_53, tick - runTick + interval_)) {
+      truncated_ = true;
+    }
+  }
+
+  bool Append(uint32_t levels_0_31, uint32_t levels_32_53, uint32_t duration) {
+    uv_mutex_lock(&mutex_);
+
+    if (tail_ - head_ == capacity_) {
+      uv_mutex_unlock(&mutex_);
+      return false;
+    }
+
+    uint32_t *record = &records_[(tail_ % capacity_) * CAPTURE_RECORD_WORDS];
+    record[0] = levels_0_31;
+    record[1] = levels_32_53;
+    record[2] = duration;
+    tail_ += 1;
+
+    // The event loop may not have taken the previous chunk yet so more than
+    // a chunk can be waiting. Wake it up once until it has run.
+    bool wakeup = chunk_ != 0 && tail_ - head_ >= chunk_ && !wakeupPending_;
+    if (wakeup) {
+      wakeupPending_ = true;
+    }
+
+    uv_mutex_unlock(&mutex_);
+
+    if (wakeup) {
+      uv_async_send(&async_);
+    }
+
+    return true;
+  }
+
+  // Copies the records between head and tail to a Buffer and frees them in
+  // the ring. The records aren't modified by the capture thread until head_
+  // is advanced.
+  v8::Local<v8::Object> TakeRecords(uint32_t head, uint32_t tail) {
+    uint32_t count = tail - head;
+    size_t recordSize = CAPTURE_RECORD_WORDS * sizeof(uint32_t);
+    v8::Local<v8::Object> buffer =
+      Nan::NewBuffer(count * recordSize).ToLocalChecked();
+    char *data = node::Buffer::Data(buffer);
+
+    uint32_t first = head % capacity_;
+    uint32_t firstCount = count < capacity_ - first ? count : capacity_ - first;
+
+    memcpy(
+      data,
+      &records_[first * CAPTURE_RECORD_WORDS],
+      firstCount * recordSize
+    );
+    memcpy(
+      data + firstCount * recordSize,
+      &records_[0],
+      (count - firstCount) * recordSize
+    );
+
+    uv_mutex_lock(&mutex_);
+    head_ = tail;
+    uv_mutex_unlock(&mutex_);
+
+    return buffer;
+  }
+
+  uint32_t mask_0_31_;
+  uint32_t mask_32_53_;
+  uint32_t interval_;
+  uint32_t duration_;
+  uint32_t triggerMask_;
+  uint32_t triggerLevels_;
+  uint32_t triggerTimeout_;
+  uint32_t capacity_;
+  uint32_t chunk_;
+
+  // The ring of records, head_, tail_ and the flags are protected by mutex_
+  std::vector<uint32_t> records_;
+  uint32_t head_;
+  uint32_t tail_;
+  bool stop_;
+  bool done_;
+  bool wakeupPending_;
+
+  // Only accessed by the capture thread until done_ is set
+  uint32_t startTick_;
+  uint64_t samples_;
+  bool triggered_;
+  bool truncated_;
+
+  uv_thread_t thread_;
+  bool joined_;
+  uv_mutex_t mutex_;
+  uv_async_t async_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+#define MAX_CAPTURES 4
+
+static Capture_t *captures_g[MAX_CAPTURES];
+
+
+// captureThread is not executed in the event loop thread.
+static void captureThread(void *arg) {
+  ((Capture_t *) arg)->Run();
+}
+
+
+// captureAsyncHandler is executed in the event loop thread.
+static void captureAsyncHandler(uv_async_t* handle) {
+  ((Capture_t *) handle->data)->Deliver();
+}
+
+
+static void captureCloseHandler(uv_handle_t* handle) {
+  delete (Capture_t *) handle->data;
+}
+
+
+static Capture_t *getCapture(v8::Local<v8::Value> value) {
+  if (!value->IsUint32()) {
+    return 0;
+  }
+
+  unsigned handle = Nan::To<uint32_t>(value).FromJust();
+  if (handle >= MAX_CAPTURES) {
+    return 0;
+  }
+
+  return captures_g[handle];
+}
+
+
+// captureStart(mask_0_31, mask_32_53, interval, duration, triggerMask,
+//   triggerLevels, triggerTimeout, capacity, chunk, callback)
+NAN_METHOD(captureStart) {
+  if (info.Length() < 10 || !info[9]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "captureStart", ""));
+  }
+
+  uint32_t args[9];
+
+  for (int i = 0; i != 9; ++i) {
+    if (!info[i]->IsUint32()) {
+      return Nan::ThrowError(Nan::ErrnoException(EINVAL, "captureStart", ""));
+    }
+
+    args[i] = Nan::To<uint32_t>(info[i]).FromJust();
+  }
+
+  if ((args[0] == 0 && args[1] == 0) ||
+      args[2] == 0 ||
+      (args[5] & ~args[4]) != 0 ||
+      args[7] == 0 ||
+      args[8] > args[7]) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "captureStart", ""));
+  }
+
+  unsigned handle = 0;
+  while (handle != MAX_CAPTURES && captures_g[handle] != 0) {
+    handle += 1;
+  }
+
+  if (handle == MAX_CAPTURES) {
+    return Nan::ThrowError(Nan::ErrnoException(EMFILE, "captureStart", ""));
+  }
+
+  Capture_t *capture = new Capture_t(
+    args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7],
+    args[8], new Nan::Callback(info[9].As<v8::Function>())
+  );
+
+  captures_g[handle] = capture;
+  capture->Start();
+
+  info.GetReturnValue().Set(handle);
+}
+
+
+// Asks the capture to stop. The end event is still delivered.
+NAN_METHOD(captureStop) {
+  Capture_t *capture = getCapture(info[0]);
+  if (capture == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "captureStop", ""));
+  }
+
+  capture->Stop();
+}
+
+
+// Releases a capture after its end event has been delivered.
+NAN_METHOD(captureClose) {
+  Capture_t *capture = getCapture(info[0]);
+  if (capture == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "captureClose", ""));
+  }
+
+  captures_g[Nan::To<uint32_t>(info[0]).FromJust()] = 0;
+
+  capture->Stop();
+  capture->Close();
+}
+
+
+/* ------------------------------------------------------------------------ */
+/* Broker                                                                   */
+/* ------------------------------------------------------------------------ */
+
+
+static void brokerClientAsyncHandler(uv_async_t* handle);
+static void brokerClientCloseHandler(uv_handle_t* handle);
+static void brokerClientThread(void *arg);
+
+
+// The broker publishes the alerts of the process that owns the pigpio C
+// library to other processes through a POSIX shared memory object. The
+// object starts with a BrokerHeader_t followed by a ring of capacity records.
+// A record is four 32 bit words: its sequence number, the tick, the high
+// 32 bits of the 64 bit tick and gpio | level << 8. Sequence numbers start
+// at 1 and skip 0 when they wrap around so a sequence number of 0 marks a
+// record that is being written. A record is stored at index
+// (sequence - 1) & (capacity - 1) so one index is skipped on wrap around
+// and a reader may report a record published at that time as lost.
+//
+// There is a single writer, the alert listener, and any number of readers.
+// Readers never write to the ring. They detect records overwritten before
+// they could be read with the sequence numbers and wait for new records on
+// the sequence word of the header with a futex. The writer only calls
+// futex wake if a reader is waiting.
+
+#define BROKER_MAGIC 0x52424750 // "PGBR"
+#define BROKER_VERSION 1
+#define BROKER_RECORD_WORDS 4
+#define BROKER_WAIT_NS 100000000
+
+#define BROKER_EVENT_DATA 0
+#define BROKER_EVENT_END 1
+
+struct BrokerHeader_t {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t capacity;
+  uint32_t bits;
+  uint32_t sequence;
+  uint32_t waiters;
+  uint32_t closed;
+  uint32_t reserved[9];
+};
+
+
+static size_t brokerSize(uint32_t capacity) {
+  return sizeof(BrokerHeader_t) +
+    (size_t) capacity * BROKER_RECORD_WORDS * sizeof(uint32_t);
+}
+
+
+static uint32_t brokerNextSequence(uint32_t sequence) {
+  return sequence == UINT32_MAX ? 1 : sequence + 1;
+}
+
+
+// The number of records published after from up to and including to.
+static uint32_t brokerDistance(uint32_t from, uint32_t to) {
+  return to < from ? to - from - 1 : to - from;
+}
+
+
+// The sequence number count records before sequence.
+static uint32_t brokerPreviousSequence(uint32_t sequence, uint32_t count) {
+  return count < sequence ? sequence - count : sequence - count - 1;
+}
+
+
+static void brokerWake(BrokerHeader_t *header) {
+  syscall(SYS_futex, &header->sequence, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+}
+
+
+class Broker_t : public AlertListener_t {
+public:
+  Broker_t(BrokerHeader_t *header, const char *name)
+    : header_(header),
+      records_((uint32_t *) (header + 1)),
+      mask_(header->capacity - 1),
+      name_(name) {
+  }
+
+  // Alert is not executed in the event loop thread. It's called with
+  // alertListenersMutex_g locked so there is a single writer.
+  void Alert(int gpio, int level, uint32_t tick) {
+    uint32_t sequence = brokerNextSequence(
+      __atomic_load_n(&header_->sequence, __ATOMIC_RELAXED)
+    );
+    uint32_t *record = &records_[((sequence - 1) & mask_) * BROKER_RECORD_WORDS];
+
+    __atomic_store_n(&record[0], 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&record[1], tick, __ATOMIC_RELAXED);
+    __atomic_store_n(&record[2], (uint32_t) (extendTick(tick) >> 32), __ATOMIC_RELAXED);
+    __atomic_store_n(&record[3], (uint32_t) (gpio | level << 8), __ATOMIC_RELAXED);
+    __atomic_store_n(&record[0], sequence, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&header_->sequence, sequence, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&header_->waiters, __ATOMIC_SEQ_CST) != 0) {
+      brokerWake(header_);
+    }
+  }
+
+  uint32_t Sequence() {
+    return __atomic_load_n(&header_->sequence, __ATOMIC_ACQUIRE);
+  }
+
+  uint32_t Bits() { return header_->bits; }
+
+  // Must be called after the broker has been removed as alert listener.
+  void Close() {
+    __atomic_store_n(&header_->closed, 1, __ATOMIC_SEQ_CST);
+    brokerWake(header_);
+
+    munmap(header_, brokerSize(header_->capacity));
+    shm_unlink(name_.c_str());
+  }
+
+private:
+  BrokerHeader_t *header_;
+  uint32_t *records_;
+  uint32_t mask_;
+  std::string name_;
+};
+
+
+static Broker_t *broker_g = 0;
+
+
+static void brokerRemoveListeners(Broker_t *broker) {
+  for (unsigned gpio = 0; gpio <= PI_MAX_USER_GPIO; ++gpio) {
+    if (broker->Bits() & (1u << gpio)) {
+      removeAlertListener(gpio, broker);
+    }
+  }
+}
+
+
+// brokerOpen(name, bits, capacity, mode)
+NAN_METHOD(brokerOpen) {
+  if (info.Length() < 4 ||
+      !info[0]->IsString() ||
+      !info[1]->IsUint32() ||
+      !info[2]->IsUint32() ||
+      !info[3]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "brokerOpen", ""));
+  }
+
+  Nan::Utf8String name(info[0]);
+  uint32_t bits = Nan::To<uint32_t>(info[1]).FromJust();
+  uint32_t capacity = Nan::To<uint32_t>(info[2]).FromJust();
+  mode_t mode = Nan::To<uint32_t>(info[3]).FromJust();
 
-  if (info.Length() >= 4 && info[3]->IsFunction()) {
-    callback = new Nan::Callback(info[3].As<v8::Function>());
-    isrFunc = gpioISRHandler;
+  if (bits == 0 || capacity == 0 || (capacity & (capacity - 1)) != 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "brokerOpen", ""));
   }
 
-  gpioISR_g[user_gpio].SetCallback(callback);
+  if (broker_g != 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EBUSY, "brokerOpen", ""));
+  }
 
-  int rc = gpioSetISRFunc(user_gpio, edge, timeout, isrFunc);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioSetISRFunc");
+  // A shared memory object with the same name may have been left behind
+  // by a process that terminated without closing its broker.
+  shm_unlink(*name);
+
+  int fd = shm_open(*name, O_CREAT | O_EXCL | O_RDWR, mode);
+  if (fd == -1) {
+    return Nan::ThrowError(Nan::ErrnoException(errno, "brokerOpen", ""));
   }
-}
 
+  size_t size = brokerSize(capacity);
+  void *shm = MAP_FAILED;
 
-// gpioAlertHandler is not executed in the event loop thread
-static void gpioAlertHandler(int gpio, int level, uint32_t tick) {
-  uv_sem_wait(&sem_g);
+  // fchmod as the mode passed to shm_open is modified by the umask
+  if (fchmod(fd, mode) == 0 && ftruncate(fd, size) == 0) {
+    shm = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
 
-  gpio_g = gpio;
-  level_g = level;
-  tick_g = tick;
+  int err = errno;
+  close(fd);
 
-  gpioAlert_g[gpio].AsyncSend();
-}
+  if (shm == MAP_FAILED) {
+    shm_unlink(*name);
+    return Nan::ThrowError(Nan::ErrnoException(err, "brokerOpen", ""));
+  }
 
+  BrokerHeader_t *header = (BrokerHeader_t *) shm;
+  header->version = BROKER_VERSION;
+  header->capacity = capacity;
+  header->bits = bits;
+  __atomic_store_n(&header->magic, BROKER_MAGIC, __ATOMIC_RELEASE);
 
-// gpioAlertEventLoopHandler is executed in the event loop thread.
-static void gpioAlertEventLoopHandler(uv_async_t* handle) {
-  Nan::HandleScope scope;
+  Broker_t *broker = new Broker_t(header, *name);
 
-  if (gpioAlert_g[gpio_g].Callback()) {
-    v8::Local<v8::Value> args[3] = {
-      Nan::New<v8::Integer>(gpio_g),
-      Nan::New<v8::Integer>(level_g),
-      Nan::New<v8::Integer>(tick_g)
-    };
+  int rc = 0;
+  for (unsigned gpio = 0; gpio <= PI_MAX_USER_GPIO && rc >= 0; ++gpio) {
+    if (bits & (1u << gpio)) {
+      rc = addAlertListener(gpio, broker);
+    }
+  }
 
-    gpioAlert_g[gpio_g].Callback()->Call(
-      3,
-      args,
-      gpioAlert_g[gpio_g].Resource()
-    );
+  if (rc < 0) {
+    brokerRemoveListeners(broker);
+    broker->Close();
+    delete broker;
+    return ThrowPigpioError(rc, "brokerOpen");
   }
 
-  uv_sem_post(&sem_g);
+  broker_g = broker;
 }
 
 
-static NAN_METHOD(gpioSetAlertFunc) {
-  if (info.Length() < 1 ||
-      !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSetAlertFunc"));
+NAN_METHOD(brokerSequence) {
+  if (broker_g == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "brokerSequence", ""));
   }
 
-  if (info.Length() >= 2 &&
-      !info[1]->IsFunction() &&
-      !info[1]->IsNull() &&
-      !info[1]->IsUndefined()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioSetAlertFunc"));
-  }
+  info.GetReturnValue().Set(broker_g->Sequence());
+}
 
-  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
-  Nan::Callback *callback = 0;
-  gpioAlertFunc_t alertFunc = 0;
 
-  if (info.Length() >= 2 && info[1]->IsFunction()) {
-    callback = new Nan::Callback(info[1].As<v8::Function>());
-    alertFunc = gpioAlertHandler;
+NAN_METHOD(brokerClose) {
+  if (broker_g == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "brokerClose", ""));
   }
 
-  gpioAlert_g[user_gpio].SetCallback(callback);
+  Broker_t *broker = broker_g;
+  broker_g = 0;
 
-  int rc = gpioSetAlertFunc(user_gpio, alertFunc);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioSetAlertFunc");
-  }
+  brokerRemoveListeners(broker);
+  broker->Close();
+  delete broker;
 }
 
 
-NAN_METHOD(gpioGlitchFilter) {
-  if (info.Length() < 2 || !info[0]->IsUint32() || !info[1]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioGlitchFilter", ""));
+// A BrokerClient_t reads the records published by a broker in another
+// process on its own thread. Records are passed to JavaScript in batches,
+// as a Buffer, together with the number of records lost since the last
+// batch. Records are lost if the reader falls more than the capacity of the
+// ring behind the writer or if JavaScript falls more than the capacity of
+// the ring behind the reader.
+class BrokerClient_t {
+public:
+  BrokerClient_t(BrokerHeader_t *header, Nan::Callback *callback)
+    : header_(header),
+      records_((uint32_t *) (header + 1)),
+      capacity_(header->capacity),
+      stop_(false),
+      done_(false),
+      lost_(0),
+      joined_(false),
+      callback_(callback),
+      async_resource_(new Nan::AsyncResource("pigpio:brokerclient")) {
+    uv_mutex_init(&mutex_);
+
+    uv_async_init(uv_default_loop(), &async_, brokerClientAsyncHandler);
+    async_.data = this;
   }
 
-  unsigned user_gpio = Nan::To<uint32_t>(info[0]).FromJust();
-  unsigned steady = Nan::To<uint32_t>(info[1]).FromJust();
+  virtual ~BrokerClient_t() {
+    munmap(header_, brokerSize(capacity_));
+    uv_mutex_destroy(&mutex_);
+    delete callback_;
+    delete async_resource_;
+  }
 
-  int rc = gpioGlitchFilter(user_gpio, steady);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioGlitchFilter");
+  void Start() {
+    uv_thread_create(&thread_, brokerClientThread, this);
   }
-}
 
+  // Run is not executed in the event loop thread.
+  void Run() {
+    uint32_t next = __atomic_load_n(&header_->sequence, __ATOMIC_ACQUIRE);
+    std::vector<uint32_t> batch;
 
-/* ------------------------------------------------------------------------ */
-/* GpioBank                                                                 */
-/* ------------------------------------------------------------------------ */
+    while (!Stopped()) {
+      uint32_t sequence = __atomic_load_n(&header_->sequence, __ATOMIC_ACQUIRE);
 
+      if (sequence == next) {
+        if (__atomic_load_n(&header_->closed, __ATOMIC_ACQUIRE)) {
+          break;
+        }
 
-NAN_METHOD(GpioReadBits_0_31) {
-  info.GetReturnValue().Set(gpioRead_Bits_0_31());
-}
+        Wait(next);
+        continue;
+      }
 
+      uint32_t lost = 0;
 
-NAN_METHOD(GpioReadBits_32_53) {
-  info.GetReturnValue().Set(gpioRead_Bits_32_53());
-}
+      uint32_t distance = brokerDistance(next, sequence);
 
+      if (distance > capacity_) {
+        lost = distance - capacity_;
+        next = brokerPreviousSequence(sequence, capacity_);
+      }
 
-NAN_METHOD(GpioWriteBitsSet_0_31) {
-  if (info.Length() < 1 || !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsSet_0_31", ""));
-  }
+      batch.clear();
 
-  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+      for (; next != sequence; next = brokerNextSequence(next)) {
+        if (!Read(brokerNextSequence(next), batch)) {
+          lost += 1;
+        }
+      }
 
-  int rc = gpioWrite_Bits_0_31_Set(bits);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "GpioWriteBitsSet_0_31");
+      Append(batch, lost);
+    }
+
+    uv_mutex_lock(&mutex_);
+    done_ = true;
+    uv_mutex_unlock(&mutex_);
+
+    uv_async_send(&async_);
   }
 
-  info.GetReturnValue().Set(rc);
-}
+  // Deliver is executed in the event loop thread.
+  void Deliver() {
+    Nan::HandleScope scope;
 
+    std::vector<uint32_t> records;
 
-NAN_METHOD(GpioWriteBitsSet_32_53) {
-  if (info.Length() < 1 || !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsSet_32_53", ""));
+    uv_mutex_lock(&mutex_);
+    records.swap(pending_);
+    uint32_t lost = lost_;
+    lost_ = 0;
+    bool done = done_;
+    uv_mutex_unlock(&mutex_);
+
+    if (!records.empty() || lost != 0) {
+      size_t size = records.size() * sizeof(uint32_t);
+      v8::Local<v8::Object> buffer = Nan::NewBuffer(size).ToLocalChecked();
+
+      if (size != 0) {
+        memcpy(node::Buffer::Data(buffer), &records[0], size);
+      }
+
+      v8::Local<v8::Value> args[3] = {
+        Nan::New<v8::Integer>(BROKER_EVENT_DATA),
+        buffer,
+        Nan::New<v8::Uint32>(lost)
+      };
+
+      callback_->Call(3, args, async_resource_);
+    }
+
+    if (done) {
+      Join();
+
+      v8::Local<v8::Value> args[1] = {
+        Nan::New<v8::Integer>(BROKER_EVENT_END)
+      };
+
+      callback_->Call(1, args, async_resource_);
+    }
   }
 
-  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+  void Stop() {
+    uv_mutex_lock(&mutex_);
+    stop_ = true;
+    uv_mutex_unlock(&mutex_);
+  }
 
-  int rc = gpioWrite_Bits_32_53_Set(bits);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "GpioWriteBitsSet_32_53");
+  // The BrokerClient_t deletes itself once its libuv handle is closed.
+  void Close() {
+    Stop();
+    Join();
+    uv_close((uv_handle_t *) &async_, brokerClientCloseHandler);
   }
 
-  info.GetReturnValue().Set(rc);
-}
+private:
+  void Join() {
+    if (!joined_) {
+      uv_thread_join(&thread_);
+      joined_ = true;
+    }
+  }
 
+  bool Stopped() {
+    uv_mutex_lock(&mutex_);
+    bool stop = stop_;
+    uv_mutex_unlock(&mutex_);
 
-NAN_METHOD(GpioWriteBitsClear_0_31) {
-  if (info.Length() < 1 || !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsClear_0_31", ""));
+    return stop;
   }
 
-  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+  // Waits until the sequence number differs from sequence. The wait is
+  // limited so that Stop is noticed.
+  void Wait(uint32_t sequence) {
+    struct timespec timeout = {0, BROKER_WAIT_NS};
 
-  int rc = gpioWrite_Bits_0_31_Clear(bits);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "GpioWriteBitsClear_0_31");
+    __atomic_add_fetch(&header_->waiters, 1, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&header_->sequence, __ATOMIC_SEQ_CST) == sequence) {
+      syscall(SYS_futex, &header_->sequence, FUTEX_WAIT, sequence, &timeout, 0, 0);
+    }
+
+    __atomic_sub_fetch(&header_->waiters, 1, __ATOMIC_SEQ_CST);
   }
 
-  info.GetReturnValue().Set(rc);
-}
+  // Copies the record with the given sequence number to batch. Returns false
+  // if it was overwritten by the writer.
+  bool Read(uint32_t sequence, std::vector<uint32_t> &batch) {
+    const uint32_t *record =
+      &records_[((sequence - 1) & (capacity_ - 1)) * BROKER_RECORD_WORDS];
+
+    uint32_t before = __atomic_load_n(&record[0], __ATOMIC_ACQUIRE);
+    uint32_t tick = __atomic_load_n(&record[1], __ATOMIC_RELAXED);
+    uint32_t tickHi = __atomic_load_n(&record[2], __ATOMIC_RELAXED);
+    uint32_t gpioLevel = __atomic_load_n(&record[3], __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint32_t after = __atomic_load_n(&record[0], __ATOMIC_RELAXED);
+
+    if (before != sequence || after != sequence) {
+      return false;
+    }
 
+    batch.push_back(sequence);
+    batch.push_back(tick);
+    batch.push_back(tickHi);
+    batch.push_back(gpioLevel);
 
-NAN_METHOD(GpioWriteBitsClear_32_53) {
-  if (info.Length() < 1 || !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "GpioWriteBitsClear_32_53", ""));
+    return true;
   }
 
-  unsigned bits = Nan::To<uint32_t>(info[0]).FromJust();
+  void Append(const std::vector<uint32_t> &batch, uint32_t lost) {
+    uv_mutex_lock(&mutex_);
 
-  int rc = gpioWrite_Bits_32_53_Clear(bits);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "GpioWriteBitsClear_32_53");
+    size_t room = capacity_ * BROKER_RECORD_WORDS - pending_.size();
+    size_t count = batch.size() < room ? batch.size() : room;
+
+    pending_.insert(pending_.end(), batch.begin(), batch.begin() + count);
+    lost_ += lost + (batch.size() - count) / BROKER_RECORD_WORDS;
+
+    uv_mutex_unlock(&mutex_);
+
+    uv_async_send(&async_);
   }
 
-  info.GetReturnValue().Set(rc);
+  BrokerHeader_t *header_;
+  const uint32_t *records_;
+  uint32_t capacity_;
+
+  // pending_, lost_, stop_ and done_ are protected by mutex_
+  std::vector<uint32_t> pending_;
+  bool stop_;
+  bool done_;
+  uint32_t lost_;
+
+  uv_thread_t thread_;
+  bool joined_;
+  uv_mutex_t mutex_;
+  uv_async_t async_;
+  Nan::Callback *callback_;
+  Nan::AsyncResource *async_resource_;
+};
+
+
+#define MAX_BROKER_CLIENTS 8
+
+static BrokerClient_t *brokerClients_g[MAX_BROKER_CLIENTS];
+
+
+// brokerClientThread is not executed in the event loop thread.
+static void brokerClientThread(void *arg) {
+  ((BrokerClient_t *) arg)->Run();
 }
 
 
-/* ------------------------------------------------------------------------ */
-/* Notifier                                                                 */
-/* ------------------------------------------------------------------------ */
+// brokerClientAsyncHandler is executed in the event loop thread.
+static void brokerClientAsyncHandler(uv_async_t* handle) {
+  ((BrokerClient_t *) handle->data)->Deliver();
+}
 
 
-NAN_METHOD(gpioNotifyOpen) {
-  int rc = gpioNotifyOpen();
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioNotifyOpen");
+static void brokerClientCloseHandler(uv_handle_t* handle) {
+  delete (BrokerClient_t *) handle->data;
+}
+
+
+static BrokerClient_t *getBrokerClient(v8::Local<v8::Value> value) {
+  if (!value->IsUint32()) {
+    return 0;
   }
 
-  info.GetReturnValue().Set(rc);
+  unsigned handle = Nan::To<uint32_t>(value).FromJust();
+  if (handle >= MAX_BROKER_CLIENTS) {
+    return 0;
+  }
+
+  return brokerClients_g[handle];
 }
 
 
-NAN_METHOD(gpioNotifyOpenWithSize) {
-  if (info.Length() < 1 || !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyOpenWithSize", ""));
+// brokerAttach(name, callback) doesn't require the pigpio C library to be
+// initialized.
+NAN_METHOD(brokerAttach) {
+  if (info.Length() < 2 || !info[0]->IsString() || !info[1]->IsFunction()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "brokerAttach", ""));
   }
 
-  unsigned bufSize = Nan::To<uint32_t>(info[0]).FromJust();
+  Nan::Utf8String name(info[0]);
 
-  int rc = gpioNotifyOpenWithSize(bufSize);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioNotifyOpen");
+  unsigned handle = 0;
+  while (handle != MAX_BROKER_CLIENTS && brokerClients_g[handle] != 0) {
+    handle += 1;
   }
 
-  info.GetReturnValue().Set(rc);
-}
-
+  if (handle == MAX_BROKER_CLIENTS) {
+    return Nan::ThrowError(Nan::ErrnoException(EMFILE, "brokerAttach", ""));
+  }
 
-NAN_METHOD(gpioNotifyBegin) {
-  if (info.Length() < 2 || !info[0]->IsUint32() || !info[1]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyBegin", ""));
+  int fd = shm_open(*name, O_RDWR, 0);
+  if (fd == -1) {
+    return Nan::ThrowError(Nan::ErrnoException(errno, "brokerAttach", ""));
   }
 
-  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
-  unsigned bits = Nan::To<uint32_t>(info[1]).FromJust();
+  struct stat st;
+  void *shm = MAP_FAILED;
 
-  int rc = gpioNotifyBegin(handle, bits);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioNotifyBegin");
+  if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(BrokerHeader_t)) {
+    shm = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  } else {
+    errno = EPROTO;
   }
-}
 
+  int err = errno;
+  close(fd);
 
-NAN_METHOD(gpioNotifyPause) {
-  if (info.Length() < 1 || !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyPause", ""));
+  if (shm == MAP_FAILED) {
+    return Nan::ThrowError(Nan::ErrnoException(err, "brokerAttach", ""));
   }
 
-  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+  BrokerHeader_t *header = (BrokerHeader_t *) shm;
 
-  int rc = gpioNotifyPause(handle);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioNotifyPause");
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != BROKER_MAGIC ||
+      header->version != BROKER_VERSION ||
+      brokerSize(header->capacity) != (size_t) st.st_size) {
+    munmap(shm, st.st_size);
+    return Nan::ThrowError(Nan::ErrnoException(EPROTO, "brokerAttach", ""));
   }
+
+  BrokerClient_t *client = new BrokerClient_t(
+    header, new Nan::Callback(info[1].As<v8::Function>())
+  );
+
+  brokerClients_g[handle] = client;
+  client->Start();
+
+  info.GetReturnValue().Set(handle);
 }
 
 
-NAN_METHOD(gpioNotifyClose) {
-  if (info.Length() < 1 || !info[0]->IsUint32()) {
-    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioNotifyClose", ""));
+NAN_METHOD(brokerDetach) {
+  BrokerClient_t *client = getBrokerClient(info[0]);
+  if (client == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "brokerDetach", ""));
   }
 
-  unsigned handle = Nan::To<uint32_t>(info[0]).FromJust();
+  brokerClients_g[Nan::To<uint32_t>(info[0]).FromJust()] = 0;
 
-  int rc = gpioNotifyClose(handle);
-  if (rc < 0) {
-    return ThrowPigpioError(rc, "gpioNotifyClose");
-  }
+  client->Close();
 }
 
 
@@ -793,8 +6253,84 @@ NAN_METHOD(gpioWaveAddGeneric) {
 }
 
 
+// Adds the pulses for the patterns start to end - 1 to the current waveform.
+// Each pattern is a bit mask of the levels of GPIOs 0 to 31 which is held
+// for period microseconds. Only the GPIOs in mask are modified. The set and
+// clear masks of a pulse are computed from the difference to the previous
+// pattern. Identical consecutive patterns are merged into a single pulse.
+// If first is true, all GPIOs in mask are driven by the first pulse,
+// otherwise previous is the pattern that precedes start. Returns the number
+// of pulses added.
+NAN_METHOD(gpioWaveAddPattern) {
+  if (info.Length() < 7 ||
+      !info[0]->IsUint32Array() ||
+      !info[1]->IsUint32() ||
+      !info[2]->IsUint32() ||
+      !info[3]->IsUint32() ||
+      !info[4]->IsUint32() ||
+      !info[5]->IsBoolean() ||
+      !info[6]->IsUint32()) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioWaveAddPattern", ""));
+  }
+
+  Nan::TypedArrayContents<uint32_t> patterns(info[0]);
+  uint32_t start = Nan::To<uint32_t>(info[1]).FromJust();
+  uint32_t end = Nan::To<uint32_t>(info[2]).FromJust();
+  uint32_t mask = Nan::To<uint32_t>(info[3]).FromJust();
+  uint32_t period = Nan::To<uint32_t>(info[4]).FromJust();
+  bool first = Nan::To<bool>(info[5]).FromJust();
+  uint32_t previous = Nan::To<uint32_t>(info[6]).FromJust() & mask;
+
+  if (start > end || end > patterns.length() || period == 0) {
+    return Nan::ThrowError(Nan::ErrnoException(EINVAL, "gpioWaveAddPattern", ""));
+  }
+
+  std::vector<gpioPulse_t> pulses;
+  pulses.reserve(end - start);
+
+  for (uint32_t i = start; i != end; ++i) {
+    uint32_t pattern = (*patterns)[i] & mask;
+    uint32_t on = pattern & ~previous;
+    uint32_t off = previous & ~pattern;
+
+    if (i == start && first) {
+      on = pattern;
+      off = ~pattern & mask;
+    }
+
+    if (on == 0 && off == 0 && !pulses.empty()) {
+      pulses.back().usDelay += period;
+    } else {
+      gpioPulse_t pulse;
+      pulse.gpioOn = on;
+      pulse.gpioOff = off;
+      pulse.usDelay = period;
+      pulses.push_back(pulse);
+    }
+
+    previous = pattern;
+  }
+
+  if (pulses.empty()) {
+    return info.GetReturnValue().Set(0);
+  }
+
+  int rc = gpioWaveAddGeneric(pulses.size(), &pulses[0]);
+  if (rc < 0) {
+    return ThrowPigpioError(rc, "gpioWaveAddPattern");
+  }
+
+  info.GetReturnValue().Set((uint32_t) pulses.size());
+}
+
+
 NAN_METHOD(gpioWaveCreate) {
+  uint64_t traceStart = traceBegin();
+
   int rc = gpioWaveCreate();
+
+  traceEnd(TRACE_WAVE_CREATE, traceStart, -1, rc, 0, 0);
+
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioWaveCreate");
   }
@@ -825,7 +6361,12 @@ NAN_METHOD(gpioWaveTxSend) {
   unsigned waveId = Nan::To<uint32_t>(info[0]).FromJust();
   unsigned waveMode = Nan::To<uint32_t>(info[1]).FromJust();
 
+  uint64_t traceStart = traceBegin();
+
   int rc = gpioWaveTxSend(waveId, waveMode);
+
+  traceEnd(TRACE_WAVE_TX_SEND, traceStart, -1, rc, waveId, 0);
+
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioWaveTxSend");
   }
@@ -842,7 +6383,12 @@ NAN_METHOD(gpioWaveChain) {
   char * buf = node::Buffer::Data(info[0]);
   unsigned bufSize = Nan::To<uint32_t>(info[1]).FromJust();
 
+  uint64_t traceStart = traceBegin();
+
   int rc = gpioWaveChain(buf, bufSize);
+
+  traceEnd(TRACE_WAVE_CHAIN, traceStart, -1, rc, bufSize, 0);
+
   if (rc < 0) {
     return ThrowPigpioError(rc, "gpioWaveChain");
   }
@@ -982,6 +6528,24 @@ static void SetFunction(
 
 NAN_MODULE_INIT(InitAll) {
   uv_sem_init(&sem_g, 1);
+  uv_mutex_init(&initMutex_g);
+  uv_cond_init(&initCond_g);
+  uv_mutex_init(&alertListenersMutex_g);
+  uv_mutex_init(&tickMutex_g);
+  uv_mutex_init(&notifyHubMutex_g);
+  uv_mutex_init(&dispatcherMutex_g);
+  uv_cond_init(&dispatcherNotEmpty_g);
+  uv_cond_init(&dispatcherNotFull_g);
+  uv_mutex_init(&dispatcherJsMutex_g);
+  uv_mutex_init(&traceMutex_g);
+  pthread_key_create(&traceBufferKey_g, traceThreadExit);
+
+  traceThreadName_t = "event loop";
+
+  memset(gpioPullUpDown_g, -1, sizeof(gpioPullUpDown_g));
+
+  uv_timer_init(uv_default_loop(), &tickTimer_g);
+  uv_unref((uv_handle_t *) &tickTimer_g);
 
   /* mode constants */
 /*  SetConst(target, "PI_INPUT", PI_INPUT);
@@ -1020,8 +6584,11 @@ NAN_MODULE_INIT(InitAll) {
 
   /* functions */
   SetFunction(target, "gpioHardwareRevision", gpioHardwareRevision);
+  SetFunction(target, "gpioVersion", gpioVersion);
   SetFunction(target, "gpioCfgInterfaces", gpioCfgInterfaces);
   SetFunction(target, "gpioInitialise", gpioInitialise);
+  SetFunction(target, "gpioInitialiseAsync", gpioInitialiseAsync);
+  SetFunction(target, "gpioInitialiseWait", gpioInitialiseWait);
   SetFunction(target, "gpioTerminate", gpioTerminate);
 
   SetFunction(target, "gpioSetMode", gpioSetMode);
@@ -1049,6 +6616,9 @@ NAN_MODULE_INIT(InitAll) {
   SetFunction(target, "gpioSetAlertFunc", gpioSetAlertFunc);
   SetFunction(target, "gpioGlitchFilter", gpioGlitchFilter);
 
+  SetFunction(target, "dispatcherConfigure", dispatcherConfigure);
+  SetFunction(target, "dispatcherDropped", dispatcherDropped);
+
   SetFunction(target, "GpioReadBits_0_31", GpioReadBits_0_31);
   SetFunction(target, "GpioReadBits_32_53", GpioReadBits_32_53);
   SetFunction(target, "GpioWriteBitsSet_0_31", GpioWriteBitsSet_0_31);
@@ -1062,9 +6632,52 @@ NAN_MODULE_INIT(InitAll) {
   SetFunction(target, "gpioNotifyPause", gpioNotifyPause);
   SetFunction(target, "gpioNotifyClose", gpioNotifyClose);
 
+  SetFunction(target, "stateMirror", stateMirror);
+
+  SetFunction(target, "gpioSnapshot", gpioSnapshot);
+
+  SetFunction(target, "notifyHubSubscribe", notifyHubSubscribe);
+  SetFunction(target, "notifyHubBegin", notifyHubBegin);
+  SetFunction(target, "notifyHubResume", notifyHubResume);
+  SetFunction(target, "notifyHubDropped", notifyHubDropped);
+  SetFunction(target, "notifyHubClose", notifyHubClose);
+
+  SetFunction(target, "watchdogEnable", watchdogEnable);
+  SetFunction(target, "watchdogDisable", watchdogDisable);
+
+  SetFunction(target, "encoderOpen", encoderOpen);
+  SetFunction(target, "encoderPosition", encoderPosition);
+  SetFunction(target, "encoderSetPosition", encoderSetPosition);
+  SetFunction(target, "encoderClose", encoderClose);
+
+  SetFunction(target, "controllerOpen", controllerOpen);
+  SetFunction(target, "controllerSet", controllerSet);
+  SetFunction(target, "controllerClose", controllerClose);
+
+  SetFunction(target, "decoderOpen", decoderOpen);
+  SetFunction(target, "decoderClose", decoderClose);
+
+  SetFunction(target, "edgeTriggerOpen", edgeTriggerOpen);
+  SetFunction(target, "edgeTriggerClose", edgeTriggerClose);
+
+  SetFunction(target, "captureStart", captureStart);
+  SetFunction(target, "captureStop", captureStop);
+  SetFunction(target, "captureClose", captureClose);
+
+  SetFunction(target, "traceEnable", traceEnable);
+  SetFunction(target, "traceDisable", traceDisable);
+  SetFunction(target, "traceCollect", traceCollect);
+
+  SetFunction(target, "brokerOpen", brokerOpen);
+  SetFunction(target, "brokerSequence", brokerSequence);
+  SetFunction(target, "brokerClose", brokerClose);
+  SetFunction(target, "brokerAttach", brokerAttach);
+  SetFunction(target, "brokerDetach", brokerDetach);
+
   SetFunction(target, "gpioWaveClear", gpioWaveClear);
   SetFunction(target, "gpioWaveAddNew", gpioWaveAddNew);
   SetFunction(target, "gpioWaveAddGeneric", gpioWaveAddGeneric);
+  SetFunction(target, "gpioWaveAddPattern", gpioWaveAddPattern);
   SetFunction(target, "gpioWaveCreate", gpioWaveCreate);
   SetFunction(target, "gpioWaveDelete", gpioWaveDelete);
   SetFunction(target, "gpioWaveTxSend", gpioWaveTxSend);
@@ -1086,6 +6699,9 @@ NAN_MODULE_INIT(InitAll) {
   SetFunction(target, "gpioCfgSocketPort", gpioCfgSocketPort);
 
   SetFunction(target, "gpioTick", gpioTick);
+  SetFunction(target, "gpioTick64", gpioTick64);
+  SetFunction(target, "gpioTickExtend", gpioTickExtend);
+  SetFunction(target, "gpioTickOffset", gpioTickOffset);
 
   gpioISR_g = new GpioISR_t[PI_MAX_USER_GPIO + 1];
   gpioAlert_g = new GpioAlert_t[PI_MAX_USER_GPIO + 1];
@@ -0,0 +1,63 @@
+'use strict';
+
+// Generate PWM pulses at 10kHz and count the edges with coalesced alerts.
+// Roughly 20000 edges per second should be delivered in roughly 10 alert
+// events per second.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+const FREQUENCY = 10000;
+const WINDOW = 100000;
+
+const led = new Gpio(18, {mode: Gpio.OUTPUT});
+
+let events = 0;
+let edges = 0;
+let lastLevel;
+let lastTick;
+
+led.enableAlert({coalesce: WINDOW});
+
+led.on('alert', (level, tick, count, firstTick) => {
+  assert(count >= 1, 'expected at least one edge per event');
+
+  // Events don't overlap and each covers at most a few windows, the exact
+  // span depends on how promptly the event loop runs the hold-off timer.
+  if (lastTick !== undefined) {
+    assert(pigpio.tickDiff(lastTick, firstTick) > 0, 'events overlap');
+  }
+  assert(pigpio.tickDiff(firstTick, tick) < 5 * WINDOW,
+    'event spans ' + pigpio.tickDiff(firstTick, tick) + 'us');
+
+  events += 1;
+  edges += count;
+  lastLevel = level;
+  lastTick = tick;
+});
+
+led.hardwarePwmWrite(FREQUENCY, 500000);
+
+let stopTick;
+
+setTimeout(() => {
+  stopTick = pigpio.getTick();
+  led.digitalWrite(0);
+
+  setTimeout(() => {
+    led.disableAlert();
+
+    console.log('  ' + edges + ' edges in ' + events + ' events');
+
+    assert(edges >= 2 * FREQUENCY * 0.9, 'expected about ' + 2 * FREQUENCY + ' edges');
+    assert(events >= 2 && events <= 13, 'expected about 10 events instead of ' + events);
+
+    // The last event has the level and tick of the last edge.
+    assert.strictEqual(lastLevel, 0);
+    assert(Math.abs(pigpio.tickDiff(stopTick, lastTick)) < 2 * WINDOW,
+      'expected the last edge when PWM stopped');
+
+    console.log('  success...');
+  }, 500);
+}, 1000);
@@ -0,0 +1,58 @@
+'use strict';
+
+// No external wiring is required as alerts also work for outputs. GPIO17 is
+// toggled for 300 milliseconds, GPIO18 isn't toggled. Both have a watchdog
+// with a timeout of 50 milliseconds.
+
+const assert = require('assert');
+const Gpio = require('../').Gpio;
+
+const busy = new Gpio(17, {mode: Gpio.OUTPUT, watchdog: 50});
+const idle = new Gpio(18, {mode: Gpio.OUTPUT, watchdog: 50});
+
+const timeouts = {17: [], 18: []};
+
+[busy, idle].forEach((gpio) => {
+  gpio.on('timeout', (level, tick) => {
+    timeouts[gpio.gpio].push({level, tick, time: Date.now()});
+  });
+});
+
+idle.digitalWrite(0);
+
+const start = Date.now();
+let level = 0;
+
+const toggler = setInterval(() => {
+  level ^= 1;
+  busy.digitalWrite(level);
+}, 5);
+
+setTimeout(() => {
+  clearInterval(toggler);
+}, 300);
+
+setTimeout(() => {
+  // The edge on GPIO18 rearms its watchdog.
+  idle.digitalWrite(1);
+}, 400);
+
+setTimeout(() => {
+  busy.disableWatchdog();
+  idle.disableWatchdog();
+
+  assert.strictEqual(timeouts[17].length, 1,
+    'expected 1 timeout on GPIO17 instead of ' + timeouts[17].length);
+  assert.strictEqual(timeouts[17][0].level, level);
+  assert(timeouts[17][0].time - start >= 340,
+    'GPIO17 timed out while it was being toggled');
+
+  assert.strictEqual(timeouts[18].length, 2,
+    'expected 2 timeouts on GPIO18 instead of ' + timeouts[18].length);
+  assert.strictEqual(timeouts[18][0].level, 0);
+  assert.strictEqual(timeouts[18][1].level, 1);
+  assert(timeouts[18][0].time - start < 150,
+    'GPIO18 timed out late');
+
+  console.log('  success...');
+}, 600);
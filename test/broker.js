@@ -0,0 +1,99 @@
+'use strict';
+
+// Publish the alerts of an output with a Broker and check that a client in
+// a child process receives every edge in order without losses.
+
+const assert = require('assert');
+const fork = require('child_process').fork;
+const pigpio = require('../');
+
+const PATH = '/tmp/pigpio-broker-test';
+const EDGES = 2000;
+const outPin = 17;
+
+const client = async () => {
+  const broker = await pigpio.attachBroker({path: PATH});
+  const gpio = broker.gpio(outPin);
+  let edges = 0;
+  let lastSequence = 0;
+  let lost = 0;
+  let lastLevel = -1;
+
+  broker.on('alerts', (records) => {
+    for (let offset = 0; offset !== records.length; offset += pigpio.BrokerClient.RECORD_LENGTH) {
+      const sequence = records.readUInt32LE(offset);
+
+      assert(lastSequence === 0 || sequence === lastSequence + 1,
+        'sequence ' + sequence + ' after ' + lastSequence);
+      lastSequence = sequence;
+    }
+  });
+
+  broker.on('lost', (count) => {
+    lost += count;
+  });
+
+  gpio.on('alert', (level) => {
+    assert.notStrictEqual(level, lastLevel);
+    lastLevel = level;
+    edges += 1;
+  });
+
+  broker.on('close', () => {
+    process.send({edges: edges, lost: lost}, () => process.disconnect());
+  });
+
+  process.send('attached');
+};
+
+const owner = () => {
+  const Gpio = pigpio.Gpio;
+  const output = new Gpio(outPin, {mode: Gpio.OUTPUT});
+
+  output.digitalWrite(0);
+
+  const broker = new pigpio.Broker({path: PATH, bits: 1 << outPin});
+
+  broker.on('listening', () => {
+    const child = fork(__filename, ['client']);
+
+    child.on('message', (message) => {
+      if (message === 'attached') {
+        assert.strictEqual(broker.clientCount(), 1);
+
+        // Hold each level long enough for pigpio to sample it
+        for (let i = 0; i !== EDGES; i += 1) {
+          const start = pigpio.getTick();
+
+          output.digitalWrite(i % 2 === 0 ? 1 : 0);
+
+          while (pigpio.tickDiff(start, pigpio.getTick()) < 20) {
+          }
+        }
+
+        // Close while the client may still be reading, it should still
+        // receive every record published before the broker was closed
+        setTimeout(() => {
+          assert.strictEqual(broker.sequence(), EDGES);
+          broker.close();
+        }, 20);
+      } else {
+        console.log('  ' + message.edges + ' edges, ' + message.lost + ' lost');
+
+        assert.strictEqual(message.edges, EDGES);
+        assert.strictEqual(message.lost, 0);
+
+        console.log('  success...');
+      }
+    });
+  });
+};
+
+if (process.argv[2] === 'client') {
+  client().catch((err) => {
+    console.error(err);
+    process.exit(1);
+  });
+} else {
+  owner();
+}
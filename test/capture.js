@@ -0,0 +1,64 @@
+'use strict';
+
+// Capture 1kHz hardware PWM on GPIO18 at 100kHz and check the run lengths.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+const led = new Gpio(18, {mode: Gpio.OUTPUT});
+
+led.hardwarePwmWrite(1000, 500000);
+
+const capture = pigpio.capture({
+  mask: 1 << 18,
+  rateHz: 100000,
+  durationMs: 100,
+  trigger: {mask: 1 << 18, levels: 1 << 18, timeoutMs: 100}
+});
+
+capture.on('end', (result) => {
+  const records = result.records.length / pigpio.Capture.RECORD_LENGTH;
+
+  console.log('  ' + result.samples + ' samples, ' + records + ' records');
+
+  assert(result.triggered, 'expected the capture to trigger');
+  assert(!result.truncated, 'expected the capture not to be truncated');
+  assert.strictEqual(result.interval, 10);
+  assert(records >= 190 && records <= 210, 'expected about 200 records');
+
+  // The first and the last records are cut by the start and end of the
+  // capture.
+  for (let i = 1; i < records - 1; i += 1) {
+    const offset = i * pigpio.Capture.RECORD_LENGTH;
+    const level = (result.records.readUInt32LE(offset) >>> 18) & 1;
+    const micros = result.records.readUInt32LE(offset + 8);
+
+    assert.strictEqual(level, i & 1 ? 0 : 1);
+    assert(Math.abs(micros - 500) <= 20, 'expected about 500 us, got ' + micros);
+  }
+
+  const vcd = pigpio.captureToVcd(result, {names: {18: 'pwm'}});
+  assert(vcd.indexOf('$var wire 1 3 pwm $end') !== -1);
+
+  // Stream chunks of 50 records. Every 'data' event has a full chunk, the
+  // remaining records are passed to the 'end' event.
+  let chunks = 0;
+
+  pigpio.capture({mask: 1 << 18, rateHz: 100000, durationMs: 100, chunkRecords: 50}).
+    on('data', (records) => {
+      assert.strictEqual(records.length, 50 * pigpio.Capture.RECORD_LENGTH);
+      chunks += 1;
+    }).
+    on('end', (result) => {
+      const remaining = result.records.length / pigpio.Capture.RECORD_LENGTH;
+      const total = chunks * 50 + remaining;
+
+      assert(chunks >= 3, 'expected at least 3 chunks');
+      assert(remaining < 50, 'expected less than a chunk at the end');
+      assert(total >= 190 && total <= 210, 'expected about 200 records');
+
+      led.digitalWrite(0);
+      console.log('  success...');
+    });
+});
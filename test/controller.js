@@ -0,0 +1,75 @@
+'use strict';
+
+// No external wiring is required. The controller measures the pulse width of
+// the PWM signal it generates on GPIO18 as alerts also work for outputs.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Controller = pigpio.Controller;
+
+const GPIO = 18;
+
+const controller = new Controller({
+  input: {type: Controller.PULSE_WIDTH, gpio: GPIO},
+  output: {type: Controller.PWM, gpio: GPIO},
+  ki: 5,
+  setpoint: 500,
+  rateHz: 100,
+  telemetry: 10
+});
+
+let samples = [];
+
+controller.on('telemetry', (batch) => {
+  samples = samples.concat(batch);
+});
+
+const settled = (setpoint) => {
+  const last = samples[samples.length - 1];
+
+  assert(samples.length >= 5, 'expected telemetry, got ' + samples.length + ' samples');
+  assert.strictEqual(last.setpoint, setpoint);
+  assert(Math.abs(last.measurement - setpoint) < 30,
+    'pulse width ' + last.measurement + 'us instead of ' + setpoint + 'us');
+  assert(last.output >= 0 && last.output <= 255);
+
+  console.log('  pulse width ' + last.measurement + 'us, duty cycle ' +
+    last.output.toFixed(1));
+};
+
+setTimeout(() => {
+  settled(500);
+
+  samples = [];
+  controller.set({setpoint: 900});
+
+  setTimeout(() => {
+    settled(900);
+
+    // The duty cycle of the output is reported by snapshot while the
+    // controller drives it
+    const dutyCycle = GPIO * pigpio.SNAPSHOT_FIELDS + pigpio.SNAPSHOT_PWM_DUTY_CYCLE;
+    assert(pigpio.snapshot(1 << GPIO)[dutyCycle] >= 0);
+
+    controller.close();
+    assert.strictEqual(pigpio.snapshot(1 << GPIO)[dutyCycle], -1);
+
+    // Closing doesn't wait for the next iteration of a slow control loop
+    const slow = new Controller({
+      input: {type: Controller.PULSE_WIDTH, gpio: GPIO},
+      output: {type: Controller.PWM, gpio: GPIO},
+      rateHz: 1
+    });
+
+    setTimeout(() => {
+      const start = pigpio.getTick();
+
+      slow.close();
+
+      const micros = pigpio.tickDiff(start, pigpio.getTick());
+      assert(micros < 100000, 'close took ' + micros + 'us');
+
+      console.log('  success...');
+    }, 100);
+  }, 1500);
+}, 1500);
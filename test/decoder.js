@@ -0,0 +1,180 @@
+'use strict';
+
+// GPIO7 needs to be connected to GPIO8 with a 1K resistor for this test.
+// NEC, RC5 and DHT frames are generated on GPIO8 with a waveform and decoded
+// on GPIO7. Wiegand frames are generated on GPIO17 and GPIO18 and decoded on
+// the same GPIOs as alerts also work for outputs.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+const Decoder = pigpio.Decoder;
+
+const IN = 7;
+const OUT = 8;
+const D0 = 17;
+const D1 = 18;
+
+const output = new Gpio(OUT, {mode: Gpio.OUTPUT});
+
+const low = (gpio, us) => ({gpioOn: 0, gpioOff: gpio, usDelay: us});
+const high = (gpio, us) => ({gpioOn: gpio, gpioOff: 0, usDelay: us});
+
+// Active low marks as output by IR receivers.
+const mark = (us) => low(OUT, us);
+const space = (us) => high(OUT, us);
+
+const necFrame = (address, command) => {
+  const pulses = [mark(9000), space(4500)];
+  const bytes = [address, ~address & 0xff, command, ~command & 0xff];
+
+  bytes.forEach((byte) => {
+    for (let bit = 0; bit !== 8; bit += 1) {
+      pulses.push(mark(562), space((byte >> bit) & 1 ? 1687 : 562));
+    }
+  });
+
+  pulses.push(mark(562), space(1000));
+
+  return pulses;
+};
+
+// A 1 is a space followed by a mark, a 0 is a mark followed by a space.
+const rc5Frame = (toggle, address, command) => {
+  const bits = (1 << 13) | (((command >> 6) ^ 1) << 12) | (toggle << 11) |
+    ((address & 0x1f) << 6) | (command & 0x3f);
+  const pulses = [];
+
+  for (let i = 13; i >= 0; i -= 1) {
+    if ((bits >> i) & 1) {
+      pulses.push(space(889), mark(889));
+    } else {
+      pulses.push(mark(889), space(889));
+    }
+  }
+
+  pulses.push(space(5000));
+
+  return pulses;
+};
+
+// The start signal, the response and 40 bits, each 50us low followed by
+// 27us (0) or 70us (1) high.
+const dhtFrame = (bytes) => {
+  const pulses = [low(OUT, 1000), high(OUT, 30), low(OUT, 80), high(OUT, 80)];
+
+  bytes.forEach((byte) => {
+    for (let bit = 7; bit >= 0; bit -= 1) {
+      pulses.push(low(OUT, 50), high(OUT, (byte >> bit) & 1 ? 70 : 27));
+    }
+  });
+
+  pulses.push(low(OUT, 50), high(OUT, 1000));
+
+  return pulses;
+};
+
+// A 100us low pulse on D0 is a 0 bit, on D1 a 1 bit.
+const wiegandFrame = (byte) => {
+  const pulses = [];
+
+  for (let bit = 7; bit >= 0; bit -= 1) {
+    const gpio = (byte >> bit) & 1 ? D1 : D0;
+    pulses.push(low(gpio, 100), high(gpio, 900));
+  }
+
+  return pulses;
+};
+
+const send = (pulses) => {
+  pigpio.waveClear();
+  pigpio.waveAddGeneric(pulses);
+
+  const waveId = pigpio.waveCreate();
+  pigpio.waveTxSend(waveId, pigpio.WAVE_MODE_ONE_SHOT);
+
+  return waveId;
+};
+
+// Sends a frame and checks that exactly one frame with the expected bytes is
+// decoded.
+const check = (name, decoder, pulses, expected, wait, done) => {
+  const frames = [];
+
+  decoder.on('frame', (data, bits, tick, deviation) => {
+    console.log('  ' + name + ': ' + bits + ' bits, ' + data.toString('hex') +
+      ', deviation ' + deviation + 'us');
+    frames.push(data);
+  });
+
+  const waveId = send(pulses);
+
+  setTimeout(() => {
+    pigpio.waveDelete(waveId);
+    decoder.close();
+
+    assert.strictEqual(frames.length, 1,
+      name + ': expected 1 frame instead of ' + frames.length);
+    assert.strictEqual(frames[0].toString('hex'), expected);
+
+    done();
+  }, wait);
+};
+
+const cases = [
+  (done) => {
+    check('nec', new Decoder(IN, Decoder.NEC),
+      necFrame(0x12, 0x34), '12ed34cb', 200, done
+    );
+  },
+
+  (done) => {
+    // Address 5, command 0x23, toggle bit 1.
+    check('rc5', new Decoder(IN, Decoder.RC5),
+      rc5Frame(1, 5, 0x23), '052301', 100, done
+    );
+  },
+
+  (done) => {
+    // 65.2%, 23.1°C and the checksum.
+    check('dht', new Decoder(IN, Decoder.DHT),
+      dhtFrame([0x02, 0x8c, 0x00, 0xe7, 0x75]), '028c00e775', 100, done
+    );
+  },
+
+  (done) => {
+    const decoder = new Decoder([D0, D1], Decoder.WIEGAND);
+
+    // The Decoder configures D0 and D1 as inputs.
+    const gpios = [D0, D1].map((gpio) => {
+      const out = new Gpio(gpio, {mode: Gpio.OUTPUT});
+      out.digitalWrite(1);
+      return out;
+    });
+
+    // The end of a frame is detected without the pigpio watchdog so there
+    // are no timeout alerts.
+    gpios[0].enableAlert();
+    gpios[0].on('alert', (level) => {
+      assert.notStrictEqual(level, 2, 'unexpected watchdog timeout on D0');
+    });
+
+    // The frame ends after the default gap of 25ms.
+    check('wiegand', decoder, wiegandFrame(0xa5), 'a5', 100, () => {
+      gpios[0].disableAlert();
+      done();
+    });
+  }
+];
+
+const run = (i) => {
+  if (i === cases.length) {
+    console.log('  success...');
+    return;
+  }
+
+  output.digitalWrite(1);
+  setTimeout(() => cases[i](() => run(i + 1)), 20);
+};
+
+run(0);
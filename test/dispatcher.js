@@ -0,0 +1,82 @@
+'use strict';
+
+// GPIO7 needs to be connected to GPIO8 with a 1K resistor for this test.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+const settings = pigpio.configureDispatcher({cpu: 0, policy: 'fifo', priority: 50});
+
+console.log('  ' + JSON.stringify(settings));
+
+assert.deepStrictEqual(settings.cpus, [0]);
+assert.strictEqual(settings.policy, 'fifo');
+assert.strictEqual(settings.priority, 50);
+
+assert.strictEqual(pigpio.configureDispatcher().policy, 'other');
+
+const input = new Gpio(7, {mode: Gpio.INPUT, edge: Gpio.EITHER_EDGE});
+const output = new Gpio(8, {mode: Gpio.OUTPUT});
+
+let interruptCount = 0;
+
+output.digitalWrite(0);
+
+input.on('interrupt', (level) => {
+  interruptCount++;
+  output.digitalWrite(level ^ 1);
+});
+
+setTimeout(() => {
+  output.digitalWrite(1);
+
+  setTimeout(() => {
+    input.disableInterrupt();
+
+    console.log('  ' + interruptCount + ' interrupts dispatched');
+    assert(interruptCount > 0, 'expected interrupts to be dispatched');
+
+    blockedEventLoop();
+  }, 1000);
+}, 1);
+
+// The dispatcher doesn't wait for JavaScript, so edges that occur while the
+// event loop is blocked are queued and delivered in order afterwards.
+const blockedEventLoop = () => {
+  const EDGES = 100;
+  const levels = [];
+  const pulses = [];
+
+  for (let i = 0; i !== EDGES / 2; i += 1) {
+    pulses.push({gpioOn: 8, gpioOff: 0, usDelay: 200});
+    pulses.push({gpioOn: 0, gpioOff: 8, usDelay: 200});
+  }
+
+  output.digitalWrite(0);
+  input.enableAlert();
+  input.on('alert', (level) => levels.push(level));
+
+  setTimeout(() => {
+    pigpio.waveClear();
+    pigpio.waveAddGeneric(pulses);
+    const waveId = pigpio.waveCreate();
+    pigpio.waveTxSend(waveId, pigpio.WAVE_MODE_ONE_SHOT);
+
+    const end = Date.now() + 100;
+    while (Date.now() < end) {
+    }
+
+    setTimeout(() => {
+      pigpio.waveDelete(waveId);
+      input.disableAlert();
+
+      assert.strictEqual(levels.length, EDGES,
+        'expected ' + EDGES + ' alerts instead of ' + levels.length);
+      levels.forEach((level, i) => assert.strictEqual(level, (i + 1) & 1));
+      assert.strictEqual(pigpio.dispatcherDropped(), 0);
+
+      console.log('  success...');
+    }, 100);
+  }, 10);
+};
@@ -0,0 +1,79 @@
+'use strict';
+
+// Edges are generated on GPIO17 and GPIO18 with a waveform. No external
+// wiring is required as alerts also work for outputs.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+const EdgeTrigger = pigpio.EdgeTrigger;
+
+const A = 17;
+const B = 18;
+
+assert.deepStrictEqual(
+  Array.from(EdgeTrigger.compile('rising(17) && !low(18) || quiet(4, 500)')),
+  [0, 17, 4, 18, 6, 7, 5, 4, 500, 8]
+);
+assert.throws(() => EdgeTrigger.compile('rising(17) &&'), /expected name/);
+assert.throws(() => EdgeTrigger.compile('rising(32)'), /GPIO from 0 to 31/);
+assert.throws(() => EdgeTrigger.compile('toggle(17)'), /unknown trigger function/);
+assert.throws(() => new EdgeTrigger('rising(17)', {pre: -1}), RangeError);
+assert.throws(() => new EdgeTrigger('rising(17)', {post: 1.5}), RangeError);
+assert.throws(() => new EdgeTrigger('rising(17)', {pre: 2 ** 32 - 1, post: 1}), RangeError);
+assert.throws(() => new EdgeTrigger('rising(17)', {pre: 4096, post: 1}), RangeError);
+
+const a = new Gpio(A, {mode: Gpio.OUTPUT});
+const b = new Gpio(B, {mode: Gpio.OUTPUT});
+
+a.digitalWrite(0);
+b.digitalWrite(0);
+
+const trigger = new EdgeTrigger('rising(17) && high(18)', {pre: 1, post: 2});
+const windows = [];
+
+trigger.on('trigger', (edges, triggerIndex) => {
+  windows.push({edges, triggerIndex});
+});
+
+const step = (on, off) => ({
+  gpioOn: on === null ? 0 : on,
+  gpioOff: off === null ? 0 : off,
+  usDelay: 100
+});
+
+// A rises and falls with B low, B rises, A rises and falls with B high, B
+// falls. Only the second rising edge on A matches.
+pigpio.waveClear();
+pigpio.waveAddGeneric([
+  step(A, null), step(null, A),
+  step(B, null),
+  step(A, null), step(null, A),
+  step(null, B)
+]);
+
+const waveId = pigpio.waveCreate();
+pigpio.waveTxSend(waveId, pigpio.WAVE_MODE_ONE_SHOT);
+
+setTimeout(() => {
+  pigpio.waveDelete(waveId);
+  trigger.close();
+
+  assert.strictEqual(windows.length, 1, 'expected 1 trigger instead of ' + windows.length);
+
+  const window = windows[0];
+  const edges = window.edges.map((edge) => [edge.gpio, edge.level]);
+
+  assert.strictEqual(window.triggerIndex, 1);
+  assert.deepStrictEqual(edges, [[B, 1], [A, 1], [A, 0], [B, 0]]);
+
+  for (let i = 1; i !== window.edges.length; i += 1) {
+    const delta = (window.edges[i].tick - window.edges[i - 1].tick) >>> 0;
+    assert(delta > 50 && delta < 200, 'unexpected edge spacing ' + delta + 'us');
+  }
+
+  assert.strictEqual(trigger.matches, 1);
+  assert.strictEqual(trigger.dropped, 0);
+
+  console.log('  success...');
+}, 100);
@@ -0,0 +1,79 @@
+'use strict';
+
+// Drive a quadrature signal on GPIO7 and GPIO8 and decode it with an Encoder.
+// Both channels are then changed at the same time with banked writes, which
+// are invalid transitions.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+const GpioBank = pigpio.GpioBank;
+const Encoder = pigpio.Encoder;
+
+const STEPS = 200;
+const SEQUENCE = [[0, 0], [1, 0], [1, 1], [0, 1]];
+const BOTH = (1 << 7) | (1 << 8);
+
+const encoder = new Encoder(7, 8, {counts: 50});
+const a = new Gpio(7, {mode: Gpio.OUTPUT});
+const b = new Gpio(8, {mode: Gpio.OUTPUT});
+const bank = new GpioBank();
+
+let reports = 0;
+let lastInvalid = 0;
+
+encoder.on('position', (position, velocity, invalid) => {
+  reports += 1;
+  lastInvalid = invalid;
+  console.log('  position ' + position + ', ' + velocity.toFixed(0) +
+    ' counts/s, ' + invalid + ' invalid');
+});
+
+a.digitalWrite(0);
+b.digitalWrite(0);
+encoder.setPosition(0);
+
+const run = (steps, done) => {
+  let step = 0;
+
+  const iv = setInterval(() => {
+    step += 1;
+
+    const levels = SEQUENCE[step % SEQUENCE.length];
+    a.digitalWrite(levels[0]);
+    b.digitalWrite(levels[1]);
+
+    if (step === steps) {
+      clearInterval(iv);
+      setTimeout(done, 100);
+    }
+  }, 1);
+};
+
+run(STEPS, () => {
+  assert.strictEqual(encoder.position(), STEPS,
+    'expected position ' + STEPS + ' instead of ' + encoder.position());
+  assert.strictEqual(reports, STEPS / 50,
+    'expected ' + STEPS / 50 + ' position events instead of ' + reports);
+  assert.strictEqual(lastInvalid, 0);
+
+  // 00 -> 11 -> 00, two invalid transitions that don't change the position.
+  bank.set(BOTH);
+
+  setTimeout(() => {
+    bank.clear(BOTH);
+
+    setTimeout(() => {
+      assert.strictEqual(encoder.position(), STEPS,
+        'invalid transitions changed the position to ' + encoder.position());
+
+      run(50, () => {
+        assert.strictEqual(encoder.position(), STEPS + 50);
+        assert.strictEqual(lastInvalid, 2,
+          'expected 2 invalid transitions instead of ' + lastInvalid);
+        encoder.close();
+        console.log('  success...');
+      });
+    }, 10);
+  }, 10);
+});
@@ -0,0 +1,53 @@
+'use strict';
+
+// Initialize asynchronously, check that the event loop keeps running while
+// initialization is pending and that a constructor waits for a pending
+// initialization.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+let ticks = 0;
+const iv = setInterval(() => {
+  ticks += 1;
+}, 1);
+
+const ready = pigpio.initializeAsync({clock: {microseconds: 5, peripheral: pigpio.CLOCK_PCM}});
+
+assert.strictEqual(pigpio.initializeAsync(), ready);
+
+ready.then((result) => {
+  clearInterval(iv);
+
+  console.log('  ' + JSON.stringify(result.timing));
+
+  assert(result.version > 0);
+  assert(result.timing.initialize > 0);
+  assert(result.timing.total >= result.timing.initialize);
+  assert(ticks > 0, 'expected the event loop to run during initialization');
+
+  pigpio.terminate();
+
+  // A constructor called while initialization is pending waits for it.
+  const pending = pigpio.initializeAsync();
+  const led = new Gpio(17, {mode: Gpio.OUTPUT});
+  led.digitalWrite(1);
+
+  return pending;
+}).then((result) => {
+  assert(result.version > 0);
+
+  new Gpio(17, {mode: Gpio.OUTPUT}).digitalWrite(0);
+
+  // Once initialized, the result has the same shape.
+  return pigpio.initializeAsync().then((again) => {
+    assert.strictEqual(again.version, result.version);
+    assert.strictEqual(again.timing.total, 0);
+  });
+}).then(() => {
+  console.log('  success...');
+}).catch((err) => {
+  console.log(err);
+  process.exit(1);
+});
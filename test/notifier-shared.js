@@ -0,0 +1,71 @@
+'use strict';
+
+// Two shared Notifiers, one watching a GPIO toggled by hardware PWM and one
+// watching a GPIO that doesn't change state. Both use the same notification
+// pipe but the second should only see its initial notification.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+const Notifier = pigpio.Notifier;
+
+const LED_GPIO = 18;
+const QUIET_GPIO = 7;
+const FREQUENCY = 1000;
+
+const led = new Gpio(LED_GPIO, {mode: Gpio.OUTPUT});
+new Gpio(QUIET_GPIO, {mode: Gpio.INPUT, pullUpDown: Gpio.PUD_DOWN});
+
+const ledNotifier = new Notifier({bits: 1 << LED_GPIO, shared: true});
+const quietNotifier = new Notifier({bits: 1 << QUIET_GPIO, shared: true});
+
+let ledNotifications = 0;
+let seqnoErrors = 0;
+let lastSeqno;
+let quietNotifications = 0;
+
+ledNotifier.stream().on('data', (buf) => {
+  for (let ix = 0; ix < buf.length; ix += Notifier.NOTIFICATION_LENGTH) {
+    const seqno = buf.readUInt16LE(ix);
+
+    if (ledNotifications > 0 && ((lastSeqno + 1) & 0xffff) !== seqno) {
+      seqnoErrors += 1;
+    }
+
+    lastSeqno = seqno;
+    ledNotifications += 1;
+  }
+});
+
+quietNotifier.stream().on('data', (buf) => {
+  quietNotifications += buf.length / Notifier.NOTIFICATION_LENGTH;
+});
+
+led.hardwarePwmWrite(FREQUENCY, 500000);
+
+setTimeout(() => {
+  led.digitalWrite(0);
+  ledNotifier.close();
+  quietNotifier.close();
+
+  console.log('  led notifications: %d', ledNotifications);
+  console.log('  led seqno errors: %d', seqnoErrors);
+  console.log('  quiet notifications: %d', quietNotifications);
+
+  assert(ledNotifications > FREQUENCY, 'expected more than ' + FREQUENCY + ' led notifications');
+  assert.strictEqual(seqnoErrors, 0, 'expected no seqno errors');
+  assert(quietNotifications <= 1, 'expected at most 1 quiet notification');
+
+  // Reopening the shared notification handle right after it was closed
+  // doesn't wait for the previous reader thread to exit.
+  for (let i = 0; i !== 10; i += 1) {
+    const start = pigpio.getTick();
+
+    new Notifier({bits: 1 << QUIET_GPIO, shared: true}).close();
+
+    const micros = pigpio.tickDiff(start, pigpio.getTick());
+    assert(micros < 20000, 'reopening took ' + micros + 'us');
+  }
+
+  console.log('  success...');
+}, 1000);
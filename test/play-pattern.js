@@ -0,0 +1,80 @@
+'use strict';
+
+// Output a counter on a two bit bus and check that the edges seen on each
+// GPIO match the pattern and that identical samples are merged.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+const PERIOD = 100;
+const REPEAT = 3;
+
+const pin0 = 17;
+const pin1 = 18;
+const mask = (1 << pin0) | (1 << pin1);
+
+const bit0 = new Gpio(pin0, {mode: Gpio.OUTPUT});
+const bit1 = new Gpio(pin1, {mode: Gpio.OUTPUT});
+
+bit0.digitalWrite(0);
+bit1.digitalWrite(0);
+pigpio.waveClear();
+
+// 0, 1, 2, 3 with every sample doubled, followed by 0 again
+const counter = [0, 0, 1, 1, 2, 2, 3, 3];
+const patterns = new Uint32Array(counter.map((value) =>
+  ((value & 1) << pin0) | (((value >> 1) & 1) << pin1)
+));
+
+assert.throws(() => pigpio.playPattern([1, 2, 3]), /Uint32Array/);
+assert.throws(() => pigpio.playPattern(patterns, {repeat: 70000}), /repeat/);
+
+const edges = {};
+edges[pin0] = 0;
+edges[pin1] = 0;
+
+[bit0, bit1].forEach((gpio) => {
+  gpio.enableAlert();
+  gpio.on('alert', () => {
+    edges[gpio.gpio] += 1;
+  });
+});
+
+// Force several waveforms to check that the chain has no gaps
+const report = pigpio.playPattern(patterns, {
+  mask: mask,
+  periodUs: PERIOD,
+  repeat: REPEAT,
+  maxPulses: 3
+});
+
+console.log('  ' + report.waveIds.length + ' waves, ' + report.pulses +
+  ' pulses, ' + report.micros + ' us');
+
+assert.strictEqual(report.samples, patterns.length);
+assert.strictEqual(report.micros, patterns.length * PERIOD);
+assert.strictEqual(report.waveIds.length, 3);
+assert(report.pulses < report.samples, 'identical samples were not merged');
+
+const iv = setInterval(() => {
+  if (pigpio.waveTxBusy()) {
+    return;
+  }
+
+  clearInterval(iv);
+
+  setTimeout(() => {
+    bit0.disableAlert();
+    bit1.disableAlert();
+
+    // bit 0 toggles 4 times per pass and bit 1 twice. The last pass ends
+    // with both bits high, the first pass starts with both low.
+    assert.strictEqual(edges[pin0], 4 * REPEAT - 1);
+    assert.strictEqual(edges[pin1], 2 * REPEAT - 1);
+
+    report.waveIds.forEach((waveId) => pigpio.waveDelete(waveId));
+
+    console.log('  success...');
+  }, 100);
+}, 100);
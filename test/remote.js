@@ -0,0 +1,288 @@
+'use strict';
+
+// Drive a stub pigpio daemon on loopback through the remote backend. Checks
+// that commands are pipelined and batched, that results and errors arrive
+// in order and that alerts and notifications are received on the
+// notification socket.
+
+const assert = require('assert');
+const net = require('net');
+const pigpio = require('../');
+
+const CMD_MODES = 0;
+const CMD_MODEG = 1;
+const CMD_READ = 3;
+const CMD_WRITE = 4;
+const CMD_PWM = 5;
+const CMD_BR1 = 10;
+const CMD_TICK = 16;
+const CMD_NB = 19;
+const CMD_NC = 21;
+const CMD_WVAG = 28;
+const CMD_WVCRE = 49;
+const CMD_GDC = 83;
+const CMD_NOIB = 99;
+
+const PI_BAD_GPIO = -3;
+
+// A minimal pigpiod that keeps GPIO levels, modes and duty cycles in memory
+// and sends notification reports when levels change.
+const createStubDaemon = () => {
+  const state = {
+    levels: 0,
+    modes: [],
+    dutyCycles: [],
+    notifications: [],
+    dataEvents: 0,
+    commands: 0
+  };
+
+  let tick = 0;
+
+  const report = (notification) => {
+    const buf = Buffer.alloc(12);
+
+    tick += 10;
+    buf.writeUInt16LE(notification.seqno, 0);
+    buf.writeUInt16LE(0, 2);
+    buf.writeUInt32LE(tick, 4);
+    buf.writeUInt32LE(state.levels >>> 0, 8);
+    notification.seqno += 1;
+    notification.socket.write(buf);
+  };
+
+  const execute = (socket, cmd, p1, p2, ext) => {
+    if (p1 > 53 && [CMD_MODES, CMD_READ, CMD_WRITE].indexOf(cmd) !== -1) {
+      return PI_BAD_GPIO;
+    }
+
+    switch (cmd) {
+      case CMD_MODES:
+        state.modes[p1] = p2;
+        return 0;
+      case CMD_MODEG:
+        return state.modes[p1] || 0;
+      case CMD_READ:
+        return (state.levels >>> p1) & 1;
+      case CMD_WRITE: {
+        const levels = p2 ?
+          (state.levels | (1 << p1)) >>> 0 :
+          (state.levels & ~(1 << p1)) >>> 0;
+
+        if (levels !== state.levels) {
+          const changed = levels ^ state.levels;
+
+          state.levels = levels;
+          state.notifications.forEach((notification) => {
+            if (notification && notification.bits & changed) {
+              report(notification);
+            }
+          });
+        }
+        return 0;
+      }
+      case CMD_PWM:
+        state.dutyCycles[p1] = p2;
+        return 0;
+      case CMD_GDC:
+        return state.dutyCycles[p1] || 0;
+      case CMD_BR1:
+        return state.levels | 0;
+      case CMD_TICK:
+        return tick | 0;
+      case CMD_NOIB:
+        state.notifications.push({socket: socket, bits: 0, seqno: 0});
+        socket.notification = true;
+        return state.notifications.length - 1;
+      case CMD_NB:
+        state.notifications[p1].bits = p2;
+        return 0;
+      case CMD_NC:
+        state.notifications[p1].socket.end();
+        state.notifications[p1] = null;
+        return 0;
+      case CMD_WVAG:
+        return ext.length / 12;
+      case CMD_WVCRE:
+        return 0;
+      default:
+        return 0;
+    }
+  };
+
+  const server = net.createServer((socket) => {
+    let received = Buffer.alloc(0);
+
+    socket.on('data', (chunk) => {
+      const responses = [];
+
+      state.dataEvents += 1;
+      received = Buffer.concat([received, chunk]);
+
+      while (received.length >= 16 &&
+          received.length >= 16 + received.readUInt32LE(12)) {
+        const cmd = received.readUInt32LE(0);
+        const p1 = received.readUInt32LE(4);
+        const p2 = received.readUInt32LE(8);
+        const p3 = received.readUInt32LE(12);
+        const ext = received.slice(16, 16 + p3);
+        const response = Buffer.alloc(16);
+
+        state.commands += 1;
+        received = received.slice(16 + p3);
+
+        response.writeUInt32LE(cmd, 0);
+        response.writeUInt32LE(p1, 4);
+        response.writeUInt32LE(p2, 8);
+        response.writeInt32LE(execute(socket, cmd, p1, p2, ext), 12);
+        responses.push(response);
+      }
+
+      // The NOIB response must precede the reports on a notification socket
+      if (socket.notification && responses.length === 1) {
+        socket.cork();
+        socket.write(responses[0]);
+        process.nextTick(() => socket.uncork());
+      } else if (responses.length > 0) {
+        socket.write(Buffer.concat(responses));
+      }
+    });
+
+    socket.on('error', () => {});
+  });
+
+  return {server: server, state: state};
+};
+
+const waitFor = (emitter, event, count) => {
+  const values = [];
+
+  return new Promise((resolve) => {
+    const listener = (value) => {
+      values.push(value);
+
+      if (values.length === count) {
+        emitter.removeListener(event, listener);
+        resolve(values);
+      }
+    };
+
+    emitter.on(event, listener);
+  });
+};
+
+const run = async () => {
+  const daemon = createStubDaemon();
+
+  await new Promise((resolve) => daemon.server.listen(0, '127.0.0.1', resolve));
+
+  const pi = await pigpio.connect({
+    host: '127.0.0.1',
+    port: daemon.server.address().port
+  });
+
+  // Pipelining and batching
+  const led = new pi.Gpio(17, {mode: pi.Gpio.OUTPUT});
+
+  for (let i = 0; i !== 100; i += 1) {
+    led.digitalWrite(i % 2);
+  }
+
+  assert.strictEqual(await led.digitalRead(), 1);
+  assert.strictEqual(await led.getMode(), pi.Gpio.OUTPUT);
+
+  const stats = pi.stats();
+
+  console.log('  ' + stats.commands + ' commands in ' + stats.writes +
+    ' writes, ' + daemon.state.dataEvents + ' data events at the daemon');
+
+  assert.strictEqual(stats.commands, 103);
+  assert.strictEqual(stats.writes, 2);
+  assert.strictEqual(stats.pending, 0);
+  assert(daemon.state.dataEvents < 10, 'commands were not batched');
+
+  // Results are matched to commands in order
+  const results = await Promise.all([
+    led.pwmWrite(128).getPwmDutyCycle(),
+    new pi.Gpio(18).pwmWrite(64).getPwmDutyCycle(),
+    led.digitalWrite(0).digitalRead()
+  ]);
+
+  assert.deepStrictEqual(results, [128, 64, 0]);
+
+  // Errors
+  await assert.rejects(new pi.Gpio(60).digitalRead(), /pigpio error -3 in READ/);
+
+  const errorEvent = waitFor(pi, 'error', 1);
+  new pi.Gpio(60).digitalWrite(1);
+  const errors = await errorEvent;
+  assert.strictEqual(errors[0].code, -3);
+
+  // Without an 'error' listener the error is surfaced by the next call
+  // rather than terminating the process.
+  new pi.Gpio(60).digitalWrite(1);
+  await pi.getTick();
+  assert.throws(() => new pi.Gpio(17).digitalWrite(1), /pigpio error -3 in WRITE/);
+
+  new pi.Gpio(60).digitalWrite(1);
+  await pi.getTick();
+  await assert.rejects(pi.getTick(), /pigpio error -3 in WRITE/);
+
+  // Banked GPIO and unsigned results
+  new pi.Gpio(31, {mode: pi.Gpio.OUTPUT}).digitalWrite(1);
+  assert.strictEqual(await new pi.GpioBank().read(), 0x80000000);
+
+  // Waves
+  pi.waveClear();
+  pi.waveAddNew();
+  assert.strictEqual(await pi.waveAddGeneric([
+    {gpioOn: 17, gpioOff: 0, usDelay: 10},
+    {gpioOn: 0, gpioOff: 17, usDelay: 10}
+  ]), 2);
+  assert.strictEqual(await pi.waveCreate(), 0);
+
+  // Alerts
+  const input = new pi.Gpio(4, {alert: true});
+  const alerts = waitFor(input, 'alert', 3);
+
+  // Wait for the notification socket to be started before changing levels
+  await pi.getTick();
+  await new Promise((resolve) => setTimeout(resolve, 50));
+
+  input.digitalWrite(1);
+  input.digitalWrite(0);
+  input.digitalWrite(1);
+  led.digitalWrite(1);
+
+  assert.deepStrictEqual(await alerts, [1, 0, 1]);
+  input.disableAlert();
+
+  // Notifier
+  const notifier = new pi.Notifier({bits: 1 << 22});
+  const gpio22 = new pi.Gpio(22, {mode: pi.Gpio.OUTPUT});
+  const data = waitFor(notifier.stream(), 'data', 1);
+
+  await new Promise((resolve) => setTimeout(resolve, 50));
+  gpio22.digitalWrite(1);
+
+  const chunk = (await data)[0];
+  assert.strictEqual(chunk.length % pi.Notifier.NOTIFICATION_LENGTH, 0);
+  assert.strictEqual((chunk.readUInt32LE(8) >>> 22) & 1, 1);
+
+  const end = waitFor(notifier.stream(), 'end', 1);
+  notifier.stream().resume();
+  notifier.close();
+  await end;
+
+  await pi.close();
+  await assert.rejects(led.digitalRead(), /closed/);
+
+  daemon.server.close();
+
+  console.log('  success...');
+};
+
+run().catch((err) => {
+  console.error(err);
+  process.exit(1);
+});
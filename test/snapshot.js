@@ -0,0 +1,51 @@
+'use strict';
+
+/* global BigInt */
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+const field = (snapshot, gpio, offset) => {
+  return snapshot[gpio * pigpio.SNAPSHOT_FIELDS + offset];
+};
+
+const led = new Gpio(17, {mode: Gpio.OUTPUT, pullUpDown: Gpio.PUD_DOWN});
+const servo = new Gpio(18, {mode: Gpio.OUTPUT});
+const input = new Gpio(4, {mode: Gpio.INPUT});
+
+led.pwmWrite(100);
+servo.servoWrite(1500);
+
+const snapshot = pigpio.snapshot();
+assert.strictEqual(snapshot.length, pigpio.SNAPSHOT_LENGTH);
+
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_MODE), Gpio.OUTPUT);
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_PULL_UP_DOWN), Gpio.PUD_DOWN);
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_PWM_DUTY_CYCLE), led.getPwmDutyCycle());
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_PWM_RANGE), led.getPwmRange());
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_PWM_FREQUENCY), led.getPwmFrequency());
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_SERVO_PULSE_WIDTH), -1);
+
+assert.strictEqual(field(snapshot, 18, pigpio.SNAPSHOT_SERVO_PULSE_WIDTH), 1500);
+assert.strictEqual(field(snapshot, 18, pigpio.SNAPSHOT_PWM_DUTY_CYCLE), -1);
+
+assert.strictEqual(field(snapshot, 4, pigpio.SNAPSHOT_MODE), Gpio.INPUT);
+assert.strictEqual(field(snapshot, 4, pigpio.SNAPSHOT_LEVEL), input.digitalRead());
+assert.strictEqual(field(snapshot, 4, pigpio.SNAPSHOT_PWM_DUTY_CYCLE), -1);
+assert.strictEqual(field(snapshot, 4, pigpio.SNAPSHOT_SERVO_PULSE_WIDTH), -1);
+
+assert.strictEqual(field(snapshot, 40, pigpio.SNAPSHOT_PWM_RANGE), -1);
+
+led.digitalWrite(0);
+servo.servoWrite(0);
+
+// Only GPIO17 and GPIO53, reusing the snapshot
+pigpio.snapshot(BigInt(1) << BigInt(53) | BigInt(1) << BigInt(17), snapshot);
+
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_PWM_DUTY_CYCLE), -1);
+assert.strictEqual(field(snapshot, 17, pigpio.SNAPSHOT_LEVEL), 0);
+assert.notStrictEqual(field(snapshot, 53, pigpio.SNAPSHOT_MODE), -1);
+assert.strictEqual(field(snapshot, 18, pigpio.SNAPSHOT_MODE), -1);
+
+console.log('  success...');
@@ -0,0 +1,55 @@
+'use strict';
+
+// Toggle GPIO17 and check that the state mirror sees the edges, both on the
+// main thread and on a worker thread.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+const Worker = require('worker_threads').Worker;
+
+const GPIO = 17;
+const TOGGLES = 100;
+
+const led = new Gpio(GPIO, {mode: Gpio.OUTPUT});
+led.digitalWrite(0);
+
+const mirror = pigpio.stateMirror();
+const before = pigpio.readStateMirror(mirror);
+let toggles = 0;
+
+const iv = setInterval(() => {
+  led.digitalWrite(toggles & 1 ? 0 : 1);
+  toggles += 1;
+
+  if (toggles === TOGGLES) {
+    clearInterval(iv);
+    led.digitalWrite(1);
+
+    setTimeout(() => {
+      const after = pigpio.readStateMirror(mirror);
+      const edges = after[pigpio.STATE_MIRROR_EDGE_COUNT + GPIO] -
+        before[pigpio.STATE_MIRROR_EDGE_COUNT + GPIO];
+
+      assert.strictEqual(edges, TOGGLES + 1);
+      assert.strictEqual((after[pigpio.STATE_MIRROR_LEVELS_0_31] >>> GPIO) & 1, 1);
+      assert(after[pigpio.STATE_MIRROR_SEQUENCE] > before[pigpio.STATE_MIRROR_SEQUENCE]);
+
+      const worker = new Worker(`
+        const parentPort = require('worker_threads').parentPort;
+        parentPort.once('message', (buffer) => {
+          parentPort.postMessage(Atomics.load(new Uint32Array(buffer), ${pigpio.STATE_MIRROR_LEVELS_0_31}));
+        });
+      `, {eval: true});
+
+      worker.once('message', (levels) => {
+        assert.strictEqual((levels >>> GPIO) & 1, 1);
+        worker.terminate();
+        led.digitalWrite(0);
+        console.log('  success...');
+      });
+
+      worker.postMessage(mirror);
+    }, 100);
+  }
+}, 2);
@@ -0,0 +1,27 @@
+'use strict';
+
+/* global BigInt */
+
+const assert = require('assert');
+const pigpio = require('../');
+
+pigpio.initialize();
+
+const tick = pigpio.getTick();
+const tick64 = pigpio.getTick64();
+
+assert.strictEqual(typeof tick64, 'bigint');
+assert.strictEqual(Number(tick64 & BigInt(0xffffffff)) - tick < 1000, true,
+  'expected the low 32 bits of the 64 bit tick to match the 32 bit tick');
+
+// The 64 bit tick is seeded from CLOCK_MONOTONIC so it should be close to
+// process.hrtime.
+const hrtime = process.hrtime.bigint();
+const converted = pigpio.tickToHrtime(pigpio.getTick64());
+const diff = Number(converted - hrtime) / 1000;
+
+console.log(`  tick64 = ${tick64} us, hrtime - tickToHrtime = ${diff.toFixed(1)} us`);
+
+assert(Math.abs(diff) < 100, `expected tickToHrtime to be within 100 us of hrtime, got ${diff} us`);
+
+pigpio.terminate();
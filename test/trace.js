@@ -0,0 +1,92 @@
+'use strict';
+
+// Trace the alerts of an output and a waveform and check that every stage
+// of an alert is recorded and linked by a flow.
+
+const assert = require('assert');
+const fs = require('fs');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+const EDGES = 100;
+const TRACE_PATH = '/tmp/pigpio-trace.json';
+
+const outPin = 17;
+const output = new Gpio(outPin, {mode: Gpio.OUTPUT});
+
+output.digitalWrite(0);
+
+let edges = 0;
+
+output.enableAlert();
+output.on('alert', () => {
+  edges += 1;
+});
+
+pigpio.traceStart();
+
+pigpio.waveClear();
+pigpio.waveAddGeneric([
+  {gpioOn: outPin, gpioOff: 0, usDelay: 100},
+  {gpioOn: 0, gpioOff: outPin, usDelay: 100}
+]);
+
+const waveId = pigpio.waveCreate();
+
+pigpio.waveTxSend(waveId, pigpio.WAVE_MODE_REPEAT);
+
+const iv = setInterval(() => {
+  if (edges < EDGES) {
+    return;
+  }
+
+  clearInterval(iv);
+
+  pigpio.waveTxStop();
+  pigpio.waveDelete(waveId);
+  output.disableAlert();
+  pigpio.traceStop();
+
+  const trace = pigpio.traceExport();
+  const names = new Set(trace.traceEvents.map((event) => event.name));
+
+  [
+    'alert handler',
+    'sem_g wait',
+    'uv_async_send',
+    'event loop wakeup',
+    'alert callback',
+    'gpioWaveCreate',
+    'gpioWaveTxSend'
+  ].forEach((name) => {
+    assert(names.has(name), 'no ' + name + ' events');
+  });
+
+  // Each alert callback is the end of a flow that starts in the handler
+  const callbacks = trace.traceEvents.filter((event) => event.name === 'alert callback');
+  const handlers = new Set(trace.traceEvents.
+    filter((event) => event.name === 'alert handler').
+    map((event) => event.bind_id)
+  );
+
+  assert(callbacks.length >= EDGES);
+  callbacks.forEach((event) => {
+    assert.strictEqual(event.args.gpio, outPin);
+    assert(event.flow_in);
+    assert(handlers.has(event.bind_id), 'callback without handler');
+  });
+
+  const threads = trace.traceEvents.filter((event) => event.name === 'thread_name');
+  assert(threads.length >= 2, 'expected events from several threads');
+
+  pigpio.traceWrite(TRACE_PATH);
+  assert.strictEqual(
+    JSON.parse(fs.readFileSync(TRACE_PATH, 'utf8')).traceEvents.length,
+    trace.traceEvents.length
+  );
+  fs.unlinkSync(TRACE_PATH);
+
+  console.log('  ' + trace.traceEvents.length + ' trace events on ' +
+    threads.length + ' threads');
+  console.log('  success...');
+}, 10);
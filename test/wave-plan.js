@@ -0,0 +1,100 @@
+'use strict';
+
+// Plan a waveform that's too large for a single wave and check that the
+// segments are transmitted back to back without gaps. maxPulses forces
+// segmentation while keeping the plan well within the default DMA control
+// block pool.
+
+const assert = require('assert');
+const pigpio = require('../');
+const Gpio = pigpio.Gpio;
+
+const PULSES = 6000;
+const MAX_PULSES = 2000;
+const DELAY = 50;
+
+const outPin = 17;
+const output = new Gpio(outPin, {mode: Gpio.OUTPUT});
+
+output.digitalWrite(0);
+pigpio.waveClear();
+
+const pulses = [];
+
+for (let i = 0; i !== PULSES; i += 1) {
+  if (i % 2 === 0) {
+    pulses.push({gpioOn: outPin, gpioOff: 0, usDelay: DELAY});
+  } else {
+    pulses.push({gpioOn: 0, gpioOff: outPin, usDelay: DELAY});
+  }
+}
+
+assert.throws(() => pigpio.wavePlan(pulses, {maxCbs: 100}), /DMA control blocks/);
+
+// Control blocks held by existing waveforms are not available to the plan
+pigpio.waveAddNew();
+pigpio.waveAddGeneric(pulses.slice(0, MAX_PULSES));
+const otherWaveId = pigpio.waveCreate();
+const otherCbs = pigpio.waveGetCbs();
+
+assert.throws(() => pigpio.wavePlan(pulses, {
+  maxPulses: MAX_PULSES,
+  maxCbs: otherCbs + 2 * PULSES
+}), /DMA control blocks/);
+
+pigpio.waveDelete(otherWaveId);
+
+const plan = pigpio.wavePlan(pulses, {maxPulses: MAX_PULSES});
+
+console.log('  ' + plan.segments.length + ' segments, ' + plan.cbs + ' cbs, ' +
+  plan.micros + ' us');
+
+assert.strictEqual(plan.segments.length, PULSES / MAX_PULSES);
+assert.strictEqual(plan.micros, PULSES * DELAY);
+assert.strictEqual(plan.chain.length, plan.segments.length);
+
+let edges = 0;
+let lastTick;
+let maxGap = 0;
+
+output.enableAlert();
+
+output.on('alert', (level, tick) => {
+  if (lastTick !== undefined) {
+    maxGap = Math.max(maxGap, pigpio.tickDiff(lastTick, tick));
+  }
+
+  lastTick = tick;
+  edges += 1;
+});
+
+pigpio.waveChain(plan.chain);
+
+const iv = setInterval(() => {
+  if (pigpio.waveTxBusy()) {
+    return;
+  }
+
+  clearInterval(iv);
+
+  setTimeout(() => {
+    output.disableAlert();
+
+    assert.strictEqual(edges, PULSES);
+    assert(maxGap < DELAY + 10, 'gap of ' + maxGap + ' us between segments');
+
+    plan.waveIds.forEach((waveId) => pigpio.waveDelete(waveId));
+
+    // A repeated plan loops over its waveforms in the chain.
+    const repeated = pigpio.wavePlan(pulses, {maxPulses: MAX_PULSES, repeat: 3});
+
+    assert.deepStrictEqual(repeated.chain,
+      [255, 0].concat(repeated.waveIds, [255, 1, 3, 0]));
+
+    repeated.waveIds.forEach((waveId) => pigpio.waveDelete(waveId));
+
+    assert.throws(() => pigpio.wavePlan(pulses, {repeat: 65536}), RangeError);
+
+    console.log('  success...');
+  }, 100);
+}, 100);